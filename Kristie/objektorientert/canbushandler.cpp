@@ -1,27 +1,75 @@
 #include "canbushandler.h"
 
-CanBusHandler::CanBusHandler(FlexCAN_T4 <CAN0, RX_SIZE_256, TX_SIZE_16>& can, uint8_t groupNumber, uint8_t enemyGroupNumber)
+CanBusHandler::CanBusHandler(FlexCAN_T4 <CAN0, RX_SIZE_256, TX_SIZE_16>& can, uint16_t groupNumber, uint16_t enemyGroupNumber)
   : can_{can}
   , groupNumber_{groupNumber}
   , enemyGroupNumber_{enemyGroupNumber}
-  {}
+  , bulk_{writeFrame, this, CanBulkFromNode::id(groupNumber), CanBulkToNode::id(groupNumber)}
+  {
+    dispatcher_.setBases(groupNumber, enemyGroupNumber);
+  }
+
+
+void CanBusHandler::setGroupNumbers(uint16_t groupNumber, uint16_t enemyGroupNumber)
+{
+    groupNumber_ = groupNumber;
+    enemyGroupNumber_ = enemyGroupNumber;
+    bulk_.setIds(CanBulkFromNode::id(groupNumber), CanBulkToNode::id(groupNumber));
+    dispatcher_.setBases(groupNumber, enemyGroupNumber);
+}
 
 
 void CanBusHandler::sendPaddlePosition(Paddle& paddle)
 {
     CAN_message_t msg;
-    msg.id = groupNumber_ + 20;
-    msg.len = 1;
-    msg.buf[0] = paddle.top();
+    CanPlateP1::encode({paddle.top(), 0}, groupNumber_, msg); // hver node er P1 i sin egen gruppe
     can_.write(msg);
 }
 
 void CanBusHandler::sendBallPosition(uint8_t xBall, uint8_t yBall)
 {
     CAN_message_t msg;
-    msg.id = groupNumber_ + 50; 
-    msg.len = 2;
-    msg.buf[0] = xBall;
-    msg.buf[1] = yBall;
+    CanBallPositionLegacy::encode({xBall, yBall, 0, 0, 0}, groupNumber_, msg);
     can_.write(msg);
+}
+
+
+bool CanBusHandler::sendBulk(const uint8_t* data, uint16_t len)
+{
+    return bulk_.send(data, len, micros());
+}
+
+void CanBusHandler::updateBulk()
+{
+    bulk_.update(micros());
+}
+
+bool CanBusHandler::handleBulkFrame(const CAN_message_t& msg)
+{
+    if ( msg.flags.extended ) return false;
+    return bulk_.receive(msg.id, msg.buf, msg.len, micros());
+}
+
+int CanBusHandler::receiveAll()
+{
+    CAN_message_t msg;
+    int count = 0;
+    while ( can_.read(msg) )
+    {
+        count++;
+        if ( handleBulkFrame(msg) ) continue;
+        dispatcher_.dispatch(msg.id, msg.flags.extended, msg.buf, msg.len);
+    }
+    return count;
+}
+
+// FlexCAN_T4 gir 0 når sendekøen er full, da prøver IsoTp igjen senere
+bool CanBusHandler::writeFrame(void* context, uint32_t id, const uint8_t* data, uint8_t len)
+{
+    CanBusHandler* handler = static_cast<CanBusHandler*>(context);
+    CAN_message_t msg;
+    msg.id = id;
+    msg.len = len;
+    memcpy(msg.buf, data, len);
+    return handler->can_.write(msg) > 0;
 }
\ No newline at end of file
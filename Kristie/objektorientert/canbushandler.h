@@ -4,19 +4,45 @@
 #include <Arduino.h>
 #include <FlexCAN_T4.h>
 #include "paddle.h"
+#include "../../felles/isotp.h"
+#include "../../felles/candispatch.h"
+#include "../../felles/canmessages.h"
 
 class CanBusHandler
 {
   public:
-  CanBusHandler(FlexCAN_T4 <CAN0, RX_SIZE_256, TX_SIZE_16>& can, uint8_t groupNumber, uint8_t enemyGroupNumber);
+  CanBusHandler(FlexCAN_T4 <CAN0, RX_SIZE_256, TX_SIZE_16>& can, uint16_t groupNumber, uint16_t enemyGroupNumber);
+
+  // Gruppenumrene kan byttes når lobbyen har gitt oss en kamp (se felles/lobby.h)
+  void setGroupNumbers(uint16_t groupNumber, uint16_t enemyGroupNumber);
+  uint16_t enemyPaddleId() const {return CanPlateP1::id(enemyGroupNumber_);}
 
   void sendPaddlePosition(Paddle& paddle);
   void sendBallPosition(uint8_t xBall, uint8_t yBall);
 
+  // Store meldinger (kamplogg, konfig, diagnose) over ISO-TP, se felles/isotp.h.
+  // Vi sender på gruppe + 111 og tar imot på gruppe + 110 (fra del3/isotptool.cpp).
+  bool sendBulk(const uint8_t* data, uint16_t len);
+  void updateBulk();                                   // kalles hver runde i loop()
+  bool handleBulkFrame(const CAN_message_t& msg);      // true hvis rammen var ISO-TP
+  IsoTp& bulk() {return bulk_;}
+
+  // Mottak: rutene (felles/candispatch.h) regnes fra gruppenumrene, så de følger med når
+  // lobbyen bytter dem. receiveAll() tømmer hele køen i ett kall; ISO-TP-rammer går til
+  // bulk() og resten slås opp i tabellen. Returnerer antall rammer lest.
+  template <size_t N>
+  void setRoutes(const CanRouteList<N>& routes, void* context) {dispatcher_.setRoutes(routes, context);}
+  int receiveAll();
+  CanDispatcher& dispatcher() {return dispatcher_;}
+
   private:
+  static bool writeFrame(void* context, uint32_t id, const uint8_t* data, uint8_t len);
+
   FlexCAN_T4 <CAN0, RX_SIZE_256, TX_SIZE_16>& can_;
-  uint8_t groupNumber_;
-  uint8_t enemyGroupNumber_;
+  uint16_t groupNumber_;
+  uint16_t enemyGroupNumber_;
+  IsoTp bulk_;
+  CanDispatcher dispatcher_;
 
 };
 #endif
\ No newline at end of file
@@ -25,12 +25,18 @@ void Paddle::updatePositionFromJoystick(Joystick& joystick)
 
 void Paddle::updatePositionFromCAN(CAN_message_t& msgPosition)
 {
-  if (msgPosition.len < 1) // sjekker at meldingen faktisk inneholder minst 1 byte
+  updatePositionFromCAN(msgPosition.buf, msgPosition.len);
+}
+
+
+void Paddle::updatePositionFromCAN(const uint8_t* data, uint8_t len)
+{
+  if (len < 1) // sjekker at meldingen faktisk inneholder minst 1 byte
   {
     return;  // ingen data
   }
 
-  receivedPosition_ = msgPosition.buf[0];
+  receivedPosition_ = data[0];
 
   if ( receivedPosition_ < minPosition_ )
   {
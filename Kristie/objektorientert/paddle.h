@@ -19,6 +19,7 @@ class Paddle
 
   void updatePositionFromJoystick(Joystick& joystick);
   void updatePositionFromCAN(CAN_message_t& msgPosition);
+  void updatePositionFromCAN(const uint8_t* data, uint8_t len); // fra CanBusHandler::receiveAll()
   void draw(Adafruit_SSD1306& display);
 
   private: 
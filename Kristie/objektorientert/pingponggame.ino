@@ -9,6 +9,7 @@
 #include "ball.h"
 #include "pingponggame.h"
 #include "canbushandler.h"
+#include "../../felles/lobby.h"
 
 constexpr uint8_t joyUp{22};
 constexpr uint8_t joyDown{23};     
@@ -21,7 +22,8 @@ constexpr uint8_t screenHeight{64};
 
 // objekter
 FlexCAN_T4 < CAN0, RX_SIZE_256, TX_SIZE_16 > can0; // Can0-objekt
-CanBusHandler canBusHandler(can0, 6, 3);
+CanBusHandler canBusHandler(can0, 6, 3); // standard uten lobby, byttes når matchmakeren gir oss en kamp
+LobbyClient lobby(SIM_UIDL ^ SIM_UIDML);  // chip-ID-en er unik per Teensy
 Adafruit_SSD1306 display(screenWidth, screenHeight, &SPI, oledDC, oledReset, oledCS); 
 Joystick joystick(joyUp, joyDown);   
 Paddle myPaddle(124); 
@@ -30,8 +32,93 @@ Ball ball(64);
 PingPongGame pingPongGame(ball, myPaddle, joystick, display);
 
 
-CAN_message_t msgEnemyPosition;
-uint8_t enemyGroupNr = 23;
+// Mottak (felles/candispatch.h): motstanderens plate ligger på hans gruppe + 20.
+// En ny meldingstype er en ny linje her, uten at hver ramme blir dyrere å slå opp.
+void onEnemyPaddle(void*, const uint8_t* data, uint8_t len)
+{
+  enemyPaddle.updatePositionFromCAN(data, len);
+}
+
+constexpr auto canRoutes = makeCanRoutes({
+  CanPlateP1::route(CAN_BASE_PEER, onEnemyPaddle),
+});
+
+// Forespørsler over ISO-TP fra del3/isotptool.cpp (første byte er kommandoen)
+constexpr uint8_t bulkEcho{1}; // send meldingen tilbake, for å måle gjennomstrømning
+constexpr uint8_t bulkInfo{2}; // gruppenumre og tellere som tekst
+
+
+// Melder oss i lobbyen (felles/lobby.h). Sendes hele tiden, så matchmakeren ser at vi fortsatt spiller.
+void announceInLobby()
+{
+  CAN_message_t msgAnnounce;
+  uint32_t id;
+  uint8_t len;
+  if (lobby.pollAnnounce(millis(), id, msgAnnounce.buf, len))
+  {
+    msgAnnounce.id = id;
+    msgAnnounce.len = len;
+    msgAnnounce.flags.extended = 1;
+    can0.write(msgAnnounce);
+  }
+}
+
+
+// Venter på en kamp fra matchmakeren (del3/matchmaker.cpp). Trykker spilleren på joysticken
+// før det, spiller vi med de innkompilerte gruppenumrene som før.
+void joinLobby()
+{
+  display.begin(SSD1306_SWITCHCAPVCC);
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(SSD1306_WHITE);
+  display.setCursor(15, 25);
+  display.println("Venter i lobbyen...");
+  display.display();
+
+  CAN_message_t msgLobby;
+  while ( !lobby.isAssigned() && !joystick.joyUP() && !joystick.joyDOWN() )
+  {
+    announceInLobby();
+    while ( can0.read(msgLobby) )
+    {
+      if ( !msgLobby.flags.extended ) lobby.receive(msgLobby.id, msgLobby.buf, msgLobby.len);
+    }
+  }
+
+  if (lobby.isAssigned())
+  {
+    canBusHandler.setGroupNumbers(lobby.ownGroupNumber(), lobby.enemyGroupNumber());
+    Serial.print("Kamp fra lobbyen, gruppe ");
+    Serial.println(lobby.ownGroupNumber());
+  }
+  lobby.setInMatch(true); // også uten lobby, så matchmakeren ikke parer oss med noen
+  delay(300); // samme som showStartScreen(), så trykket ikke også starter spillet
+}
+
+
+
+// Svarer på en ferdig mottatt ISO-TP-melding. Svaret sendes i bakgrunnen av updateBulk().
+void handleBulkRequest()
+{
+  IsoTp& bulk = canBusHandler.bulk();
+  if ( !bulk.hasMessage() || bulk.isSending() ) return;
+
+  if ( bulk.message()[0] == bulkEcho )
+  {
+    canBusHandler.sendBulk(bulk.message(), bulk.messageLength());
+  }
+  else if ( bulk.message()[0] == bulkInfo )
+  {
+    char info[96];
+    int len = snprintf(info, sizeof(info), "gruppe %u mot %u, lobby %lx, ISO-TP inn %lu ut %lu feil %lu",
+                       lobby.ownGroupNumber(), lobby.enemyGroupNumber(), (unsigned long)lobby.nodeId(),
+                       (unsigned long)bulk.receivedMessages(), (unsigned long)bulk.sentMessages(),
+                       (unsigned long)bulk.failures());
+    canBusHandler.sendBulk((const uint8_t*)info, len);
+  }
+  bulk.release();
+}
 
 
 
@@ -40,6 +127,7 @@ void setup()
   Serial.begin(9600);
   can0.begin();
   can0.setBaudRate(500000);
+  canBusHandler.setRoutes(canRoutes, nullptr);
 
   // starter oled skjerm
   /*if (!display.begin(SSD1306_SWITCHCAPVCC)) 
@@ -52,6 +140,7 @@ void setup()
   //display.display();      // superviktig at denne kommer etter det over^ //denne må være med hvis showStartScreen(); blir fjernet
   joystick.init();
   ball.reset();
+  joinLobby();
   pingPongGame.showStartScreen();
   
 }
@@ -65,18 +154,16 @@ void loop()
     return;
   }
 
+  announceInLobby();
   display.clearDisplay();
   myPaddle.updatePositionFromJoystick(joystick);
   myPaddle.draw(display);
   canBusHandler.sendPaddlePosition(myPaddle);
+  canBusHandler.updateBulk();
 
-  if ( can0.read(msgEnemyPosition) ) 
-  { 
-    if (msgEnemyPosition.id == enemyGroupNr ) //sjekker at meldingen er ang. paddle posisjon
-    {
-      enemyPaddle.updatePositionFromCAN(msgEnemyPosition);
-    }
-  }
+  // Leser hele køen, ellers tar en ISO-TP-overføring plassen til plateposisjonene
+  canBusHandler.receiveAll();
+  handleBulkRequest();
   enemyPaddle.draw(display);
   ball.draw(display);
   ball.inMotion();
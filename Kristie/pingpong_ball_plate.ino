@@ -3,6 +3,7 @@
 #include <Adafruit_SSD1306.h>
 #include <SPI.h>
 #include <FlexCAN_T4.h>
+#include "../felles/ssd1306spi.h"
 
 const int JOY_RIGHT = 17;
 const int JOY_LEFT  = 18;
@@ -17,6 +18,9 @@ const int JOY_DOWN  = 23;
 #define SCREEN_HEIGHT   64
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &SPI, OLED_DC, OLED_RESET, OLED_CS);
 
+// Bare endringene sendes til skjermen, så bruk oled.show(display) (felles/ssd1306spi.h)
+Ssd1306Spi oled(SPI, OLED_DC, OLED_CS);
+
 // --- Platevariabler ---
 int platePosition = 22;       // startposisjon for platen
 const int plateHeight = 20; // høyde på platen
@@ -63,7 +67,7 @@ void setup()
   }
 
   display.clearDisplay();
-  display.display();
+  oled.show(display);
   Serial.println("Skjerm OK. Klar til bruk!");
 
   Can0.begin();
@@ -129,7 +133,7 @@ int plateX = SCREEN_WIDTH - plateWidth;
         display.setTextColor(SSD1306_WHITE);
         display.setCursor(20, 25);
         display.println("GAME OVER");
-        display.display();
+        oled.show(display);
         delay(2000);
 
         // Start ballen på nytt fra midten
@@ -139,7 +143,7 @@ int plateX = SCREEN_WIDTH - plateWidth;
         yVelocity = 1;
     }
     
-    display.display();
+    oled.show(display);
 
     CAN_message_t msgPlatePosition;
     msgPlatePosition.id = idPlatePosition;
@@ -4,6 +4,37 @@
 ===============================================================================
 ... (Variabeloversikt og CAN ID-er som før) ...
 NY CAN ID: 58 (Reset Spill)
+Poeng (57) og reset (58) sendes med sekvensnummer og ack
+(se felles/reliableevents.h). P1 acker på ID 63, P2 på ID 64.
+
+ROLLEFORDELING (felles/rolearbiter.h):
+Den som beveger joysticken først sender en claim med utvidet ID (16 << 18) | nonce, og
+den andre svarer at den er P2. Claimer begge samtidig blir lavest nonce P1 (den rammen
+vinner også arbitreringen på bussen). Ingen svar på 3 x 100 ms: vi er P1 alene, og en
+node som kommer senere får rollen vår i svaret og tar den andre.
+
+ROLLBACK-MODUS (useRollback = true):
+Begge nodene kjører spillet selv (felles/pongsim.h) og sender bare input per tick
+(P1 på ID 28, P2 på ID 29). Motpartens input gjettes til den kommer, og ved feil gjetning
+spoles det tilbake og simuleres på nytt (felles/rollback.h). Da svarer egen plate med en
+gang hos begge spillerne. Med useRollback = false er det som før: P1 simulerer og P2 speiler.
+
+DESYNC-SJEKK (rollback-modus):
+Hver 50. tick sender begge en hash av den bekreftede tilstanden på ID 106 (lav prioritet).
+Er hashene ulike sender P1 (autoriteten) hele tilstanden på ID 30 (to rammer), og P2
+bytter ut sin og simulerer frem igjen. Antall desyncs og resyncs skrives på Serial.
+
+HEARTBEAT OG FAILOVER (felles/heartbeat.h):
+P1 sender heartbeat på ID 31 og P2 på ID 32 hvert 100. ms: [flagg, spill-nr].
+Hører vi ingenting fra motparten på 500 ms fortsetter vi spillet alene fra siste
+tilstand (rollback-modus), og motpartens plate står stille.
+En node som starter på nytt og hører en heartbeat tar den ledige rollen og ber om
+tilstanden (flagg "trenger tilstand"). Den som har tilstanden sender den da på ID 30
+(del 2 og 3), og begge starter en ny økt derfra med nytt spill-nr.
+Kommer motparten tilbake uten å ha startet på nytt (feks. løs kabel), har begge
+spilt videre alene. Da sender P1 sin tilstand og P2 bytter ut sin (P2 melder fra med
+flagget "spilt alene" til den har fått den).
+Én node som starter på nytt avslutter altså ikke kampen.
 ===============================================================================
 */
 
@@ -12,6 +43,13 @@ NY CAN ID: 58 (Reset Spill)
 #include <Adafruit_SSD1306.h>
 #include <SPI.h>
 #include <FlexCAN_T4.h>
+#include "../felles/reliableevents.h"
+#include "../felles/rollback.h"
+#include "../felles/heartbeat.h"
+#include "../felles/rolearbiter.h"
+#include "../felles/canmessages.h"
+#include "../felles/candispatch.h"
+#include "../felles/ssd1306spi.h"
 
 // ------------------ Hardware ------------------
 constexpr int JOY_RIGHT = 17;
@@ -27,17 +65,109 @@ constexpr int SCREEN_WIDTH  = 128;
 constexpr int SCREEN_HEIGHT = 64;
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &SPI, OLED_DC, OLED_RESET, OLED_CS);
 
+// Skjermen tegnes med oled.show(display), som bare sender det som er endret (felles/ssd1306spi.h)
+Ssd1306Spi oled(SPI, OLED_DC, OLED_CS);
+
 // ------------------ CAN-konfig ------------------
-constexpr int groupNumber = 6;
-constexpr int idPlatePositionP1 = groupNumber + 20; // 26
-constexpr int idPlatePositionP2 = groupNumber + 21; // 27
-constexpr int idBallPosition    = groupNumber + 50; // 56
-constexpr int idRoleClaim       = groupNumber + 10; // 16
-constexpr int idGameOver        = groupNumber + 51; // 57 (Sender poeng)
-constexpr int idResetGame       = groupNumber + 52; // 58 (NY: Signal for å restarte)
+constexpr int groupNumber = 6; // ID-ene og innholdet står i felles/canmessages.h
+constexpr int idPlatePositionP1 = CanPlateP1::id(groupNumber);     // 26
+constexpr int idPlatePositionP2 = CanPlateP2::id(groupNumber);     // 27
+constexpr int idBallPosition    = CanBallPositionLegacy::id(groupNumber); // 56
+constexpr int idRoleClaim       = CanRoleClaim::id(groupNumber);   // 16 (rollefordeling, utvidet ID: 16 << 18 | nonce)
+constexpr int idGameOver        = CanScore::id(groupNumber);       // 57 (Sender poeng)
+constexpr int idResetGame       = CanResetGame::id(groupNumber);   // 58 (NY: Signal for å restarte)
+constexpr int idEventAckP1      = CanEventAckP1::id(groupNumber);  // 63 (ack sendt av P1)
+constexpr int idEventAckP2      = CanEventAckP2::id(groupNumber);  // 64 (ack sendt av P2)
+constexpr int idInputP1         = CanInputP1::id(groupNumber);     // 28 (rollback: input per tick fra P1)
+constexpr int idInputP2         = CanInputP2::id(groupNumber);     // 29 (rollback: input per tick fra P2)
+constexpr int idResync          = CanResyncBall::id(groupNumber);      // 30 (rollback: full tilstand etter desync eller restart, to deler)
+constexpr int idHeartbeatP1     = CanHeartbeatP1::id(groupNumber); // 31 (heartbeat fra P1)
+constexpr int idHeartbeatP2     = CanHeartbeatP2::id(groupNumber); // 32 (heartbeat fra P2)
+constexpr int idStateHash       = CanStateHash::id(groupNumber);   // 106 (rollback: hash av tilstanden, lav prioritet)
 
 FlexCAN_T4<CAN0, RX_SIZE_256, TX_SIZE_16> Can0;
 
+// Pålitelige hendelser. Ack-ID-en settes når rollen er bestemt (før det kan vi bare bli P2).
+void sendReliableFrame(uint32_t id, const uint8_t* data, uint8_t len);
+ReliableEvents reliableEvents(sendReliableFrame, idEventAckP2);
+
+// Rollefordeling med nonce i en utvidet ID, se felles/rolearbiter.h
+RoleArbiter roleArbiter((uint32_t)idRoleClaim << 18, 100, 3);
+
+// Mottak: én rute per ID (felles/candispatch.h). Rutene for P1 og P2 ser selv etter
+// om rammen er fra motparten, siden det avhenger av rollen vi har fått.
+void onRoleFrame(void*, uint32_t id, const uint8_t* data, uint8_t len);
+void onEventAckP1(void*, const uint8_t* data, uint8_t len);
+void onEventAckP2(void*, const uint8_t* data, uint8_t len);
+void onInputP1(void*, const uint8_t* data, uint8_t len);
+void onInputP2(void*, const uint8_t* data, uint8_t len);
+void onStateHash(void*, const uint8_t* data, uint8_t len);
+void onResync(void*, const uint8_t* data, uint8_t len);
+void onHeartbeatP1(void*, const uint8_t* data, uint8_t len);
+void onHeartbeatP2(void*, const uint8_t* data, uint8_t len);
+void onPlateP1(void*, const uint8_t* data, uint8_t len);
+void onPlateP2(void*, const uint8_t* data, uint8_t len);
+void onBallPosition(void*, const uint8_t* data, uint8_t len);
+void onGameOver(void*, const uint8_t* data, uint8_t len);
+void onResetGame(void*, const uint8_t* data, uint8_t len);
+
+constexpr auto canRoutes = makeCanRoutes({
+    CanEventAckP1::route(CAN_BASE_OWN, onEventAckP1),
+    CanEventAckP2::route(CAN_BASE_OWN, onEventAckP2),
+    CanInputP1::route(CAN_BASE_OWN, onInputP1),
+    CanInputP2::route(CAN_BASE_OWN, onInputP2),
+    CanStateHash::route(CAN_BASE_OWN, onStateHash),
+    CanResyncBall::route(CAN_BASE_OWN, onResync), // CanResyncScore har samme ID
+    CanHeartbeatEpochP1::route(CAN_BASE_OWN, onHeartbeatP1),
+    CanHeartbeatEpochP2::route(CAN_BASE_OWN, onHeartbeatP2),
+    CanPlateP1::route(CAN_BASE_OWN, onPlateP1),
+    CanPlateP2::route(CAN_BASE_OWN, onPlateP2),
+    CanBallPositionLegacy::route(CAN_BASE_OWN, onBallPosition),
+    CanScore::route(CAN_BASE_OWN, onGameOver),
+    CanResetGame::route(CAN_BASE_OWN, onResetGame),
+});
+CanDispatcher canDispatcher;
+
+// ------------------ Rollback ------------------
+constexpr bool useRollback = true;
+constexpr uint32_t tickMs = 10;          // 100 Hz, likt på begge nodene
+constexpr int maxCatchUpTicks = 5;       // maks ticks per runde hvis vi har ligget etter
+RollbackSession rollback;
+uint32_t rollbackStartMs = 0;
+uint8_t gameEpoch = 0;                   // økes ved hver reset, må være likt på begge
+uint32_t lastRollbackReportMs = 0;
+
+// Desync-sjekk: hash av bekreftet tilstand hver hashIntervalTicks
+constexpr uint32_t hashIntervalTicks = 50;
+constexpr int hashHistorySize = 4;
+struct TickHash {
+    uint32_t tick;
+    uint32_t hash;
+    bool valid;
+};
+TickHash ownHashes[hashHistorySize];
+TickHash peerHashes[hashHistorySize];
+uint32_t nextHashTick = hashIntervalTicks;
+uint32_t hashChecks = 0;
+uint32_t desyncCount = 0;
+uint32_t resyncCount = 0;
+CanResyncState resyncPartA; // første del av en resync, venter på andre del med samme tick
+bool hasResyncPartA = false;
+
+// ------------------ Heartbeat / failover ------------------
+constexpr uint32_t heartbeatPeriodMs = 100;
+constexpr uint32_t peerTimeoutMs = 500;  // lengre enn enhver delay() i loopen (lange pauser bruker waitWithService())
+constexpr uint32_t resumeRetryMs = 300;     // ny tilstand hvis motparten fortsatt ber om den
+constexpr uint8_t heartbeatInGame = 0x01;    // vi har et spill i gang
+constexpr uint8_t heartbeatNeedsState = 0x02; // vi har startet på nytt og venter på tilstanden
+constexpr uint8_t heartbeatDiverged = 0x04;   // vi har spilt alene og venter på P1 sin tilstand
+PeerMonitor peerMonitor(heartbeatPeriodMs, peerTimeoutMs);
+bool waitingForResume = false;  // har tatt ledig rolle etter restart, venter på tilstand
+bool peerNeedsState = false;
+bool peerDiverged = false;
+uint32_t lastResumeMs = 0;
+uint32_t resumeCount = 0;
+
 // ------------------ Spillvariabler ------------------
 // Plate
 int platePosition = 22;
@@ -59,7 +189,6 @@ int scoreP2 = 0; // P2 = Venstre spiller
 // ------------------ Spillets tilstand ------------------
 bool isPlayer2 = false;
 bool isPlayerAssigned = false;
-bool hasClaimedRole = false;
 
 // --- NYE VARIABLER FOR RESET ---
 const int WINNING_SCORE = 5; // Spiller til 5 poeng
@@ -91,12 +220,23 @@ void setup()
     display.setTextColor(SSD1306_WHITE);
     display.setCursor(30, 28);
     display.print("Venter...");
-    display.display();
+    oled.show(display);
 
     // Initialiser CAN-bus
     Can0.begin();
     Can0.setBaudRate(500000);
     Serial.println("CAN-bus startet!");
+
+    reliableEvents.addEventId(idGameOver);
+    reliableEvents.addEventId(idResetGame);
+    reliableEvents.begin(micros());
+
+    canDispatcher.setBases(groupNumber, groupNumber);
+    canDispatcher.setRoutes(canRoutes, nullptr);
+    canDispatcher.setExtendedHandler(onRoleFrame, nullptr); // bare rollefordelingen bruker utvidede ID-er
+
+    // Chip-ID-en er unik per Teensy, micros() skiller også to kort med like lave bits
+    roleArbiter.begin(SIM_UIDL ^ (SIM_UIDML << 11) ^ micros());
 }
 
 // ============================================================================
@@ -104,12 +244,26 @@ void setup()
 // ============================================================================
 bool handleJoystickInput();
 void handleRoleAssignment(bool moved);
+void takeRole(bool asPlayer2, bool joinRunningGame);
 void receiveCANMessages();
 void updateGameLogic();
 void drawDisplay();
 void sendCANMessages();
 void drawGameOverScreen(); // NY
 void resetGame();          // NY
+void startRollback(const PongSim* initial = nullptr);
+void runRollback();
+uint8_t readLocalMove();
+void sendStateHashes();
+void receiveStateHash(const uint8_t* data, uint8_t len);
+void compareHashes(uint32_t tick);
+void sendResync();
+void sendStateFrames(const PongSim& state, uint8_t firstPart, uint8_t epoch);
+void receiveResync(const uint8_t* data, uint8_t len);
+void handleHeartbeat();
+void receiveHeartbeat(uint32_t id, const uint8_t* data, uint8_t len);
+void sendResume();
+void waitWithService(uint32_t ms);
 
 
 // ============================================================================
@@ -125,15 +279,17 @@ void loop()
 
         // 2. Sjekk om DENNE spilleren vil restarte (trykker klikk)
         if (digitalRead(JOY_CLICK) == LOW) {
-            // Send reset-signal til den andre spilleren
-            CAN_message_t resetMsg;
-            resetMsg.id = idResetGame;
-            resetMsg.len = 1;
-            resetMsg.buf[0] = 1; // Signal om å restarte
-            Can0.write(resetMsg);
+            // Send reset-signal til den andre spilleren (sendes på nytt til den acker)
+            uint8_t resetData[CanResetGame::length]; // Signal om å restarte
+            reliableEvents.send(idResetGame, resetData, CanResetGame::encode({1}, resetData), millis());
             
             // Vent til knappen slippes (viktig!)
-            while(digitalRead(JOY_CLICK) == LOW) delay(10);
+            while(digitalRead(JOY_CLICK) == LOW) {
+                receiveCANMessages();
+                reliableEvents.update(millis());
+                handleHeartbeat(); // ellers tror motparten at vi er borte mens knappen holdes
+                delay(10);
+            }
             
             // Utfør lokal reset
             resetGame();
@@ -143,6 +299,12 @@ void loop()
         // (Må gjøres selv om vi venter på klikk)
         receiveCANMessages(); 
 
+        // Svar en node som starter og vil ha en rolle
+        handleRoleAssignment(false);
+
+        // Motparten kan trenge inputene våre for å bli sikker på at spillet er over
+        if (useRollback && isPlayerAssigned && !waitingForResume) runRollback();
+
     } else {
         // --- VANLIG SPIL-LØKKE ---
 
@@ -155,19 +317,27 @@ void loop()
         // 3. Motta og behandle alle innkommende CAN-meldinger
         receiveCANMessages();
 
-        // 4. Oppdater spill-logikk (KUN P1 gjør dette)
-        if (!isPlayer2 && isPlayerAssigned) {
+        // 4. Oppdater spill-logikk (rollback: begge, ellers KUN P1)
+        if (useRollback && isPlayerAssigned) {
+            if (!waitingForResume) runRollback();
+        } else if (!isPlayer2 && isPlayerAssigned) {
             updateGameLogic();
         }
 
         // 5. Tegn alt til skjermen
         drawDisplay();
 
-        // 6. Send relevante CAN-meldinger
-        sendCANMessages();
+        // 6. Send relevante CAN-meldinger (rollback sender bare input, i runRollback())
+        if (!useRollback) sendCANMessages();
     }
 
-    // 7. Kort pause for å stabilisere løkken
+    // 7. Send hendelser som ikke er acket på nytt
+    reliableEvents.update(millis());
+
+    // 8. Heartbeat, og ta over / forhandle på nytt hvis motparten forsvinner eller kommer tilbake
+    handleHeartbeat();
+
+    // 9. Kort pause for å stabilisere løkken
     delay(10); // 100 Hz
 }
 
@@ -192,69 +362,153 @@ bool handleJoystickInput() {
 }
 
 /*
- * Håndterer logikken for å bli P1 hvis man beveger seg først.
+ * Claimer P1 når spilleren beveger seg, sender rammene fra rollefordelingen og tar rollen
+ * når den er bestemt. Kalles hver runde, også etter at rollen er bestemt, for å svare
+ * noder som kommer senere.
  */
 void handleRoleAssignment(bool moved) {
-    if (moved && !isPlayerAssigned && !hasClaimedRole) {
-        isPlayer2 = false;
-        isPlayerAssigned = true;
-        hasClaimedRole = true;
-        Serial.println("Jeg ble Player 1!");
-
-        CAN_message_t claimMsg;
-        claimMsg.id = idRoleClaim;
-        claimMsg.len = 1;
-        claimMsg.buf[0] = 1;
-        Can0.write(claimMsg);
+    roleArbiter.addEntropy(micros()); // loopen har litt ulik timing på hver node
+    if (moved && !isPlayerAssigned) roleArbiter.claim(millis());
+    roleArbiter.setInGame(isPlayerAssigned && !waitingForResume);
+
+    CAN_message_t msgRole;
+    uint8_t len;
+    if (roleArbiter.pollFrame(millis(), msgRole.id, msgRole.buf, len)) {
+        msgRole.len = len;
+        msgRole.flags.extended = 1;
+        Can0.write(msgRole);
+    }
+
+    if (!roleArbiter.isDecided()) return;
+    bool arbiterSaysP2 = roleArbiter.role() == RoleArbiter::ROLE_P2;
+    if (!isPlayerAssigned) {
+        takeRole(arbiterSaysP2, roleArbiter.joinedRunningGame());
+    } else if (arbiterSaysP2 != isPlayer2) {
+        // Begge ble P1 alene og vi tapte på nonce: motparten har tilstanden, be om den
+        takeRole(arbiterSaysP2, true);
     }
 }
 
+void takeRole(bool asPlayer2, bool joinRunningGame) {
+    isPlayer2 = asPlayer2;
+    isPlayerAssigned = true;
+    reliableEvents.setAckId(isPlayer2 ? idEventAckP2 : idEventAckP1);
+    Serial.println(isPlayer2 ? "Jeg ble Player 2!" : "Jeg ble Player 1!");
+
+    // Har motparten et spill i gang venter vi på tilstanden fra den (se sendResume())
+    waitingForResume = useRollback && joinRunningGame;
+    if (useRollback && !waitingForResume) startRollback();
+}
+
+void sendReliableFrame(uint32_t id, const uint8_t* data, uint8_t len) {
+    CAN_message_t msg;
+    msg.id = id;
+    msg.len = len;
+    memcpy(msg.buf, data, len);
+    Can0.write(msg);
+}
+
 /*
  *Mottar og behandler alle CAN-meldinger i køen.
  */
 void receiveCANMessages() {
     CAN_message_t rxMsg;
-    while (Can0.read(rxMsg))
-    {
-        // 1. Rolleclaim
-        if (rxMsg.id == idRoleClaim && rxMsg.len >= 1 && !isPlayerAssigned) {
-            if (rxMsg.buf[0] == 1) {
-                isPlayer2 = true;
-                isPlayerAssigned = true;
-                Serial.println("Jeg ble Player 2!");
-            }
-        }
+    while (Can0.read(rxMsg)) {
+        canDispatcher.dispatch(rxMsg.id, rxMsg.flags.extended, rxMsg.buf, rxMsg.len);
+    }
+}
 
-        // 2. Plateposisjon fra motpart
-        const int rxPlateId = isPlayer2 ? idPlatePositionP1 : idPlatePositionP2;
-        if (rxMsg.id == rxPlateId && rxMsg.len >= 1) {
-            remotePlatePosition = rxMsg.buf[0];
-        }
+// 0. Rollefordeling
+void onRoleFrame(void*, uint32_t id, const uint8_t* data, uint8_t len) {
+    roleArbiter.receive(id, data, len);
+}
 
-        // 3. Ballposisjon (Bare P2 mottar)
-        if (isPlayer2 && rxMsg.id == idBallPosition && rxMsg.len == 2) {
-            xBall = SCREEN_WIDTH - rxMsg.buf[0]; // Inverter X-akse
-            yBall = rxMsg.buf[1];
-        }
+// Før rollen er bestemt kan vi bare bli P2, så da er motparten P1
+bool isFromPeer(bool fromP2) {
+    return fromP2 == (isPlayerAssigned && !isPlayer2);
+}
 
-        // 4. Motta poengsum (Bare P2 reagerer)
-        if (rxMsg.id == idGameOver && isPlayer2 && rxMsg.len == 2) {
-            scoreP1 = rxMsg.buf[0];
-            scoreP2 = rxMsg.buf[1];
-            
-            // NY: Sjekk om spillet er over
-            if (scoreP1 >= WINNING_SCORE || scoreP2 >= WINNING_SCORE) {
-                isGameOver = true;
-                // IKKE pause her, la hovedloopen håndtere "Game Over"
-            }
-        }
+// Ack fra motparten
+void onEventAckP1(void*, const uint8_t* data, uint8_t len) {
+    if (isFromPeer(false)) reliableEvents.receiveAck(data, len);
+}
 
-        // 5. NY: Motta Reset-signal
-        if (rxMsg.id == idResetGame && rxMsg.len == 1 && rxMsg.buf[0] == 1 && isGameOver) {
-            // Den andre spilleren vil restarte
-            Serial.println("Mottok reset-signal!");
-            resetGame();
-        }
+void onEventAckP2(void*, const uint8_t* data, uint8_t len) {
+    if (isFromPeer(true)) reliableEvents.receiveAck(data, len);
+}
+
+// 1. Input fra motparten (rollback)
+void onInputP1(void*, const uint8_t* data, uint8_t len) {
+    if (useRollback && isPlayerAssigned && isPlayer2) rollback.receiveInputFrame(data, len);
+}
+
+void onInputP2(void*, const uint8_t* data, uint8_t len) {
+    if (useRollback && isPlayerAssigned && !isPlayer2) rollback.receiveInputFrame(data, len);
+}
+
+void onStateHash(void*, const uint8_t* data, uint8_t len) {
+    if (useRollback && isPlayerAssigned) receiveStateHash(data, len);
+}
+
+void onResync(void*, const uint8_t* data, uint8_t len) {
+    if (useRollback && isPlayerAssigned) receiveResync(data, len);
+}
+
+// 1b. Heartbeat fra motparten (eller fra en node som allerede spiller, hvis vi nettopp startet)
+void onHeartbeatP1(void*, const uint8_t* data, uint8_t len) {
+    receiveHeartbeat(idHeartbeatP1, data, len);
+}
+
+void onHeartbeatP2(void*, const uint8_t* data, uint8_t len) {
+    receiveHeartbeat(idHeartbeatP2, data, len);
+}
+
+// 2. Plateposisjon fra motpart (P1 og P2 har samme innhold)
+void onPlateP1(void*, const uint8_t* data, uint8_t len) {
+    CanPlate plate;
+    if (isPlayer2 && CanPlateP1::decode(data, len, plate)) remotePlatePosition = plate.position;
+}
+
+void onPlateP2(void*, const uint8_t* data, uint8_t len) {
+    CanPlate plate;
+    if (!isPlayer2 && CanPlateP2::decode(data, len, plate)) remotePlatePosition = plate.position;
+}
+
+// 3. Ballposisjon (Bare P2 mottar)
+void onBallPosition(void*, const uint8_t* data, uint8_t len) {
+    CanBall ball;
+    if (isPlayer2 && CanBallPositionLegacy::decode(data, len, ball)) {
+        xBall = SCREEN_WIDTH - ball.x; // Inverter X-akse
+        yBall = ball.y;
+    }
+}
+
+// 4. Motta poengsum (Bare P2 reagerer). Hendelser acker og fjerner duplikater, så gamle
+// retransmisjoner blir ikke behandlet på nytt.
+void onGameOver(void*, const uint8_t* data, uint8_t len) {
+    uint8_t payloadLen = 0;
+    CanPoints score;
+    if (!reliableEvents.receive(idGameOver, data, len, payloadLen)) return;
+    if (!isPlayer2 || !CanScore::decode(data, payloadLen, score)) return;
+    scoreP1 = score.scoreP1;
+    scoreP2 = score.scoreP2;
+
+    // NY: Sjekk om spillet er over
+    if (scoreP1 >= WINNING_SCORE || scoreP2 >= WINNING_SCORE) {
+        isGameOver = true;
+        // IKKE pause her, la hovedloopen håndtere "Game Over"
+    }
+}
+
+// 5. NY: Motta Reset-signal
+void onResetGame(void*, const uint8_t* data, uint8_t len) {
+    uint8_t payloadLen = 0;
+    CanReset reset;
+    if (!reliableEvents.receive(idResetGame, data, len, payloadLen)) return;
+    if (CanResetGame::decode(data, payloadLen, reset) && reset.request == 1 && isGameOver) {
+        // Den andre spilleren vil restarte
+        Serial.println("Mottok reset-signal!");
+        resetGame();
     }
 }
 
@@ -309,13 +563,9 @@ void updateGameLogic() {
             scoreP1++; // P1 (høyre) scorer
         }
 
-        // Send ALLTID poengsum til P2
-        CAN_message_t scoreMsg;
-        scoreMsg.id = idGameOver;
-        scoreMsg.len = 2;
-        scoreMsg.buf[0] = scoreP1;
-        scoreMsg.buf[1] = scoreP2;
-        Can0.write(scoreMsg);
+        // Send ALLTID poengsum til P2 (sendes på nytt til P2 acker)
+        uint8_t scoreData[CanScore::length];
+        reliableEvents.send(idGameOver, scoreData, CanScore::encode({scoreP1, scoreP2}, scoreData), millis());
 
         // NY: Sjekk om spillet er VUNNET
         if (scoreP1 >= WINNING_SCORE || scoreP2 >= WINNING_SCORE) {
@@ -323,7 +573,7 @@ void updateGameLogic() {
             // IKKE reset ballen, la loopen gå til "Game Over"-tilstand
         } else {
             // Spillet er IKKE over, bare reset for neste runde
-            delay(2000); // Pause for at spillerne skal se
+            waitWithService(2000); // Pause for at spillerne skal se
             xBall = SCREEN_WIDTH / 2;
             yBall = SCREEN_HEIGHT / 2;
             xVelocity = -1; // Serve alltid mot P2
@@ -356,6 +606,8 @@ void drawDisplay() {
     if (!isPlayerAssigned) display.print("P JS 1. to be P1");
     else if (isPlayer2) display.print("P2 (V)");
     else display.print("P1 (H)");
+    if (waitingForResume) display.print(" henter spill");
+    else if (isPlayerAssigned && peerMonitor.hasBeenSeen() && !peerMonitor.isAlive()) display.print(" alene");
 
     // 3. Plater
     if (remotePlatePosition >= 0)
@@ -365,8 +617,8 @@ void drawDisplay() {
     // 4. Ball
     display.fillCircle(xBall, yBall, ballRadius, SSD1306_WHITE);
 
-    // 5. Vis alt
-    display.display();
+    // 5. Vis det som er endret
+    oled.show(display);
 }
 
 /*
@@ -376,23 +628,329 @@ void sendCANMessages() {
     if (isPlayerAssigned) {
         // 1. Send EGEN plateposisjon
         CAN_message_t msgPlatePosition;
-        msgPlatePosition.id = isPlayer2 ? idPlatePositionP2 : idPlatePositionP1;
-        msgPlatePosition.len = 1;
-        msgPlatePosition.buf[0] = platePosition;
+        if (isPlayer2) CanPlateP2::encode({platePosition, 0}, groupNumber, msgPlatePosition);
+        else CanPlateP1::encode({platePosition, 0}, groupNumber, msgPlatePosition);
         Can0.write(msgPlatePosition);
 
         // 2. Bare P1 sender ballposisjonen
         if (!isPlayer2) {
             CAN_message_t msgBall;
-            msgBall.id = idBallPosition;
-            msgBall.len = 2;
-            msgBall.buf[0] = xBall;
-            msgBall.buf[1] = yBall;
+            CanBallPositionLegacy::encode({xBall, yBall, 0, 0, 0}, groupNumber, msgBall);
             Can0.write(msgBall);
         }
     }
 }
 
+// ============================================================================
+// ROLLBACK
+// ============================================================================
+
+/*
+ * Starter simuleringen fra tick 0. Kalles når rollen er bestemt og etter reset, eller
+ * med initial når en økt fortsetter etter at en node har startet på nytt.
+ * Nodene starter litt forskjøvet (en CAN-ramme), det tas igjen av rollbacken.
+ */
+void startRollback(const PongSim* initial) {
+    rollback.start(isPlayer2 ? 1 : 0, gameEpoch, initial);
+    rollbackStartMs = millis();
+
+    nextHashTick = hashIntervalTicks;
+    hasResyncPartA = false;
+    for (int i = 0; i < hashHistorySize; i++) {
+        ownHashes[i].valid = false;
+        peerHashes[i].valid = false;
+    }
+}
+
+uint8_t readLocalMove() {
+    if (digitalRead(JOY_UP) == LOW) return MOVE_UP;
+    if (digitalRead(JOY_DOWN) == LOW) return MOVE_DOWN;
+    return MOVE_NONE;
+}
+
+/*
+ * Kjører simuleringen frem til nåværende tick, sender input og kopierer tilstanden
+ * til variablene som drawDisplay() bruker.
+ */
+void runRollback() {
+    uint32_t targetTick = (millis() - rollbackStartMs) / tickMs;
+    uint8_t move = readLocalMove();
+    for (int i = 0; i < maxCatchUpTicks && rollback.tick() < targetTick; i++) {
+        if (!rollback.advance(move)) break; // motparten er for langt bak, vent
+    }
+    rollback.resolve();
+
+    // Input sendes hver runde, også når vi venter, så motparten kan fylle hull
+    CAN_message_t msgInput;
+    msgInput.id = isPlayer2 ? idInputP2 : idInputP1;
+    msgInput.len = rollback.makeInputFrame(msgInput.buf);
+    Can0.write(msgInput);
+
+    // Simuleringen er sett fra P1. P2 har sin plate til høyre og speiler X.
+    const PongSim& state = rollback.state();
+    platePosition = isPlayer2 ? state.plateP2 : state.plateP1;
+    remotePlatePosition = isPlayer2 ? state.plateP1 : state.plateP2;
+    xBall = isPlayer2 ? SCREEN_WIDTH - state.xBall : state.xBall;
+    yBall = state.yBall;
+    scoreP1 = state.scoreP1;
+    scoreP2 = state.scoreP2;
+
+    // Game over bare når det ikke lenger kan bli spolt tilbake
+    if (state.gameOver && rollback.isGameOverConfirmed()) isGameOver = true;
+
+    sendStateHashes();
+
+    if (millis() - lastRollbackReportMs >= 5000) {
+        lastRollbackReportMs = millis();
+        Serial.print("Rollback: tick ");
+        Serial.print(rollback.tick());
+        Serial.print(", feil gjetninger ");
+        Serial.print(rollback.mispredictions());
+        Serial.print(", tilbakespolinger ");
+        Serial.print(rollback.rollbacks());
+        Serial.print(", ticks simulert på nytt ");
+        Serial.print(rollback.resimulatedTicks());
+        Serial.print(", hash-sjekker ");
+        Serial.print(hashChecks);
+        Serial.print(", desync ");
+        Serial.print(desyncCount);
+        Serial.print(", resync ");
+        Serial.print(resyncCount);
+        Serial.print(", gjenopptatt ");
+        Serial.println(resumeCount);
+    }
+}
+
+/*
+ * Sender hash av tilstanden ved hver hashIntervalTicks, så snart den ticken er bekreftet
+ * (da skal begge nodene ha nøyaktig samme tilstand).
+ */
+void sendStateHashes() {
+    PongSim snapshot;
+    while (rollback.snapshotAt(nextHashTick, snapshot)) {
+        uint32_t hash = snapshot.hash();
+        TickHash& own = ownHashes[(nextHashTick / hashIntervalTicks) % hashHistorySize];
+        own.tick = nextHashTick;
+        own.hash = hash;
+        own.valid = true;
+
+        CAN_message_t msgHash;
+        CanStateHash::encode({gameEpoch, nextHashTick, hash}, groupNumber, msgHash);
+        Can0.write(msgHash);
+
+        compareHashes(nextHashTick);
+        nextHashTick += hashIntervalTicks;
+    }
+
+    // Har vi ligget så langt etter at ticken er ute av ringbufferet, hopper vi over den
+    uint32_t oldest = rollback.tick() >= (uint32_t)RollbackSession::historySize ? rollback.tick() - RollbackSession::historySize + 1 : 0;
+    while (nextHashTick < oldest) nextHashTick += hashIntervalTicks;
+}
+
+void receiveStateHash(const uint8_t* data, uint8_t len) {
+    CanHash frame;
+    if (!CanStateHash::decode(data, len, frame) || frame.epoch != gameEpoch) return;
+    uint32_t tick = rollback.unwrapTick(frame.tick);
+    if (tick % hashIntervalTicks != 0) return;
+
+    TickHash& peer = peerHashes[(tick / hashIntervalTicks) % hashHistorySize];
+    peer.tick = tick;
+    peer.hash = frame.hash;
+    peer.valid = true;
+    compareHashes(tick);
+}
+
+/*
+ * Sammenligner når vi har begge hashene for samme tick. Begge nodene ser en desync,
+ * men bare P1 (autoriteten) sender tilstanden sin.
+ */
+void compareHashes(uint32_t tick) {
+    TickHash& own = ownHashes[(tick / hashIntervalTicks) % hashHistorySize];
+    TickHash& peer = peerHashes[(tick / hashIntervalTicks) % hashHistorySize];
+    if (!own.valid || !peer.valid || own.tick != tick || peer.tick != tick) return;
+
+    hashChecks++;
+    bool equal = own.hash == peer.hash;
+    own.valid = false;
+    peer.valid = false;
+    if (equal) return;
+
+    desyncCount++;
+    Serial.print("DESYNC ved tick ");
+    Serial.println(tick);
+    if (!isPlayer2) sendResync();
+}
+
+/*
+ * P1 sender siste bekreftede tilstand i to rammer, del 0 (CanResyncBall) og del 1
+ * (CanResyncScore) i felles/canmessages.h. Ved gjenopptak etter restart brukes samme
+ * format med del 2 og 3 (se sendResume()).
+ */
+void sendResync() {
+    PongSim state;
+    if (!rollback.snapshotAt(rollback.latestConfirmedTick(), state)) return;
+    sendStateFrames(state, 0, gameEpoch);
+}
+
+void sendStateFrames(const PongSim& state, uint8_t firstPart, uint8_t epoch) {
+    CanResyncState frame;
+    frame.tick = state.tick;
+    frame.x = state.xBall + 64;
+    frame.y = state.yBall;
+    frame.vx = state.xVelocity;
+    frame.vy = state.yVelocity;
+    frame.plateP1 = state.plateP1;
+    frame.plateP2 = state.plateP2;
+    frame.scoreP1 = state.scoreP1;
+    frame.scoreP2 = state.scoreP2;
+    frame.pauseTicks = state.pauseTicks;
+    frame.gameOver = state.gameOver;
+    frame.epoch = epoch;
+
+    CAN_message_t partA;
+    frame.part = firstPart;
+    CanResyncBall::encode(frame, groupNumber, partA);
+    Can0.write(partA);
+
+    CAN_message_t partB;
+    frame.part = firstPart + 1;
+    CanResyncScore::encode(frame, groupNumber, partB);
+    Can0.write(partB);
+}
+
+void receiveResync(const uint8_t* data, uint8_t len) {
+    CanResyncState frame;
+    if (!CanResyncScore::decode(data, len, frame)) return;
+    if (frame.part == 0 || frame.part == 2) {
+        CanResyncBall::decode(data, len, resyncPartA);
+        hasResyncPartA = true;
+        return;
+    }
+    bool isResume = frame.part == 3;
+    if ((frame.part != 1 && !isResume) || !hasResyncPartA || resyncPartA.part + 1 != frame.part) return;
+    if (resyncPartA.tick != frame.tick) return; // delene hører ikke sammen
+    if (!isResume && (!isPlayer2 || frame.epoch != gameEpoch)) return;    // resync går bare fra P1 til P2
+    hasResyncPartA = false;
+
+    PongSim state;
+    state.tick = rollback.unwrapTick(frame.tick);
+    state.xBall = resyncPartA.x - 64;
+    state.yBall = resyncPartA.y;
+    state.xVelocity = resyncPartA.vx;
+    state.yVelocity = resyncPartA.vy;
+    state.plateP1 = resyncPartA.plateP1;
+    state.plateP2 = resyncPartA.plateP2;
+    state.scoreP1 = frame.scoreP1;
+    state.scoreP2 = frame.scoreP2;
+    state.pauseTicks = frame.pauseTicks;
+    state.gameOver = frame.gameOver != 0;
+
+    // Motparten har tilstanden etter en restart eller et brudd: ny økt derfra med dens spill-nr
+    if (isResume) {
+        gameEpoch = frame.epoch;
+        waitingForResume = false;
+        startRollback(&state);
+        resumeCount++;
+        Serial.print("Fortsetter spillet fra motparten, ");
+        Serial.print(state.scoreP2);
+        Serial.print("-");
+        Serial.println(state.scoreP1);
+        return;
+    }
+
+    if (rollback.applyAuthoritativeState(state)) {
+        resyncCount++;
+        Serial.print("Resync fra P1 ved tick ");
+        Serial.println(state.tick);
+    }
+}
+
+// ============================================================================
+// HEARTBEAT OG FAILOVER
+// ============================================================================
+
+/*
+ * Sender egen heartbeat og reagerer når motparten forsvinner eller kommer tilbake.
+ * Borte: vi spiller videre alene. Tilbake: den som har tilstanden sender den (sendResume()).
+ * Har begge spilt videre alene, er det P1 sin tilstand som gjelder.
+ */
+void handleHeartbeat() {
+    uint32_t now = millis();
+    if (isPlayerAssigned && peerMonitor.heartbeatDue(now)) {
+        uint8_t flags = waitingForResume ? heartbeatNeedsState : heartbeatInGame;
+        if (useRollback && !waitingForResume && !rollback.isPeerOnline() && peerMonitor.isAlive()) flags |= heartbeatDiverged;
+        CAN_message_t msgHeartbeat;
+        if (isPlayer2) CanHeartbeatEpochP2::encode({flags, gameEpoch}, groupNumber, msgHeartbeat);
+        else CanHeartbeatEpochP1::encode({flags, gameEpoch}, groupNumber, msgHeartbeat);
+        Can0.write(msgHeartbeat);
+    }
+
+    PeerMonitor::Event event = peerMonitor.update(now);
+    if (event == PeerMonitor::PEER_LOST) {
+        Serial.println("Motparten svarer ikke, spiller videre alene");
+        if (useRollback && !waitingForResume) rollback.setPeerOnline(false);
+    }
+    if (event == PeerMonitor::PEER_RETURNED) {
+        Serial.println("Motparten er tilbake");
+    }
+
+    if (!useRollback || !isPlayerAssigned || waitingForResume) return;
+    bool resumeWanted = peerNeedsState || (!isPlayer2 && (event == PeerMonitor::PEER_RETURNED || peerDiverged));
+    if (resumeWanted && now - lastResumeMs >= resumeRetryMs) sendResume();
+}
+
+/*
+ * Pause som holder CAN, hendelser og heartbeat i gang. En vanlig delay() lenger enn
+ * peerTimeoutMs ser ut som at vi har falt ut for motparten.
+ */
+void waitWithService(uint32_t ms) {
+    uint32_t start = millis();
+    while (millis() - start < ms) {
+        receiveCANMessages();
+        reliableEvents.update(millis());
+        handleHeartbeat();
+        delay(10);
+    }
+}
+
+void receiveHeartbeat(uint32_t id, const uint8_t* data, uint8_t len) {
+    CanHeartbeat heartbeat;
+    if (!CanHeartbeatEpochP1::decode(data, len, heartbeat)) return; // P1 og P2 har samme innhold
+
+    // Vi har nettopp startet og en annen node spiller allerede: ta den ledige rollen og
+    // be om tilstanden i stedet for å starte et nytt spill. Har vi claimet (eller er rollen
+    // bestemt, men ikke tatt enda) er det bare rollefordelingen som gir rollen: motparten kan
+    // ha blitt P2 av claimen vår og sende heartbeat før vi har fått svaret.
+    if (!isPlayerAssigned) {
+        if (roleArbiter.hasClaimed() || roleArbiter.isDecided()) return;
+        if (!(heartbeat.flags & heartbeatInGame)) return;
+        Serial.println("Fant spill i gang");
+        takeRole(id == idHeartbeatP1, true);
+        roleArbiter.setRole(isPlayer2 ? RoleArbiter::ROLE_P2 : RoleArbiter::ROLE_P1);
+    }
+
+    const uint32_t peerHeartbeatId = isPlayer2 ? idHeartbeatP1 : idHeartbeatP2;
+    if (id != peerHeartbeatId) return;
+    peerMonitor.heard(millis());
+    peerNeedsState = (heartbeat.flags & heartbeatNeedsState) != 0;
+    peerDiverged = (heartbeat.flags & heartbeatDiverged) != 0;
+}
+
+/*
+ * Sender hele tilstanden vår som del 2 og 3 på ID 30 og starter en ny økt fra den med
+ * nytt spill-nr. Motparten gjør det samme når den får rammene.
+ */
+void sendResume() {
+    lastResumeMs = millis();
+    rollback.resolve();
+    PongSim state = rollback.state();
+
+    gameEpoch++;
+    sendStateFrames(state, 2, gameEpoch);
+    startRollback(&state);
+    Serial.println("Sendte tilstanden til motparten");
+}
+
 // ============================================================================
 // NYE FUNKSJONER FOR GAME OVER / RESET
 // ============================================================================
@@ -429,7 +987,7 @@ void drawGameOverScreen() {
     display.setCursor(45, 50);
     display.print("spill");
 
-    display.display();
+    oled.show(display);
 }
 
 /*
@@ -451,6 +1009,7 @@ void resetGame() {
     xVelocity = 1; // Start mot P1
     yVelocity = 1;
 
-    // Gi en kort pause for å unngå "flimmer" eller race conditions
-    delay(500);
+    // Nytt spill i rollback-modus: begge nodene resetter, så spill-nr blir likt
+    gameEpoch++;
+    if (useRollback && isPlayerAssigned) startRollback();
 }
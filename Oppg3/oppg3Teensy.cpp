@@ -12,6 +12,14 @@
 #include <Adafruit_SSD1306.h> // Rettet skrivefeil her
 #include <SPI.h>
 #include <FlexCAN_T4.h>
+#include "../felles/reliableevents.h"
+#include "../felles/clocksync.h"
+#include "../felles/ballpredictor.h"
+#include "../felles/heartbeat.h"
+#include "../felles/hello.h"
+#include "../felles/canmessages.h"
+#include "../felles/candispatch.h"
+#include "../felles/ssd1306spi.h"
 
 // ------------------ Hardware ------------------
 constexpr int JOY_RIGHT = 17; 
@@ -27,24 +35,84 @@ constexpr int SCREEN_WIDTH  = 128;
 constexpr int SCREEN_HEIGHT = 64;
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &SPI, OLED_DC, OLED_RESET, OLED_CS);
 
+// oled.show(display) i stedet for display.display(): bare endringene går over SPI
+Ssd1306Spi oled(SPI, OLED_DC, OLED_CS);
+
 
 // ------------------ CAN-konfig (Må matche Server) ------------------
 constexpr int groupNumber = 6;
 
+// ID-ene og innholdet står i felles/canmessages.h
 // --- Sending (Input til Server) ---
-constexpr int idJoystickP1 = groupNumber + 19; // ID 25
+constexpr int idJoystickP1 = CanJoystickP1::id(groupNumber);       // ID 25 [tilstand, seq]
+constexpr int idTimePing   = CanTimePing::id(groupNumber);         // ID 65 (klokke-ping, se felles/clocksync.h)
+constexpr int idHeartbeat  = CanHeartbeatP1::id(groupNumber);      // ID 31 (heartbeat, se felles/heartbeat.h)
+constexpr int idSnapshotRequest = CanSnapshotRequest::id(groupNumber); // ID 67 (be om hele tilstanden etter oppstart)
+constexpr int idHello      = CanHello::id(groupNumber);            // ID 69 (hva vi kan, se felles/hello.h)
 
 // --- Mottak (State fra Server) ---
-constexpr int idPlatePositionP1 = groupNumber + 20; // ID 26
-constexpr int idPlatePositionP2 = groupNumber + 21; // ID 27
-constexpr int idBallPosition    = groupNumber + 50; // ID 56
-constexpr int idGameOver        = groupNumber + 51; // ID 57
-constexpr int idResetGame       = groupNumber + 52; // ID 58
+constexpr int idPlatePositionP1 = CanPlateAckP1::id(groupNumber);  // ID 26 [posisjon, siste input-seq serveren har brukt]
+constexpr int idPlatePositionP2 = CanPlateP2::id(groupNumber);     // ID 27
+constexpr int idBallTrajectory  = CanBallTrajectory::id(groupNumber); // ID 55 (banemodus)
+constexpr int idBallPosition    = CanBallPosition::id(groupNumber);   // ID 56
+constexpr int idGameOver        = CanScore::id(groupNumber);       // ID 57
+constexpr int idResetGame       = CanResetGame::id(groupNumber);   // ID 58 (Teensy -> server)
+constexpr int idResetAck        = CanResetAck::id(groupNumber);    // ID 59 (server -> Teensy, spillet er resatt)
+constexpr int idEventAckServer  = CanEventAckP1::id(groupNumber);  // ID 63 (ack fra server)
+constexpr int idEventAckClient  = CanEventAckP2::id(groupNumber);  // ID 64 (ack fra oss)
+constexpr int idTimePong        = CanTimePong::id(groupNumber);    // ID 66 (svar på klokke-ping)
+constexpr int idSnapshot        = CanSnapshotReply::id(groupNumber); // ID 68
+constexpr int idHelloReply      = CanHelloReply::id(groupNumber);  // ID 70 (valgt protokoll, eller hvorfor ikke)
 
 FlexCAN_T4<CAN0, RX_SIZE_256, TX_SIZE_16> Can0;
+constexpr uint32_t canBitrate = 250000; // må være lik på alle nodene, kan ikke forhandles
+
+// Score, reset og reset ack sendes med sekvensnummer og ack (se felles/reliableevents.h)
+void sendReliableFrame(uint32_t id, const uint8_t* data, uint8_t len);
+ReliableEvents reliableEvents(sendReliableFrame, idEventAckClient);
+
+// Klokkesynk mot serveren. Pinger ofte til vinduet er fullt, deretter sjeldnere.
+ClockSync clockSync;
+const uint32_t fastPingIntervalMs = 50;
+const uint32_t slowPingIntervalMs = 500;
+uint32_t lastPingMs = 0;
+
+// Forsinkelse fra serveren laget ballrammen til vi leste den (vises på Serial hvert sekund)
+uint32_t ballFrameLocalUs = 0; // når ballposisjonen gjaldt, i vår tid (micros())
+uint32_t latencySumUs = 0;
+uint32_t latencyMaxUs = 0;
+uint32_t latencyCount = 0;
+uint32_t lastLatencyReportMs = 0;
+
+// Ballen flyttes hver runde ut fra siste ramme og farten (se felles/ballpredictor.h)
+BallPredictor ballPredictor;
+
+// Heartbeat til serveren, så den ser om vi har falt ut. Serveren regnes som borte hvis
+// vi ikke har fått noen ramme fra den på serverTimeoutMs.
+constexpr uint32_t heartbeatPeriodMs = 100;
+constexpr uint32_t serverTimeoutMs = 500;
+PeerMonitor serverMonitor(heartbeatPeriodMs, serverTimeoutMs);
+
+// Etter oppstart ber vi serveren om hele tilstanden (poeng, fase, posisjoner) i stedet for
+// å vise 0-0 til neste mål. Spørres på nytt til svaret kommer.
+constexpr uint32_t snapshotRetryMs = 100;
+constexpr uint32_t snapshotWaitMs = 30;   // i setup(): svaret kommer innen en tick hos serveren
+constexpr uint8_t phaseGameOver = 2;      // samme som PHASE_GAMEOVER i del3/sharedgamestate.h
+bool hasSnapshot = false;
+uint32_t lastSnapshotRequestMs = 0;
+
+// Hello ved oppstart: vi og serveren blir enige om versjon, rammeformat og funksjoner.
+// Sier serveren nei, står grunnen på skjermen i stedet for et spill med søppel.
+// Kommer det ikke noe svar i det hele tatt er bitraten det første å sjekke.
+constexpr uint32_t helloRetryMs = 200;
+constexpr int helloMaxAttempts = 5;
+bool hasHelloReply = false;
+int helloAttempts = 0;
+uint32_t lastHelloMs = 0;
+HelloAgreement helloAgreement;
 
 // ------------------ Spillvariabler (Styres av Server) ------------------
-int platePosition = 22;       // P1 (Høyre)
+int platePosition = 22;       // P1 (Høyre), slik den tegnes
 int remotePlatePosition = 22; // P2 (Venstre)
 int xBall = 64;
 int yBall = 32;
@@ -61,10 +129,74 @@ const int ballRadius = 3;
 const int WINNING_SCORE = 5; 
 bool isGameOver = false;
 
-// For å unngå CAN-spam (sender kun ved endring)
+// Sender én ramme per runde mens joysticken holdes, og én når den slippes
 int currentMoveState = 0; // 0 = Stille, 1 = Opp, 2 = Ned
 int lastMoveState = -1;   
 
+// ------------------ Client-side prediction av egen plate ------------------
+// Hver joystick-ramme har et sekvensnummer og flytter platen én gang hos serveren.
+// Vi flytter platen med en gang selv, og husker rammene serveren ikke har bekreftet.
+// Når ID 26 kommer starter vi fra serverens posisjon og legger på de ubekreftede på nytt.
+constexpr int plateSpeedP1 = 4;          // må være lik serveren
+constexpr int maxPendingInputs = 32;
+uint8_t pendingInputs[maxPendingInputs]; // tilstand for seq = oldestPendingSeq + i
+uint8_t oldestPendingSeq = 0;
+uint8_t nextInputSeq = 0;
+int pendingInputCount = 0;
+int serverPlatePosition = 22;            // siste posisjon fra serveren
+int predictedPlatePosition = 22;
+float plateCorrection = 0;               // tegnes som predicted + correction, krymper hver runde
+constexpr float plateCorrectionDecay = 0.6f;
+constexpr int plateSnapDistance = 12;
+
+
+// ============================================================================
+// Funksjons-prototyper
+// ============================================================================
+void handleJoystickInput();
+void receiveCANMessages();
+void drawDisplay();
+void sendCANMessages();
+void sendTimePing();
+void handleHeartbeat();
+void requestSnapshot();
+void applySnapshot(const uint8_t* data, uint8_t len);
+HelloCapabilities ownCapabilities();
+void sendHello();
+void handleHelloReply(const uint8_t* data, uint8_t len);
+void drawHelloError();
+int movePlate(int position, int moveState);
+void reconcilePlate(int serverPosition, uint8_t ackSeq);
+void reportLatency();
+void drawGameOverScreen();
+void resetGame(); 
+
+// Mottak: én rute per ID (felles/candispatch.h)
+void onEventAck(void*, const uint8_t* data, uint8_t len);
+void onPlateP1(void*, const uint8_t* data, uint8_t len);
+void onPlateP2(void*, const uint8_t* data, uint8_t len);
+void onBallTrajectory(void*, const uint8_t* data, uint8_t len);
+void onSnapshot(void*, const uint8_t* data, uint8_t len);
+void onHelloReply(void*, const uint8_t* data, uint8_t len);
+void onTimePong(void*, const uint8_t* data, uint8_t len);
+void onBallPosition(void*, const uint8_t* data, uint8_t len);
+void onGameOver(void*, const uint8_t* data, uint8_t len);
+void onResetAck(void*, const uint8_t* data, uint8_t len);
+
+constexpr auto canRoutes = makeCanRoutes({
+  CanEventAckP1::route(CAN_BASE_OWN, onEventAck),
+  CanPlateP1::route(CAN_BASE_OWN, onPlateP1),             // CanPlateAckP1 har samme ID
+  CanPlateP2::route(CAN_BASE_OWN, onPlateP2),
+  CanBallTrajectory::route(CAN_BASE_OWN, onBallTrajectory),
+  CanSnapshotReply::route(CAN_BASE_OWN, onSnapshot),
+  CanHelloReply::route(CAN_BASE_OWN, onHelloReply),
+  CanTimePong::route(CAN_BASE_OWN, onTimePong),
+  CanBallPositionLegacy::route(CAN_BASE_OWN, onBallPosition), // det gamle formatet er kortest
+  CanScore::route(CAN_BASE_OWN, onGameOver),
+  CanResetAck::route(CAN_BASE_OWN, onResetAck),
+});
+CanDispatcher canDispatcher;
+
 
 // ============================================================================
 // SETUP
@@ -88,49 +220,62 @@ void setup()
   display.setTextColor(SSD1306_WHITE);
   display.setCursor(15, 28);
   display.print("Kobler til server...");
-  display.display();
+  oled.show(display);
 
   // Start CAN
   Can0.begin();
-  Can0.setBaudRate(250000);
+  Can0.setBaudRate(canBitrate);
   Serial.println("CAN-bus startet!");
-}
-
-// ============================================================================
-// Funksjons-prototyper
-// ============================================================================
-void handleJoystickInput();
-void receiveCANMessages();
-void drawDisplay();
-void sendCANMessages();
-void drawGameOverScreen();
-void resetGame(); 
 
+  reliableEvents.addEventId(idGameOver);
+  reliableEvents.addEventId(idResetGame);
+  reliableEvents.addEventId(idResetAck);
+  reliableEvents.addEventId(idBallTrajectory);
+  reliableEvents.begin(micros());
+
+  canDispatcher.setBases(groupNumber, groupNumber);
+  canDispatcher.setRoutes(canRoutes, nullptr);
+
+  // Hent tilstanden før første tegning, så skjermen er riktig med en gang
+  sendHello();
+  requestSnapshot();
+  uint32_t waitStart = millis();
+  while (!hasSnapshot && millis() - waitStart < snapshotWaitMs) receiveCANMessages();
+  if (hasSnapshot && isGameOver) drawGameOverScreen();
+  else if (hasSnapshot) drawDisplay();
+}
 
 // ============================================================================
 // HOVEDLØKKE
 // ============================================================================
 void loop()
 {
+  if (hasHelloReply && helloAgreement.result != HELLO_OK) {
+    // --- INGEN FELLES PROTOKOLL ---
+    // Prøver igjen av og til, serveren kan ha blitt startet på nytt med et annet oppsett
+    drawHelloError();
+    receiveCANMessages();
+    if (millis() - lastHelloMs >= 1000) sendHello();
+    delay(10);
+    return;
+  }
+
   if (isGameOver) {
     // --- GAME OVER MODUS ---
     drawGameOverScreen();
 
     // Hvis P1 trykker Reset (Joystick-klikk)
     if (digitalRead(JOY_CLICK) == LOW) {
-      CAN_message_t resetMsg;
-      resetMsg.id = idResetGame;
-      resetMsg.len = 1;
-      resetMsg.buf[0] = 1; 
-
-      // Send meldingen 3 ganger for å være sikker på at Pi mottar den
-      for(int i=0; i<3; i++) {
-         Can0.write(resetMsg);
-         delay(5);
-      }
+      // Sendes til Pi-en acker, i stedet for 3 ganger i blinde
+      uint8_t resetData[CanResetGame::length];
+      reliableEvents.send(idResetGame, resetData, CanResetGame::encode({1}, resetData), millis());
       
-      // Vent til knappen slippes
-      while(digitalRead(JOY_CLICK) == LOW) delay(10);
+      // Vent til knappen slippes (og fortsett å sende på nytt/ta imot ack imens)
+      while(digitalRead(JOY_CLICK) == LOW) {
+        receiveCANMessages();
+        reliableEvents.update(millis());
+        delay(10);
+      }
 
       // --- VIKTIG ENDRING ---
       // Vi kjører IKKE resetGame() her lenger.
@@ -138,7 +283,7 @@ void loop()
       display.fillRect(0, 50, SCREEN_WIDTH, 14, SSD1306_BLACK); // Tøm bunnen av skjermen
       display.setCursor(10, 54);
       display.print("Venter pa server...");
-      display.display();
+      oled.show(display);
     }
     
     // Denne funksjonen vil nå motta reset-signalet fra Pi-en
@@ -153,6 +298,12 @@ void loop()
     drawDisplay();         // Tegn skjerm
   }
 
+  reliableEvents.update(millis()); // send hendelser som ikke er acket på nytt
+  if (!hasSnapshot && millis() - lastSnapshotRequestMs >= snapshotRetryMs) requestSnapshot();
+  if (!hasHelloReply && millis() - lastHelloMs >= helloRetryMs) sendHello();
+  sendTimePing();
+  handleHeartbeat();
+  reportLatency();
   delay(10); // 100 Hz oppdatering
 }
 // ============================================================================
@@ -172,43 +323,308 @@ void handleJoystickInput() {
 }
 
 void sendCANMessages() {
-  if (currentMoveState == lastMoveState) {
-    return; // Ikke spam nettet hvis ingen endring
+  if (currentMoveState == 0 && lastMoveState == 0) {
+    return; // Ikke spam nettet når joysticken står stille
   }
 
+  uint8_t seq = nextInputSeq++;
   CAN_message_t joyMsg;
-  joyMsg.id = idJoystickP1; // ID 25
-  joyMsg.len = 1;
-  joyMsg.buf[0] = currentMoveState;
+  CanJoystickP1::encode({currentMoveState, seq}, groupNumber, joyMsg); // ID 25
   Can0.write(joyMsg);
 
+  // Husk rammen til serveren har bekreftet den (den eldste kastes hvis bufferet er fullt)
+  if (pendingInputCount == maxPendingInputs) {
+    for (int i = 1; i < pendingInputCount; i++) pendingInputs[i - 1] = pendingInputs[i];
+    oldestPendingSeq++;
+    pendingInputCount--;
+  }
+  if (pendingInputCount == 0) oldestPendingSeq = seq;
+  pendingInputs[(uint8_t)(seq - oldestPendingSeq)] = currentMoveState;
+  pendingInputCount++;
+
+  // Flytt platen med en gang, samme regel som serveren
+  predictedPlatePosition = movePlate(predictedPlatePosition, currentMoveState);
+
   lastMoveState = currentMoveState;
 }
 
+int movePlate(int position, int moveState) {
+  if (moveState == 1) position = max(0, position - plateSpeedP1);
+  if (moveState == 2) position = min(SCREEN_HEIGHT - plateHeight, position + plateSpeedP1);
+  return position;
+}
+
+void reconcilePlate(int serverPosition, uint8_t ackSeq) {
+  // Kast det serveren har brukt. Et seq utenfor vinduet er eldre enn det vi venter på.
+  uint8_t acked = ackSeq - oldestPendingSeq;
+  if (acked < pendingInputCount) {
+    int drop = acked + 1;
+    for (int i = drop; i < pendingInputCount; i++) pendingInputs[i - drop] = pendingInputs[i];
+    pendingInputCount -= drop;
+    oldestPendingSeq += drop;
+  }
+
+  int previousPrediction = predictedPlatePosition;
+  predictedPlatePosition = serverPosition;
+  for (int i = 0; i < pendingInputCount; i++) {
+    predictedPlatePosition = movePlate(predictedPlatePosition, pendingInputs[i]);
+  }
+
+  // Tegnet posisjon skal ikke hoppe: avviket legges i korreksjonen og krymper gradvis
+  plateCorrection += previousPrediction - predictedPlatePosition;
+  if (plateCorrection > plateSnapDistance || plateCorrection < -plateSnapDistance) plateCorrection = 0;
+}
+
+void sendTimePing() {
+  uint32_t interval = clockSync.hasFullWindow() ? slowPingIntervalMs : fastPingIntervalMs;
+  if (millis() - lastPingMs < interval) return;
+  lastPingMs = millis();
+
+  CAN_message_t pingMsg;
+  pingMsg.id = idTimePing;
+  pingMsg.len = ClockSync::makePing(micros(), pingMsg.buf);
+  Can0.write(pingMsg);
+}
+
+void handleHeartbeat() {
+  if (serverMonitor.heartbeatDue(millis())) {
+    CAN_message_t heartbeatMsg;
+    CanHeartbeatP1::encode({isGameOver ? 2 : 1, 0}, groupNumber, heartbeatMsg);
+    Can0.write(heartbeatMsg);
+  }
+
+  PeerMonitor::Event event = serverMonitor.update(millis());
+  if (event == PeerMonitor::PEER_LOST) Serial.println("Serveren svarer ikke");
+  if (event == PeerMonitor::PEER_RETURNED) Serial.println("Serveren er tilbake");
+}
+
+void requestSnapshot() {
+  lastSnapshotRequestMs = millis();
+  CAN_message_t requestMsg;
+  CanSnapshotRequest::encode({1}, groupNumber, requestMsg);
+  Can0.write(requestMsg);
+}
+
+HelloCapabilities ownCapabilities() {
+  HelloCapabilities own;
+  own.minVersion = 1;
+  own.maxVersion = Hello::protocolVersion;
+  own.layouts = LAYOUT_LEGACY | LAYOUT_PACKED; // lengden på rammene sjekkes uansett
+  own.features = FEATURE_RELIABLE_EVENTS | FEATURE_CLOCK_SYNC | FEATURE_TRAJECTORY | FEATURE_INPUT_SEQ |
+                 FEATURE_SNAPSHOT | FEATURE_HEARTBEAT;
+  own.requiredFeatures = FEATURE_RELIABLE_EVENTS; // score og reset kommer bare over den pålitelige kanalen
+  own.tickHz = 100;
+  own.bitrate10k = canBitrate / 10000;
+  return own;
+}
+
+void sendHello() {
+  lastHelloMs = millis();
+  helloAttempts++;
+  CAN_message_t helloMsg;
+  helloMsg.id = idHello;
+  helloMsg.len = Hello::makeHello(ownCapabilities(), helloMsg.buf);
+  Can0.write(helloMsg);
+}
+
+void handleHelloReply(const uint8_t* data, uint8_t len) {
+  HelloAgreement agreement;
+  if (!Hello::readReply(data, len, agreement)) return;
+
+  // Serveren sjekker sine krav, vi sjekker våre
+  HelloCapabilities own = ownCapabilities();
+  if (agreement.result == HELLO_OK && (agreement.features & own.requiredFeatures) != own.requiredFeatures) {
+    agreement.result = HELLO_MISSING_REQUIRED_FEATURE;
+  }
+  bool changed = !hasHelloReply || agreement.result != helloAgreement.result;
+  hasHelloReply = true;
+  helloAgreement = agreement;
+  if (!changed) return;
+
+  if (agreement.result == HELLO_OK) {
+    Serial.print("Hello OK: versjon ");
+    Serial.print(agreement.version);
+    Serial.print(agreement.layout == LAYOUT_PACKED ? ", pakket" : ", gammelt");
+    Serial.print(" rammeformat, ");
+    Serial.print(agreement.tickHz);
+    Serial.println(" Hz");
+  } else {
+    Serial.print("Hello avvist: ");
+    Serial.println(Hello::reasonText(agreement.result));
+  }
+  if (agreement.peerBitrate10k != own.bitrate10k) {
+    Serial.print("Serveren er satt opp med ");
+    Serial.print(agreement.peerBitrate10k * 10);
+    Serial.println(" kbit/s");
+  }
+}
+
+void drawHelloError() {
+  display.clearDisplay();
+  display.setTextSize(1);
+  display.setTextColor(SSD1306_WHITE);
+  display.setCursor(0, 16);
+  display.print("Kan ikke spille:");
+  display.setCursor(0, 28);
+  display.print(Hello::reasonText(helloAgreement.result));
+  display.setCursor(0, 44);
+  display.print("Teensy v1-");
+  display.print(Hello::protocolVersion);
+  oled.show(display);
+}
+
+void applySnapshot(const uint8_t* data, uint8_t len) {
+  CanSnapshot snapshot;
+  if (!CanSnapshotReply::decode(data, len, snapshot)) return;
+  hasSnapshot = true;
+  scoreP1 = snapshot.scoreP1;
+  scoreP2 = snapshot.scoreP2;
+  isGameOver = snapshot.phase == phaseGameOver;
+
+  serverPlatePosition = snapshot.plateP1;
+  predictedPlatePosition = serverPlatePosition;
+  platePosition = serverPlatePosition;
+  plateCorrection = 0;
+  pendingInputCount = 0;
+  remotePlatePosition = snapshot.plateP2;
+
+  // Uten klokkesynk har vi ingen tick å regne fra. Ballen står der til neste ballramme.
+  xBall = snapshot.x;
+  yBall = snapshot.y;
+  ballPredictor = BallPredictor();
+  ballPredictor.setPlates(remotePlatePosition, serverPlatePosition);
+}
+
+void reportLatency() {
+  if (millis() - lastLatencyReportMs < 1000) return;
+  lastLatencyReportMs = millis();
+  if (!clockSync.isSynchronized() || latencyCount == 0) return;
+
+  Serial.print("Latens ball: snitt ");
+  Serial.print(latencySumUs / latencyCount);
+  Serial.print(" us, maks ");
+  Serial.print(latencyMaxUs);
+  Serial.print(" us, RTT ");
+  Serial.print(clockSync.rttUs());
+  Serial.print(" us, offset ");
+  Serial.print((long)clockSync.offsetUs());
+  Serial.println(" us");
+
+  latencySumUs = 0;
+  latencyMaxUs = 0;
+  latencyCount = 0;
+}
+
+void sendReliableFrame(uint32_t id, const uint8_t* data, uint8_t len) {
+  CAN_message_t msg;
+  msg.id = id;
+  msg.len = len;
+  memcpy(msg.buf, data, len);
+  Can0.write(msg);
+}
+
 void receiveCANMessages() {
   CAN_message_t rxMsg;
   while (Can0.read(rxMsg))
   {
-    if (rxMsg.id == idPlatePositionP1) {
-      platePosition = rxMsg.buf[0]; // Min posisjon (fra server)
-    }
-    else if (rxMsg.id == idPlatePositionP2) { 
-      remotePlatePosition = rxMsg.buf[0]; // Motstander
-    }
-    else if (rxMsg.id == idBallPosition) { 
-      xBall = rxMsg.buf[0];
-      yBall = rxMsg.buf[1];
-    }
-    else if (rxMsg.id == idGameOver) { 
-      scoreP1 = rxMsg.buf[0];
-      scoreP2 = rxMsg.buf[1];
-      if (scoreP1 >= WINNING_SCORE || scoreP2 >= WINNING_SCORE) {
-        isGameOver = true;
-      }
-    }
-    else if (rxMsg.id == idResetGame && rxMsg.buf[0] == 1 && isGameOver) {
-      resetGame();
+    serverMonitor.heard(millis()); // alt vi får kommer fra serveren
+    canDispatcher.dispatch(rxMsg.id, rxMsg.flags.extended, rxMsg.buf, rxMsg.len);
+  }
+}
+
+void onEventAck(void*, const uint8_t* data, uint8_t len) {
+  reliableEvents.receiveAck(data, len);
+}
+
+void onPlateP1(void*, const uint8_t* data, uint8_t len) {
+  CanPlate plate;
+  if (!CanPlateP1::decode(data, len, plate)) return;
+  serverPlatePosition = plate.position; // Min posisjon (fra server)
+  if (CanPlateAckP1::decode(data, len, plate)) reconcilePlate(serverPlatePosition, plate.seq);
+  else predictedPlatePosition = serverPlatePosition;
+  ballPredictor.setPlates(remotePlatePosition, serverPlatePosition);
+}
+
+void onPlateP2(void*, const uint8_t* data, uint8_t len) {
+  CanPlate plate;
+  if (!CanPlateP2::decode(data, len, plate)) return;
+  remotePlatePosition = plate.position; // Motstander
+  ballPredictor.setPlates(remotePlatePosition, serverPlatePosition);
+}
+
+// I banemodus kommer ballen bare ved sprett, scoring og reset. Posisjonen regnes ut
+// fra banen i drawDisplay(), så uten klokkesynk kan vi bare vise startpunktet.
+void onBallTrajectory(void*, const uint8_t* data, uint8_t len) {
+  uint8_t payloadLen;
+  CanBall ball;
+  if (!reliableEvents.receive(idBallTrajectory, data, len, payloadLen)) return;
+  if (!CanBallTrajectory::decode(data, payloadLen, ball)) return;
+  BallState state = {(int16_t)ball.x, (int16_t)ball.y, (int8_t)ball.vx, (int8_t)ball.vy};
+  ballPredictor.setMaxExtrapolationTicks(BallPredictor::trajectoryMaxExtrapolationTicks);
+  if (clockSync.isSynchronized()) {
+    ballPredictor.onServerFrame(state, clockSync.fullTick(ball.tick, micros()));
+  } else {
+    xBall = ball.x;
+    yBall = ball.y;
+  }
+}
+
+void onSnapshot(void*, const uint8_t* data, uint8_t len) {
+  applySnapshot(data, len);
+}
+
+void onHelloReply(void*, const uint8_t* data, uint8_t len) {
+  handleHelloReply(data, len);
+}
+
+void onTimePong(void*, const uint8_t* data, uint8_t len) {
+  clockSync.handlePong(data, len, micros());
+}
+
+void onBallPosition(void*, const uint8_t* data, uint8_t len) {
+  // Det gamle rammeformatet har bare [x, y]
+  CanBall ball;
+  bool packed = CanBallPosition::decode(data, len, ball);
+  if (packed || CanBallPositionLegacy::decode(data, len, ball)) {
+    xBall = ball.x;
+    yBall = ball.y;
+  }
+
+  // Ticken i rammen gjøres om til vår tid. Tiden inkluderer også ventingen i loopen.
+  if (packed && clockSync.isSynchronized()) {
+    uint32_t now = micros();
+    ballFrameLocalUs = clockSync.tickToLocalUs(ball.tick, now);
+    int32_t latency = (int32_t)(now - ballFrameLocalUs);
+    if (latency >= 0) {
+      latencySumUs += latency;
+      if ((uint32_t)latency > latencyMaxUs) latencyMaxUs = latency;
+      latencyCount++;
     }
+
+    BallState state = {(int16_t)ball.x, (int16_t)ball.y, (int8_t)ball.vx, (int8_t)ball.vy};
+    ballPredictor.onServerFrame(state, clockSync.fullTick(ball.tick, now));
+  }
+}
+
+void onGameOver(void*, const uint8_t* data, uint8_t len) {
+  uint8_t payloadLen;
+  CanPoints score;
+  if (!reliableEvents.receive(idGameOver, data, len, payloadLen)) return;
+  if (!CanScore::decode(data, payloadLen, score)) return;
+  scoreP1 = score.scoreP1;
+  scoreP2 = score.scoreP2;
+  if (scoreP1 >= WINNING_SCORE || scoreP2 >= WINNING_SCORE) {
+    isGameOver = true;
+  }
+}
+
+// Serveren svarer på ID 59 når spillet faktisk er resatt
+void onResetAck(void*, const uint8_t* data, uint8_t len) {
+  uint8_t payloadLen;
+  CanReset reset;
+  if (!reliableEvents.receive(idResetAck, data, len, payloadLen)) return;
+  if (CanResetAck::decode(data, payloadLen, reset) && reset.request == 1 && isGameOver) {
+    resetGame();
   }
 }
 
@@ -231,13 +647,30 @@ void drawDisplay() {
   display.setTextSize(1);
   display.setCursor(0, SCREEN_HEIGHT - 8);
   display.print("P1 (Teensy)");
+  if (serverMonitor.hasBeenSeen() && !serverMonitor.isAlive()) display.print(" ingen server");
+  if (!serverMonitor.hasBeenSeen() && helloAttempts >= helloMaxAttempts) {
+    // Ingen har svart på hello: feil bitrate eller ingen server på bussen
+    display.setCursor(0, SCREEN_HEIGHT - 16);
+    display.print("Ingen svar, ");
+    display.print(canBitrate / 1000);
+    display.print("k?");
+  }
+
+  // Ballen der serveren er nå, ikke der den var i siste ramme
+  if (clockSync.isSynchronized()) {
+    ballPredictor.position(clockSync.serverTickNow(micros()), xBall, yBall);
+  }
+
+  // Egen plate med en gang, med korreksjonen fra serveren fadet ut
+  plateCorrection *= plateCorrectionDecay;
+  platePosition = predictedPlatePosition + (int)(plateCorrection + (plateCorrection < 0 ? -0.5f : 0.5f));
 
   // Plater og Ball
   display.fillRect(0, remotePlatePosition, plateWidth, plateHeight, SSD1306_WHITE);
   display.fillRect(SCREEN_WIDTH - plateWidth, platePosition, plateWidth, plateHeight, SSD1306_WHITE);
   display.fillCircle(xBall, yBall, ballRadius, SSD1306_WHITE);
 
-  display.display();
+  oled.show(display);
 }
 
 void drawGameOverScreen() {
@@ -260,7 +693,7 @@ void drawGameOverScreen() {
   display.print("Trykk for nytt");
   display.setCursor(45, 50);
   display.print("spill");
-  display.display();
+  oled.show(display);
 }
 
 void resetGame() {
@@ -268,9 +701,14 @@ void resetGame() {
   scoreP2 = 0;
   isGameOver = false;
   platePosition = 22;
+  serverPlatePosition = 22;
+  predictedPlatePosition = 22;
+  plateCorrection = 0;
+  pendingInputCount = 0;
   remotePlatePosition = 22;
   xBall = 64;
   yBall = 32;
+  ballPredictor = BallPredictor();
   lastMoveState = -1; 
   delay(500);
 }
@@ -0,0 +1,253 @@
+/*
+ * Måler busbelastningen på CAN-bussen, enten live på et grensesnitt eller fra en candump-logg.
+ * Regner ut faktiske bits per ramme (med bit stuffing) og viser belastning per ID og per avsender.
+ *
+ * Bruk:
+ *   ./busload --if=can0 --bitrate=500000            (live, rapport hvert sekund)
+ *   ./busload --log=dump.log --bitrate=250000       (offline, logg fra "candump -l can0")
+ *   valgfritt: --databitrate=2000000 (CAN FD med BRS), --warn=50 (advarsel i prosent), --interval=1000 (ms)
+ *
+ * Kompilering:
+ *   g++ -std=c++17 -O2 -o busload busload.cpp busloadestimator.cpp
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <map>
+#include <chrono>
+#include <algorithm>
+
+#include "busloadestimator.h"
+#include "../felles/canmessages.h"
+
+const char *ifname = "can0";
+const int groupNumber = 6;
+const int idBallPosition = CanBallPosition::id(groupNumber); // 56, den tilstandsrammen med lavest prioritet
+
+uint32_t bitrate = 500000;
+uint32_t dataBitrate = 0;
+double warnPercent = 50.0;
+int intervalMs = 1000;
+
+// Hvem som sender hva (se protokolltabellene i main.cpp og Teensy-skissene)
+std::string senderForId(uint32_t id) {
+    if (id > CAN_SFF_MASK && (id >> 18) == CanRoleClaim::id(groupNumber)) return "Teensy (rolle)"; // utvidet ID med nonce
+    if (id > CAN_SFF_MASK && (id >> 18) == 0x7F0) return "Lobby (node)";
+    if (id == 0x7F1) return "Matchmaker";
+    switch (id - groupNumber) {
+        case CanRoleClaim::offset: return "Teensy (rolle)";
+        case CanJoystickP1::offset: case CanHeartbeatP1::offset: case CanResetGame::offset: case CanEventAckP2::offset:
+        case CanTimePing::offset: case CanSnapshotRequest::offset: case CanHello::offset:
+            return "Teensy P1";
+        case CanPlateP1::offset: case CanPlateP2::offset: case CanBallTrajectory::offset: case CanBallPosition::offset:
+        case CanScore::offset: case CanResetAck::offset: case CanModeAck::offset: case CanFullStateFd::offset:
+        case CanEventAckP1::offset: case CanTimePong::offset: case CanSnapshotReply::offset: case CanHelloReply::offset:
+            return "RSP3 server";
+        case CanModeRequest::offset: case CanBulkToNode::offset: return "Linux-node";
+        case CanBulkFromNode::offset: return "Teensy (ISO-TP)";
+        default: return "ukjent";
+    }
+}
+
+void printReport(const BusLoadEstimator& estimator, double windowUs, bool detailed) {
+    double utilization = estimator.utilization(windowUs) * 100.0;
+    double worstCase = estimator.worstCaseUtilization(windowUs) * 100.0;
+    double blocking = estimator.higherPriorityUtilization(idBallPosition, windowUs) * 100.0;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "Belastning " << utilization << " % (verste fall " << worstCase << " %) ved "
+              << estimator.bitrate() / 1000 << " kbit/s";
+    if (worstCase >= warnPercent) {
+        std::cout << "  ADVARSEL: over " << warnPercent << " %, tilstandsrammene kan bli forsinket i arbitreringen";
+    }
+    std::cout << std::endl;
+
+    if (!detailed) return;
+
+    std::cout << "  Trafikk med høyere prioritet enn ball (ID " << idBallPosition << "): " << blocking << " %" << std::endl;
+    std::cout << "     ID  rammer/s  bits/ramme  belastning  verste fall  avsender" << std::endl;
+
+    std::map<std::string, double> perSender;
+    for (const auto& entry : estimator.perId()) {
+        const IdLoad& load = entry.second;
+        double framesPerSecond = load.frames * 1e6 / windowUs;
+        double bitsPerFrame = load.frames ? (double)load.bits / load.frames : 0;
+        std::string sender = senderForId(entry.first);
+        perSender[sender] += load.busyTimeUs;
+
+        std::cout << std::setw(7) << entry.first
+                  << std::setw(10) << framesPerSecond
+                  << std::setw(12) << bitsPerFrame
+                  << std::setw(10) << load.busyTimeUs * 100.0 / windowUs << " %"
+                  << std::setw(11) << load.worstCaseTimeUs * 100.0 / windowUs << " %"
+                  << "  " << sender << std::endl;
+    }
+
+    std::cout << "  Per avsender:" << std::endl;
+    for (const auto& entry : perSender) {
+        std::cout << "    " << std::setw(16) << std::left << entry.first << std::right
+                  << entry.second * 100.0 / windowUs << " %" << std::endl;
+    }
+}
+
+// Leser én linje fra "candump -l": (1700000000.123456) can0 038#0102  /  can0 03E##1AABB (FD)
+bool parseCandumpLine(const std::string& line, double& timestampUs, CanFrameInfo& frame, uint8_t* data) {
+    size_t open = line.find('(');
+    size_t close = line.find(')');
+    size_t hash = line.find('#');
+    if (open == std::string::npos || close == std::string::npos || hash == std::string::npos) return false;
+
+    timestampUs = atof(line.substr(open + 1, close - open - 1).c_str()) * 1e6;
+
+    size_t idStart = line.rfind(' ', hash) + 1;
+    std::string idText = line.substr(idStart, hash - idStart);
+    frame.id = strtoul(idText.c_str(), nullptr, 16);
+    frame.extended = idText.size() > 3;
+    frame.rtr = false;
+    frame.fd = false;
+    frame.brs = false;
+    frame.len = 0;
+    frame.data = data;
+
+    size_t pos = hash + 1;
+    if (pos < line.size() && line[pos] == '#') {
+        // FD: første tegn etter ## er flaggene
+        frame.fd = true;
+        int flags = strtol(line.substr(pos + 1, 1).c_str(), nullptr, 16);
+        frame.brs = (flags & CANFD_BRS) != 0;
+        pos += 2;
+    } else if (pos < line.size() && line[pos] == 'R') {
+        frame.rtr = true;
+        return true;
+    }
+
+    while (pos + 1 < line.size() && frame.len < CANFD_MAX_DLEN && isxdigit(line[pos]) && isxdigit(line[pos + 1])) {
+        data[frame.len++] = strtol(line.substr(pos, 2).c_str(), nullptr, 16);
+        pos += 2;
+        if (pos < line.size() && line[pos] == '.') pos++; // candump kan skille bytes med punktum
+    }
+    return true;
+}
+
+int runOffline(const std::string& logFile) {
+    std::ifstream log(logFile);
+    if (!log) {
+        std::cout << "Fikk ikke åpnet " << logFile << std::endl;
+        return 1;
+    }
+
+    BusLoadEstimator total(bitrate, dataBitrate);
+    BusLoadEstimator window(bitrate, dataBitrate);
+    double firstUs = -1, lastUs = 0, windowStartUs = 0;
+    double peakUtilization = 0, peakStartUs = 0;
+    const double windowUs = intervalMs * 1000.0;
+
+    std::string line;
+    uint8_t data[CANFD_MAX_DLEN];
+    while (std::getline(log, line)) {
+        double timestampUs;
+        CanFrameInfo frame;
+        if (!parseCandumpLine(line, timestampUs, frame, data)) continue;
+
+        if (firstUs < 0) firstUs = windowStartUs = timestampUs;
+        while (timestampUs - windowStartUs >= windowUs) {
+            if (window.worstCaseUtilization(windowUs) > peakUtilization) {
+                peakUtilization = window.worstCaseUtilization(windowUs);
+                peakStartUs = windowStartUs;
+            }
+            std::cout << "t=" << std::fixed << std::setprecision(1) << (windowStartUs - firstUs) / 1e6 << " s  ";
+            printReport(window, windowUs, false);
+            window.reset();
+            windowStartUs += windowUs;
+        }
+
+        total.addFrame(frame);
+        window.addFrame(frame);
+        lastUs = timestampUs;
+    }
+
+    if (firstUs < 0) {
+        std::cout << "Fant ingen rammer i loggen." << std::endl;
+        return 1;
+    }
+
+    double durationUs = std::max(lastUs - firstUs, windowUs);
+    std::cout << std::endl << "Hele loggen (" << durationUs / 1e6 << " s):" << std::endl;
+    printReport(total, durationUs, true);
+    std::cout << "Høyeste vindu (verste fall): " << peakUtilization * 100.0 << " % ved t="
+              << (peakStartUs - firstUs) / 1e6 << " s" << std::endl;
+    return 0;
+}
+
+int runLive() {
+    int socketDescriptor;
+    struct sockaddr_can addr;
+    struct ifreq ifr;
+    if ((socketDescriptor = socket(PF_CAN, SOCK_RAW, CAN_RAW)) < 0) return 1;
+    strcpy(ifr.ifr_name, ifname);
+    if (ioctl(socketDescriptor, SIOCGIFINDEX, &ifr) < 0) return 1;
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(socketDescriptor, (struct sockaddr *)&addr, sizeof(addr)) < 0) return 1;
+
+    int enable = 1;
+    setsockopt(socketDescriptor, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable)); // feiler på klassiske grensesnitt, det er greit
+
+    BusLoadEstimator estimator(bitrate, dataBitrate);
+    auto windowStart = std::chrono::steady_clock::now();
+
+    while (true) {
+        struct canfd_frame rxFrame;
+        ssize_t nbytes = recv(socketDescriptor, &rxFrame, sizeof(struct canfd_frame), MSG_DONTWAIT);
+        if (nbytes > 0) {
+            CanFrameInfo frame;
+            frame.id = rxFrame.can_id & ((rxFrame.can_id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+            frame.extended = (rxFrame.can_id & CAN_EFF_FLAG) != 0;
+            frame.rtr = (rxFrame.can_id & CAN_RTR_FLAG) != 0;
+            frame.fd = nbytes == CANFD_MTU;
+            frame.brs = frame.fd && (rxFrame.flags & CANFD_BRS);
+            frame.len = rxFrame.len;
+            frame.data = rxFrame.data;
+            estimator.addFrame(frame);
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double elapsedUs = std::chrono::duration<double, std::micro>(now - windowStart).count();
+        if (elapsedUs >= intervalMs * 1000.0) {
+            std::cout << "\x1b[2J\x1b[H"; // tøm skjermen mellom rapportene
+            printReport(estimator, elapsedUs, true);
+            estimator.reset();
+            windowStart = now;
+        }
+        usleep(500);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string logFile;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--if=", 0) == 0) ifname = argv[i] + 5;
+        else if (arg.rfind("--log=", 0) == 0) logFile = arg.substr(6);
+        else if (arg.rfind("--bitrate=", 0) == 0) bitrate = atoi(arg.c_str() + 10);
+        else if (arg.rfind("--databitrate=", 0) == 0) dataBitrate = atoi(arg.c_str() + 14);
+        else if (arg.rfind("--warn=", 0) == 0) warnPercent = atof(arg.c_str() + 7);
+        else if (arg.rfind("--interval=", 0) == 0) intervalMs = std::max(10, atoi(arg.c_str() + 11));
+        else std::cout << "Ukjent argument: " << arg << std::endl;
+    }
+    if (bitrate == 0) bitrate = 500000;
+
+    if (!logFile.empty()) return runOffline(logFile);
+    return runLive();
+}
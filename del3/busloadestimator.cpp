@@ -0,0 +1,204 @@
+#include "busloadestimator.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace
+{
+  const int unstuffedTrailerBits = 13; // CRC-delim, ACK, ACK-delim, EOF (7), mellomrom (3)
+
+  void appendBits(std::vector<uint8_t>& bits, uint32_t value, int count)
+  {
+    for (int i = count - 1; i >= 0; i--) bits.push_back((value >> i) & 1);
+  }
+
+  uint16_t crc15(const std::vector<uint8_t>& bits)
+  {
+    uint16_t crc = 0;
+    for (uint8_t bit : bits)
+    {
+      bool crcNext = bit ^ ((crc >> 14) & 1);
+      crc = (crc << 1) & 0x7fff;
+      if (crcNext) crc ^= 0x4599;
+    }
+    return crc;
+  }
+
+  // Teller stuff bits. Stuff bits som kommer før firstDataBit havner i nominalStuff.
+  int countStuffBits(const std::vector<uint8_t>& bits, size_t firstDataBit, int& nominalStuff)
+  {
+    int stuff = 0;
+    int run = 0;
+    int last = -1;
+    nominalStuff = 0;
+    for (size_t i = 0; i < bits.size(); i++)
+    {
+      if (bits[i] == last) run++;
+      else { last = bits[i]; run = 1; }
+
+      if (run == 5)
+      {
+        stuff++;
+        if (i < firstDataBit) nominalStuff++;
+        last = !bits[i]; // stuff-biten starter en ny rekke
+        run = 1;
+      }
+    }
+    return stuff;
+  }
+
+  uint8_t fdLengthToDlc(uint8_t len)
+  {
+    if (len <= 8)  return len;
+    if (len <= 12) return 9;
+    if (len <= 16) return 10;
+    if (len <= 20) return 11;
+    if (len <= 24) return 12;
+    if (len <= 32) return 13;
+    if (len <= 48) return 14;
+    return 15;
+  }
+
+  uint8_t fdDlcToLength(uint8_t dlc)
+  {
+    static const uint8_t lengths[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+    return lengths[dlc & 0x0f];
+  }
+
+  void appendIdentifier(std::vector<uint8_t>& bits, const CanFrameInfo& frame, int rtrOrRrs)
+  {
+    bits.push_back(0); // SOF
+    if (frame.extended)
+    {
+      appendBits(bits, frame.id >> 18, 11);
+      bits.push_back(1); // SRR
+      bits.push_back(1); // IDE
+      appendBits(bits, frame.id & 0x3ffff, 18);
+      bits.push_back(rtrOrRrs);
+    }
+    else
+    {
+      appendBits(bits, frame.id & 0x7ff, 11);
+      bits.push_back(rtrOrRrs);
+      bits.push_back(0); // IDE
+    }
+  }
+}
+
+
+FrameBits computeFrameBits(const CanFrameInfo& frame)
+{
+  FrameBits result = {0, 0, 0, 0};
+  std::vector<uint8_t> bits;
+  bits.reserve(128 + 8 * 64);
+
+  if (!frame.fd)
+  {
+    uint8_t len = frame.len > 8 ? 8 : frame.len;
+    appendIdentifier(bits, frame, frame.rtr ? 1 : 0);
+    if (frame.extended) bits.push_back(0); // r1
+    bits.push_back(0);                     // r0
+    appendBits(bits, len, 4);
+    if (!frame.rtr)
+    {
+      for (int i = 0; i < len; i++) appendBits(bits, frame.data ? frame.data[i] : 0, 8);
+    }
+    appendBits(bits, crc15(bits), 15);
+
+    int nominalStuff;
+    result.stuffBits = countStuffBits(bits, bits.size(), nominalStuff);
+    result.nominalBits = bits.size() + result.stuffBits + unstuffedTrailerBits;
+    result.worstCaseBits = bits.size() + (bits.size() - 1) / 4 + unstuffedTrailerBits;
+    return result;
+  }
+
+  // CAN FD
+  uint8_t dlc = fdLengthToDlc(frame.len);
+  uint8_t len = fdDlcToLength(dlc);
+  appendIdentifier(bits, frame, 0); // RRS er alltid 0
+  bits.push_back(1);                // FDF
+  bits.push_back(0);                // res
+  bits.push_back(frame.brs ? 1 : 0);
+  size_t firstDataBit = bits.size(); // bitraten byttes ved samplepunktet i BRS-biten
+  bits.push_back(0);                // ESI
+  appendBits(bits, dlc, 4);
+  for (int i = 0; i < len; i++) appendBits(bits, (frame.data && i < frame.len) ? frame.data[i] : 0, 8);
+
+  int nominalStuff;
+  result.stuffBits = countStuffBits(bits, firstDataBit, nominalStuff);
+
+  // Stuff count (4) + CRC17/CRC21 med faste stuff bits
+  int crcFieldBits = 4 + (len <= 16 ? 17 : 21);
+  int fixedStuffBits = 1 + crcFieldBits / 4;
+  result.stuffBits += fixedStuffBits;
+
+  int headerBits = firstDataBit + nominalStuff + unstuffedTrailerBits;
+  int payloadBits = (bits.size() - firstDataBit) + (result.stuffBits - nominalStuff) + crcFieldBits;
+  if (frame.brs)
+  {
+    result.nominalBits = headerBits;
+    result.dataBits = payloadBits;
+  }
+  else
+  {
+    result.nominalBits = headerBits + payloadBits;
+  }
+  result.worstCaseBits = bits.size() + (bits.size() - 1) / 4 + crcFieldBits + fixedStuffBits + unstuffedTrailerBits;
+  return result;
+}
+
+
+
+BusLoadEstimator::BusLoadEstimator(uint32_t bitrate, uint32_t dataBitrate)
+  : bitrate_{bitrate}
+  , dataBitrate_{dataBitrate > 0 ? dataBitrate : bitrate}
+  , busyTimeUs_{0}
+  , worstCaseTimeUs_{0}
+{}
+
+
+void BusLoadEstimator::addFrame(const CanFrameInfo& frame)
+{
+  FrameBits bits = computeFrameBits(frame);
+
+  double nominalBitUs = 1e6 / bitrate_;
+  double dataBitUs = 1e6 / dataBitrate_;
+  double timeUs = bits.nominalBits * nominalBitUs + bits.dataBits * dataBitUs;
+
+  // Ekstra stuff bits i verste fall havner i datafasen hvis BRS er på
+  int actualBits = bits.nominalBits + bits.dataBits;
+  double extraBitUs = (frame.fd && frame.brs) ? dataBitUs : nominalBitUs;
+  double worstCaseTimeUs = timeUs + (bits.worstCaseBits - actualBits) * extraBitUs;
+
+  IdLoad& load = perId_[frame.id];
+  load.frames++;
+  load.bits += actualBits;
+  load.worstCaseBits += bits.worstCaseBits;
+  load.busyTimeUs += timeUs;
+  load.worstCaseTimeUs += worstCaseTimeUs;
+
+  busyTimeUs_ += timeUs;
+  worstCaseTimeUs_ += worstCaseTimeUs;
+}
+
+
+void BusLoadEstimator::reset()
+{
+  busyTimeUs_ = 0;
+  worstCaseTimeUs_ = 0;
+  perId_.clear();
+}
+
+
+double BusLoadEstimator::higherPriorityUtilization(uint32_t id, double windowUs) const
+{
+  if (windowUs <= 0) return 0.0;
+
+  double busyUs = 0;
+  for (const auto& entry : perId_)
+  {
+    if (entry.first >= id) break; // map er sortert, resten har lavere prioritet
+    busyUs += entry.second.busyTimeUs;
+  }
+  return busyUs / windowUs;
+}
@@ -0,0 +1,81 @@
+#ifndef BUSLOADESTIMATOR_H
+#define BUSLOADESTIMATOR_H
+
+#include <cstdint>
+#include <map>
+
+/*
+ * Beregner hvor mange bits hver CAN-ramme faktisk bruker på bussen, og hvor stor
+ * andel av bussen trafikken tar ved en gitt bitrate.
+ *
+ * Klassisk ramme (11-bit ID): SOF, ID, RTR, IDE, r0, DLC, data og CRC15 blir bit-stuffet
+ * (etter 5 like bits settes inn en motsatt bit). Deretter kommer CRC-delim, ACK, ACK-delim,
+ * EOF (7) og mellomrom (3) som ikke stuffes.
+ *  - "actual" stuffing regnes ut fra de faktiske bitene (inkludert CRC-en)
+ *  - "worst case" er (34 + 8n - 1) / 4 ekstra bits for 11-bit ID og (54 + 8n - 1) / 4 for 29-bit ID
+ *
+ * CAN FD: feltene frem til CRC stuffes dynamisk som over. CRC-feltet har faste stuff bits
+ * (én før stuff count og én etter hver 4. bit), så der er antallet uavhengig av verdien.
+ * Med bitrate switch går ESI, DLC, data og CRC på datahastigheten.
+ */
+
+struct FrameBits
+{
+  int nominalBits;      // bits på arbitreringshastigheten (inkl. faktisk stuffing)
+  int dataBits;         // bits på datahastigheten (bare FD med BRS, ellers 0)
+  int stuffBits;        // faktisk antall stuff bits
+  int worstCaseBits;    // totalt antall bits med verste tilfelle stuffing
+};
+
+struct CanFrameInfo
+{
+  uint32_t id;
+  bool extended;
+  bool rtr;
+  bool fd;
+  bool brs;
+  uint8_t len;
+  const uint8_t* data;
+};
+
+FrameBits computeFrameBits(const CanFrameInfo& frame);
+
+
+struct IdLoad
+{
+  uint32_t frames;
+  uint64_t bits;          // faktiske bits
+  uint64_t worstCaseBits;
+  double busyTimeUs;      // tid bussen var opptatt med denne ID-en
+  double worstCaseTimeUs;
+};
+
+
+class BusLoadEstimator
+{
+  public:
+  BusLoadEstimator(uint32_t bitrate, uint32_t dataBitrate);
+
+  void addFrame(const CanFrameInfo& frame);
+  void reset(); // starter et nytt målevindu
+
+  // Andel (0..1) av vinduet bussen var opptatt
+  double utilization(double windowUs) const { return windowUs > 0 ? busyTimeUs_ / windowUs : 0.0; }
+  double worstCaseUtilization(double windowUs) const { return windowUs > 0 ? worstCaseTimeUs_ / windowUs : 0.0; }
+
+  // Andel av bussen brukt av ID-er med høyere prioritet (lavere ID) enn id. Det er denne
+  // trafikken som kan forsinke rammen vår i arbitreringen.
+  double higherPriorityUtilization(uint32_t id, double windowUs) const;
+
+  const std::map<uint32_t, IdLoad>& perId() const { return perId_; }
+  uint32_t bitrate() const { return bitrate_; }
+
+  private:
+  uint32_t bitrate_;
+  uint32_t dataBitrate_;
+  double busyTimeUs_;
+  double worstCaseTimeUs_;
+  std::map<uint32_t, IdLoad> perId_;
+};
+
+#endif
@@ -0,0 +1,181 @@
+/*
+ * Kjører trafikken mellom serveren (main.cpp) og Teensyen (Oppg3/oppg3Teensy.cpp) på den
+ * virtuelle bussen i canbussim.h, og skriver hvor lenge hver ID venter på bussen.
+ * Slik kan vi se hva en protokollendring gjør ved 250k og 500k før vi tar den med på laben.
+ *
+ * Modellert trafikk (samme rater som koden):
+ *  - Teensy: joystick 25 hvert 10. ms, heartbeat 31 hvert 100. ms, klokke-ping 65 hvert 50. ms
+ *  - Server: plater 26 og 27 hvert 10. ms, ball 56 med --ballrate (25 Hz), pong 66 på hver ping
+ *  - "--bulk": en Linux-node sender ISO-TP-meldinger (../felles/isotp.h) på 4095 bytes til
+ *    Teensyen hele tiden, på gruppe + 110 (lavest prioritet)
+ *
+ * Bruk:
+ *   ./bussim --bitrate=250000,500000 --seconds=10 --seed=1 --loss=0.001 --errors=0.0001 --bulk
+ *
+ * Kompilering:
+ *   g++ -std=c++17 -O2 -o bussim bussim.cpp canbussim.cpp busloadestimator.cpp
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "canbussim.h"
+#include "../felles/isotp.h"
+#include "../felles/canmessages.h"
+
+const int groupNumber = 6;
+const uint32_t idJoystickP1 = CanJoystickP1::id(groupNumber);         // 25
+const uint32_t idPlatePositionP1 = CanPlateP1::id(groupNumber);       // 26
+const uint32_t idPlatePositionP2 = CanPlateP2::id(groupNumber);       // 27
+const uint32_t idHeartbeat = CanHeartbeatP1::id(groupNumber);         // 31
+const uint32_t idBallPosition = CanBallPosition::id(groupNumber);     // 56
+const uint32_t idTimePing = CanTimePing::id(groupNumber);             // 65
+const uint32_t idTimePong = CanTimePong::id(groupNumber);             // 66
+const uint32_t idBulkToTeensy = CanBulkToNode::id(groupNumber);       // 116
+const uint32_t idBulkFromTeensy = CanBulkFromNode::id(groupNumber);   // 117
+
+std::vector<uint32_t> bitrates = {500000};
+double simulatedSeconds = 10.0;
+uint32_t seed = 1;
+double lossProbability = 0.0;
+double errorProbability = 0.0;
+int ballRateHz = 25;
+bool useBulk = false;
+int bulkBlockSize = 8;
+uint32_t bulkStMinUs = 0;
+
+// IsoTp sender rett inn i bussen. context peker på hvilken node.
+struct BulkNode {
+    CanBusSim* bus;
+    int node;
+};
+
+bool sendBulkFrame(void* context, uint32_t id, const uint8_t* data, uint8_t len) {
+    BulkNode* bulkNode = static_cast<BulkNode*>(context);
+    return bulkNode->bus->send(bulkNode->node, id, data, len);
+}
+
+bool every(double nowUs, double stepUs, double periodUs) {
+    return (uint64_t)(nowUs / periodUs) != (uint64_t)((nowUs - stepUs) / periodUs) || nowUs == 0;
+}
+
+void runScenario(uint32_t bitrate) {
+    CanBusSim bus(bitrate, seed);
+    bus.setLossProbability(lossProbability);
+    bus.setErrorProbability(errorProbability);
+    int teensy = bus.attach("Teensy P1", 16, 256);  // FlexCAN_T4<CAN0, RX_SIZE_256, TX_SIZE_16>
+    int server = bus.attach("RSP3 server", 64, 256); // TxManager holder 64 hendelser
+    int linux = useBulk ? bus.attach("Linux (ISO-TP)", 16, 256) : -1;
+
+    BulkNode teensyBulkNode = {&bus, teensy};
+    BulkNode linuxBulkNode = {&bus, linux};
+    IsoTp teensyBulk(sendBulkFrame, &teensyBulkNode, idBulkFromTeensy, idBulkToTeensy, bulkBlockSize, bulkStMinUs);
+    IsoTp linuxBulk(sendBulkFrame, &linuxBulkNode, idBulkToTeensy, idBulkFromTeensy);
+    static uint8_t bulkMessage[IsoTp::maxMessage];
+    for (int i = 0; i < IsoTp::maxMessage; i++) bulkMessage[i] = (uint8_t)(i * 7);
+    uint32_t bulkBytes = 0;
+
+    const double stepUs = 100.0;
+    uint8_t seq = 0;
+    for (double nowUs = 0; nowUs < simulatedSeconds * 1e6; nowUs += stepUs) {
+        bus.runUntil(nowUs);
+        uint32_t nowUs32 = (uint32_t)nowUs;
+
+        // Teensyen leser alt og svarer ikke på noe her, den bare tar imot
+        SimFrame frame;
+        while (bus.receive(teensy, frame)) {
+            if (useBulk) teensyBulk.receive(frame.id, frame.data, frame.len, nowUs32);
+        }
+        if (useBulk && teensyBulk.hasMessage()) {
+            bulkBytes += teensyBulk.messageLength();
+            teensyBulk.release();
+        }
+        if (every(nowUs, stepUs, 10000)) {
+            uint8_t joystick[2] = {1, seq++};
+            bus.send(teensy, idJoystickP1, joystick, 2);
+        }
+        if (every(nowUs, stepUs, 100000)) {
+            uint8_t heartbeat[CanHeartbeatP1::length];
+            bus.send(teensy, idHeartbeat, heartbeat, CanHeartbeatP1::encode({1, 0}, heartbeat));
+        }
+        if (every(nowUs, stepUs, 50000)) {
+            uint8_t ping[CanTimePing::length];
+            bus.send(teensy, idTimePing, ping, CanTimePing::encode({nowUs32, 0, 0}, ping));
+        }
+
+        // Serveren svarer på ping med en gang, resten går på fast skjema
+        while (bus.receive(server, frame)) {
+            if (frame.id == idTimePing) {
+                uint8_t pong[CanTimePong::length];
+                CanTimeSync sync = {CanTimePing::get<&CanTimeSync::pingUs>(frame.data), 0, 0};
+                bus.send(server, idTimePong, pong, CanTimePong::encode(sync, pong));
+            }
+        }
+        if (every(nowUs, stepUs, 10000)) {
+            uint8_t p1[2] = {22, seq};
+            uint8_t p2[1] = {22};
+            bus.send(server, idPlatePositionP1, p1, 2);
+            bus.send(server, idPlatePositionP2, p2, 1);
+        }
+        if (every(nowUs, stepUs, 1e6 / ballRateHz)) {
+            uint8_t ball[6] = {64, 32, (uint8_t)nowUs32, (uint8_t)(nowUs32 >> 8), 1, 1};
+            bus.send(server, idBallPosition, ball, 6);
+        }
+
+        if (useBulk) {
+            while (bus.receive(linux, frame)) linuxBulk.receive(frame.id, frame.data, frame.len, nowUs32);
+            if (!linuxBulk.isSending()) linuxBulk.send(bulkMessage, IsoTp::maxMessage, nowUs32);
+            linuxBulk.update(nowUs32);
+            teensyBulk.update(nowUs32);
+        }
+    }
+
+    printf("\n=== %u bit/s, %.0f s, seed %u, tap %.4f, feil %.4f%s ===\n", bitrate, simulatedSeconds, seed,
+           lossProbability, errorProbability, useBulk ? ", ISO-TP bulk" : "");
+    printf("Busbelastning: %.1f %%\n", bus.utilization() * 100.0);
+    printf("%-16s %8s %8s %8s %8s %8s %8s %7s\n", "Node", "sendt", "full kø", "mottatt", "tapt", "feil", "kollisj.", "bus-off");
+    for (int i = 0; i < bus.nodeCount(); i++) {
+        const SimNodeStats& stats = bus.stats(i);
+        printf("%-16s %8u %8u %8u %8u %8u %8u %7s\n", bus.name(i).c_str(), stats.sent, stats.txDropped,
+               stats.received, stats.lost + stats.rxDropped, stats.errors, stats.collisions, stats.busOff ? "JA" : "nei");
+    }
+    printf("%-6s %8s %12s %12s\n", "ID", "rammer", "snitt (us)", "maks (us)");
+    for (const auto& entry : bus.latencyPerId()) {
+        const SimIdLatency& latency = entry.second;
+        printf("%-6u %8u %12.0f %12.0f\n", entry.first, latency.frames, latency.sumUs / latency.frames, latency.maxUs);
+    }
+    if (useBulk) {
+        printf("ISO-TP: %.2f kB/s til Teensyen, %u feil (bs %d, STmin %u us)\n", bulkBytes / simulatedSeconds / 1000.0,
+               linuxBulk.failures() + teensyBulk.failures(), bulkBlockSize, bulkStMinUs);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--bitrate=", 0) == 0) {
+            bitrates.clear();
+            std::stringstream list(arg.substr(10));
+            std::string item;
+            while (std::getline(list, item, ',')) bitrates.push_back(std::max(10000, atoi(item.c_str())));
+        }
+        else if (arg.rfind("--seconds=", 0) == 0) simulatedSeconds = std::max(0.1, atof(arg.c_str() + 10));
+        else if (arg.rfind("--seed=", 0) == 0) seed = strtoul(arg.c_str() + 7, nullptr, 0);
+        else if (arg.rfind("--loss=", 0) == 0) lossProbability = atof(arg.c_str() + 7);
+        else if (arg.rfind("--errors=", 0) == 0) errorProbability = atof(arg.c_str() + 9);
+        else if (arg.rfind("--ballrate=", 0) == 0) ballRateHz = std::max(1, std::min(100, atoi(arg.c_str() + 11)));
+        else if (arg == "--bulk") useBulk = true;
+        else if (arg.rfind("--bs=", 0) == 0) bulkBlockSize = std::max(0, std::min(255, atoi(arg.c_str() + 5)));
+        else if (arg.rfind("--stmin=", 0) == 0) bulkStMinUs = std::max(0, atoi(arg.c_str() + 8));
+        else std::cout << "Ukjent argument: " << arg << std::endl;
+    }
+
+    for (uint32_t bitrate : bitrates) runScenario(bitrate);
+    return 0;
+}
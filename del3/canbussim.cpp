@@ -0,0 +1,180 @@
+#include "canbussim.h"
+#include "busloadestimator.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  const int errorFrameBits = 6 + 8 + 3; // feilflagg, feilavgrenser og mellomrom
+}
+
+CanBusSim::CanBusSim(uint32_t bitrate, uint32_t seed)
+  : bitrate_{bitrate}
+  , randomState_{seed * 0x9E3779B97F4A7C15ull + 1}
+  , lossProbability_{0.0}
+  , errorProbability_{0.0}
+  , nowUs_{0.0}
+  , busFreeUs_{0.0}
+  , busyUs_{0.0}
+{}
+
+int CanBusSim::attach(const std::string& name, size_t txQueueLimit, size_t rxQueueLimit)
+{
+  Node node;
+  node.name = name;
+  node.txQueueLimit = txQueueLimit;
+  node.rxQueueLimit = rxQueueLimit;
+  node.transmitErrorCounter = 0;
+  memset(&node.stats, 0, sizeof(node.stats));
+  nodes_.push_back(node);
+  return (int)nodes_.size() - 1;
+}
+
+bool CanBusSim::send(int node, uint32_t id, const uint8_t* data, uint8_t len, bool extended)
+{
+  Node& sender = nodes_[node];
+  if (sender.stats.busOff || sender.txQueue.size() >= sender.txQueueLimit)
+  {
+    sender.stats.txDropped++;
+    return false;
+  }
+
+  SimFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.id = id;
+  frame.extended = extended;
+  frame.len = std::min<uint8_t>(len, 8);
+  memcpy(frame.data, data, frame.len);
+  frame.queuedUs = nowUs_;
+  sender.txQueue.push_back(frame);
+  return true;
+}
+
+bool CanBusSim::receive(int node, SimFrame& frame)
+{
+  std::deque<SimFrame>& queue = nodes_[node].rxQueue;
+  if (queue.empty() || queue.front().doneUs > nowUs_) return false;
+  frame = queue.front();
+  queue.pop_front();
+  return true;
+}
+
+void CanBusSim::runUntil(double timeUs)
+{
+  while (true)
+  {
+    // Arbitreringen starter når bussen er ledig og noen har noe å sende
+    double startUs = std::max(nowUs_, busFreeUs_);
+    if (startUs > timeUs) break;
+
+    int winner = -1;
+    for (int i = 0; i < (int)nodes_.size(); i++)
+    {
+      if (nodes_[i].txQueue.empty()) continue;
+      if (winner < 0 || arbitrationKey(nodes_[i].txQueue.front()) < arbitrationKey(nodes_[winner].txQueue.front())) winner = i;
+    }
+    if (winner < 0) break;
+    SimFrame frame = nodes_[winner].txQueue.front();
+
+    // Andre noder med samme ID sender samtidig. Lik data blir én ramme, ulik data gir bitfeil.
+    std::vector<int> senders = {winner};
+    bool collision = false;
+    for (int i = 0; i < (int)nodes_.size(); i++)
+    {
+      if (i == winner || nodes_[i].txQueue.empty()) continue;
+      const SimFrame& other = nodes_[i].txQueue.front();
+      if (arbitrationKey(other) != arbitrationKey(frame)) continue;
+      senders.push_back(i);
+      if (other.len != frame.len || memcmp(other.data, frame.data, frame.len) != 0) collision = true;
+    }
+
+    double durationUs = frameTimeUs(frame);
+    if (collision || nextRandom() < errorProbability_)
+    {
+      // Feilen oppdages et sted i rammen, deretter feilramme. Rammen blir liggende og prøves igjen.
+      double bitUs = 1e6 / bitrate_;
+      durationUs = durationUs * nextRandom() + errorFrameBits * bitUs;
+      for (int sender : senders)
+      {
+        if (collision) nodes_[sender].stats.collisions++;
+        transmitError(nodes_[sender]);
+      }
+    }
+    else
+    {
+      frame.doneUs = startUs + durationUs;
+      for (int sender : senders)
+      {
+        Node& node = nodes_[sender];
+        node.txQueue.pop_front();
+        node.stats.sent++;
+        if (node.transmitErrorCounter > 0) node.transmitErrorCounter--;
+      }
+      deliver(senders, frame);
+
+      SimIdLatency& latency = latencyPerId_[frame.id];
+      double waitedUs = frame.doneUs - frame.queuedUs;
+      latency.frames++;
+      latency.sumUs += waitedUs;
+      latency.maxUs = std::max(latency.maxUs, waitedUs);
+    }
+
+    busFreeUs_ = startUs + durationUs;
+    busyUs_ += durationUs;
+  }
+  nowUs_ = std::max(nowUs_, timeUs);
+}
+
+// Lavest verdi vinner: 11-bits base-ID, så IDE (standard før utvidet), så resten av utvidet ID
+uint64_t CanBusSim::arbitrationKey(const SimFrame& frame)
+{
+  if (!frame.extended) return (uint64_t)(frame.id & 0x7ff) << 19;
+  return ((uint64_t)((frame.id >> 18) & 0x7ff) << 19) | (1u << 18) | (frame.id & 0x3ffff);
+}
+
+double CanBusSim::frameTimeUs(const SimFrame& frame) const
+{
+  CanFrameInfo info = {frame.id, frame.extended, false, false, false, frame.len, frame.data};
+  return computeFrameBits(info).nominalBits * 1e6 / bitrate_;
+}
+
+// xorshift64*, samme tall på alle maskiner for samme seed
+double CanBusSim::nextRandom()
+{
+  randomState_ ^= randomState_ >> 12;
+  randomState_ ^= randomState_ << 25;
+  randomState_ ^= randomState_ >> 27;
+  return ((randomState_ * 0x2545F4914F6CDD1Dull) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void CanBusSim::transmitError(Node& node)
+{
+  node.stats.errors++;
+  node.transmitErrorCounter += 8;
+  if (node.transmitErrorCounter < busOffCounter) return;
+  node.stats.busOff = true;
+  node.stats.txDropped += node.txQueue.size();
+  node.txQueue.clear();
+}
+
+void CanBusSim::deliver(const std::vector<int>& senders, const SimFrame& frame)
+{
+  for (int i = 0; i < (int)nodes_.size(); i++)
+  {
+    if (std::find(senders.begin(), senders.end(), i) != senders.end()) continue; // ingen loopback
+    Node& node = nodes_[i];
+    if (nextRandom() < lossProbability_)
+    {
+      node.stats.lost++;
+      continue;
+    }
+    if (node.rxQueue.size() >= node.rxQueueLimit)
+    {
+      node.stats.rxDropped++;
+      continue;
+    }
+    node.rxQueue.push_back(frame);
+    node.stats.received++;
+  }
+}
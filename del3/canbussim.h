@@ -0,0 +1,117 @@
+#ifndef CANBUSSIM_H
+#define CANBUSSIM_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Virtuell CAN-buss i samme prosess, for å teste protokollendringer uten Teensy og uten vcan
+ * (vcan har ingen bitrate, ingen arbitrering og mister aldri noe).
+ *
+ * Flere noder kobles til bussen og legger rammer i sin egen sendekø. runUntil() kjører tiden
+ * fremover:
+ *  - Når bussen er ledig konkurrerer første ramme i hver nodes kø. Lavest ID vinner, som
+ *    bitvis arbitrering (11-bits ID før utvidet ID med samme base).
+ *  - Rammen tar så lang tid som bitene den faktisk bruker ved bitraten, med stuffing
+ *    (computeFrameBits() i busloadestimator.h).
+ *  - Samme ID fra to noder med ulik data gir bitfeil, som på en ekte buss. Begge prøver igjen,
+ *    og når sendefeiltelleren når 256 (32 feil på rad) går noden bus-off og køen tømmes.
+ *    En node som er bus-off kommer ikke tilbake i simuleringen.
+ *  - Feilinjeksjon: en ramme blir ødelagt av en feilramme og sendes på nytt.
+ *  - Tap: hver mottaker mister rammen (feks. full mottakskø i driveren).
+ *  - Fulle sende- og mottakskøer gir tapte rammer, og de telles.
+ *
+ * Alt tilfeldig kommer fra en egen generator med seed, så samme seed gir nøyaktig samme kjøring.
+ * Tiden er virtuell (mikrosekunder siden start) og går bare i runUntil().
+ */
+
+struct SimFrame
+{
+  uint32_t id;
+  bool extended;
+  uint8_t len;
+  uint8_t data[8];
+  double queuedUs;   // lagt i sendekøen
+  double doneUs;     // ferdig på bussen (levert til mottakerne)
+};
+
+struct SimNodeStats
+{
+  uint32_t sent;
+  uint32_t txDropped;   // sendekøen var full
+  uint32_t received;
+  uint32_t rxDropped;   // mottakskøen var full
+  uint32_t lost;        // tap-injeksjon
+  uint32_t errors;      // feilrammer under våre sendinger (injisert eller kollisjon)
+  uint32_t collisions;  // samme ID som en annen node, med ulik data
+  bool busOff;
+};
+
+struct SimIdLatency
+{
+  uint32_t frames;
+  double sumUs;         // fra sendekøen til ferdig på bussen
+  double maxUs;
+};
+
+class CanBusSim
+{
+  public:
+  CanBusSim(uint32_t bitrate, uint32_t seed = 1);
+
+  void setLossProbability(double probability) { lossProbability_ = probability; }
+  void setErrorProbability(double probability) { errorProbability_ = probability; }
+
+  // Returnerer nodens nummer
+  int attach(const std::string& name, size_t txQueueLimit = 16, size_t rxQueueLimit = 256);
+
+  // false hvis sendekøen er full eller noden er bus-off
+  bool send(int node, uint32_t id, const uint8_t* data, uint8_t len, bool extended = false);
+  // Neste ramme som er ferdig på bussen ved nowUs()
+  bool receive(int node, SimFrame& frame);
+
+  void runUntil(double timeUs);
+  double nowUs() const { return nowUs_; }
+
+  double utilization() const { return nowUs_ > 0 ? busyUs_ / nowUs_ : 0.0; }
+  uint32_t bitrate() const { return bitrate_; }
+  const std::string& name(int node) const { return nodes_[node].name; }
+  const SimNodeStats& stats(int node) const { return nodes_[node].stats; }
+  int nodeCount() const { return (int)nodes_.size(); }
+  const std::map<uint32_t, SimIdLatency>& latencyPerId() const { return latencyPerId_; }
+
+  private:
+  static const int busOffCounter = 256; // sendefeilteller: +8 per feil, -1 per vellykket ramme
+
+  struct Node
+  {
+    std::string name;
+    size_t txQueueLimit;
+    size_t rxQueueLimit;
+    std::deque<SimFrame> txQueue;
+    std::deque<SimFrame> rxQueue;
+    int transmitErrorCounter; // TEC i CAN-standarden
+    SimNodeStats stats;
+  };
+
+  static uint64_t arbitrationKey(const SimFrame& frame);
+  double frameTimeUs(const SimFrame& frame) const;
+  double nextRandom();
+  void transmitError(Node& node);
+  void deliver(const std::vector<int>& senders, const SimFrame& frame);
+
+  uint32_t bitrate_;
+  uint64_t randomState_;
+  double lossProbability_;
+  double errorProbability_;
+  double nowUs_;
+  double busFreeUs_;
+  double busyUs_;
+  std::vector<Node> nodes_;
+  std::map<uint32_t, SimIdLatency> latencyPerId_;
+};
+
+#endif
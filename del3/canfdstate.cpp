@@ -0,0 +1,101 @@
+#include "canfdstate.h"
+
+#include <string.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can/raw.h>
+
+FullStateHistory::FullStateHistory()
+  : newest_{-1}
+  , count_{0}
+{}
+
+
+void FullStateHistory::push(const FullStateEntry& entry)
+{
+  newest_ = (newest_ + 1) % fullStateHistorySize;
+  entries_[newest_] = entry;
+  if (count_ < fullStateHistorySize) count_++;
+}
+
+
+void FullStateHistory::fill(FullState& state) const
+{
+  state.historyCount = count_;
+  for (int i = 0; i < count_; i++)
+  {
+    int index = (newest_ - i + fullStateHistorySize) % fullStateHistorySize;
+    state.history[i] = entries_[index];
+  }
+}
+
+
+void packFullState(const FullState& state, struct canfd_frame& frame)
+{
+  memset(&frame, 0, sizeof(frame));
+  frame.len = CANFD_MAX_DLEN; // 64 er en gyldig FD-lengde, ubrukte bytes er 0
+
+  frame.data[0] = fullStateLayoutVersion;
+  frame.data[1] = state.phase;
+  frame.data[2] = state.scoreP1;
+  frame.data[3] = state.scoreP2;
+  frame.data[4] = state.tick & 0xff;
+  frame.data[5] = (state.tick >> 8) & 0xff;
+  frame.data[6] = (state.tick >> 16) & 0xff;
+  frame.data[7] = (state.tick >> 24) & 0xff;
+  frame.data[8] = state.historyCount;
+
+  for (int i = 0; i < state.historyCount; i++)
+  {
+    uint8_t* entry = &frame.data[fullStateHeaderSize + i * fullStateEntrySize];
+    entry[0] = state.history[i].xBall;
+    entry[1] = state.history[i].yBall;
+    entry[2] = state.history[i].platePosP1;
+    entry[3] = state.history[i].platePosP2;
+    entry[4] = (uint8_t)state.history[i].ballXVelocity;
+    entry[5] = (uint8_t)state.history[i].ballYVelocity;
+  }
+}
+
+
+bool unpackFullState(const struct canfd_frame& frame, FullState& state)
+{
+  if (frame.len < fullStateHeaderSize || frame.data[0] != fullStateLayoutVersion) return false;
+
+  state.phase   = frame.data[1];
+  state.scoreP1 = frame.data[2];
+  state.scoreP2 = frame.data[3];
+  state.tick    = frame.data[4] | (frame.data[5] << 8) | (frame.data[6] << 16) | ((uint32_t)frame.data[7] << 24);
+  state.historyCount = frame.data[8];
+
+  // Godtar ikke flere oppføringer enn det faktisk er plass til i rammen
+  int maxEntries = (frame.len - fullStateHeaderSize) / fullStateEntrySize;
+  if (state.historyCount > maxEntries) state.historyCount = maxEntries;
+
+  for (int i = 0; i < state.historyCount; i++)
+  {
+    const uint8_t* entry = &frame.data[fullStateHeaderSize + i * fullStateEntrySize];
+    state.history[i].xBall         = entry[0];
+    state.history[i].yBall         = entry[1];
+    state.history[i].platePosP1    = entry[2];
+    state.history[i].platePosP2    = entry[3];
+    state.history[i].ballXVelocity = (int8_t)entry[4];
+    state.history[i].ballYVelocity = (int8_t)entry[5];
+  }
+  return true;
+}
+
+
+bool enableCanFd(int socketDescriptor, const char* ifname)
+{
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+  if (ioctl(socketDescriptor, SIOCGIFMTU, &ifr) < 0) return false;
+  if (ifr.ifr_mtu != CANFD_MTU) return false; // klassisk grensesnitt (MTU 16)
+
+  int enable = 1;
+  if (setsockopt(socketDescriptor, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable)) < 0) return false;
+  return true;
+}
@@ -0,0 +1,84 @@
+#ifndef CANFDSTATE_H
+#define CANFDSTATE_H
+
+#include <cstdint>
+#include <linux/can.h>
+
+/*
+ * CAN FD-transport for Linux-siden (RSP3 og andre Linux-noder).
+ * Klassisk CAN har bare 8 bytes, så tilstanden må deles på ID 26/27/56/57.
+ * Med CAN FD får hele tilstanden + historikk for de siste tickene plass i én 64-bytes ramme.
+ *
+ * Forhandling:
+ *  - En node sender ID 60 (mode request): buf[0] = ønsket modus, buf[1] = flagg (bit 0: kan bitrate switch)
+ *  - Serveren svarer på ID 61 (mode ack): buf[0] = valgt modus, buf[1] = flagg serveren faktisk bruker
+ *  - I FD-modus sendes ID 62 (full state) hver tick, ellers brukes de vanlige klassiske rammene.
+ *  Forhandlingsrammene er alltid klassiske (8 bytes) slik at alle noder kan lese dem.
+ *
+ * Layout for ID 62 (64 bytes):
+ *  [0]     layout-versjon
+ *  [1]     fase (GamePhase fra sharedgamestate.h)
+ *  [2..3]  score P1, score P2
+ *  [4..7]  tick for nyeste oppføring (little endian)
+ *  [8]     antall historikk-oppføringer
+ *  [9..]   oppføringer på 6 bytes, nyeste først: xBall, yBall, P1, P2, xVel, yVel
+ */
+
+enum CanMode : uint8_t
+{
+  CAN_MODE_CLASSIC = 1,
+  CAN_MODE_FD      = 2
+};
+
+const uint8_t canModeFlagBrs = 0x01;
+
+const uint8_t fullStateLayoutVersion = 1;
+const int fullStateHeaderSize  = 9;
+const int fullStateEntrySize   = 6;
+const int fullStateHistorySize = (CANFD_MAX_DLEN - fullStateHeaderSize) / fullStateEntrySize; // 9 ticks
+
+struct FullStateEntry
+{
+  uint8_t xBall;
+  uint8_t yBall;
+  uint8_t platePosP1;
+  uint8_t platePosP2;
+  int8_t  ballXVelocity;
+  int8_t  ballYVelocity;
+};
+
+struct FullState
+{
+  uint8_t  phase;
+  uint8_t  scoreP1;
+  uint8_t  scoreP2;
+  uint32_t tick;                            // tick for history[0]
+  uint8_t  historyCount;
+  FullStateEntry history[fullStateHistorySize]; // history[0] er nyeste
+};
+
+
+// Ringbuffer på serveren med de siste tickene
+class FullStateHistory
+{
+  public:
+  FullStateHistory();
+
+  void push(const FullStateEntry& entry);
+  void clear() { count_ = 0; }
+  void fill(FullState& state) const; // kopierer historikken inn i state, nyeste først
+
+  private:
+  FullStateEntry entries_[fullStateHistorySize];
+  int newest_;
+  int count_;
+};
+
+
+void packFullState(const FullState& state, struct canfd_frame& frame);
+bool unpackFullState(const struct canfd_frame& frame, FullState& state); // false hvis layouten er ukjent
+
+// Slår på CAN FD på socketen hvis grensesnittet har MTU 72 (CAN FD, også vcan med "mtu 72")
+bool enableCanFd(int socketDescriptor, const char* ifname);
+
+#endif
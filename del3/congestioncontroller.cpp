@@ -0,0 +1,61 @@
+#include "congestioncontroller.h"
+
+#include <algorithm>
+
+CongestionController::CongestionController(const CongestionConfig& config, double tickRateHz)
+  : config_{config}
+  , tickRateHz_{tickRateHz}
+  , rateHz_{std::min(config.maxRateHz, tickRateHz)}
+  , accumulator_{0}
+  , ticksSinceEvaluation_{0}
+  , sendErrors_{0}
+  , totalSendErrors_{0}
+  , maxQueueDepth_{0}
+  , utilization_{0}
+{}
+
+
+void CongestionController::reportQueueDepth(int bytes)
+{
+  maxQueueDepth_ = std::max(maxQueueDepth_, bytes);
+}
+
+
+bool CongestionController::shouldSendState()
+{
+  if (++ticksSinceEvaluation_ >= config_.controlIntervalTicks)
+  {
+    evaluate();
+    ticksSinceEvaluation_ = 0;
+  }
+
+  accumulator_ += rateHz_ / tickRateHz_;
+  if (accumulator_ >= 1.0)
+  {
+    accumulator_ -= 1.0;
+    return true;
+  }
+  return false;
+}
+
+
+void CongestionController::evaluate()
+{
+  bool congested = sendErrors_ > 0 ||
+                   maxQueueDepth_ > config_.queueThresholdBytes ||
+                   utilization_ > config_.highUtilization;
+
+  if (congested)
+  {
+    rateHz_ = std::max(config_.minRateHz, rateHz_ / 2);
+    accumulator_ = 0; // ikke send en haug med en gang etter at raten er senket
+  }
+  else if (utilization_ < config_.lowUtilization)
+  {
+    rateHz_ = std::min(std::min(config_.maxRateHz, tickRateHz_), rateHz_ + config_.increaseStepHz);
+  }
+
+  totalSendErrors_ += sendErrors_;
+  sendErrors_ = 0;
+  maxQueueDepth_ = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef CONGESTIONCONTROLLER_H
+#define CONGESTIONCONTROLLER_H
+
+/*
+ * Regulerer hvor ofte serveren sender tilstandsrammene (ID 26/27/56 og FD-rammen 62)
+ * ut fra hvor travel bussen er. Hendelser (score, reset, mode ack) og mottak av input
+ * blir aldri strupet.
+ *
+ * AIMD, som i TCP:
+ *  - tegn på kø (ENOBUFS/EAGAIN fra write, kø i socketen, høy busbelastning) -> halver raten
+ *  - rolig buss over et helt kontrollintervall -> øk raten litt
+ * Raten holdes mellom minRateHz og maxRateHz. Sendingen styres med en akkumulator, slik
+ * at også rater som ikke går opp i 100 Hz (feks. 70 Hz) blir jevnt fordelt.
+ */
+
+struct CongestionConfig
+{
+  double minRateHz;            // laveste tilstandsrate
+  double maxRateHz;            // høyeste tilstandsrate (tickraten til serveren)
+  double increaseStepHz;       // hvor mye raten økes per rolig intervall
+  double highUtilization;      // over dette regnes bussen som overbelastet (0..1)
+  double lowUtilization;       // under dette kan raten økes
+  int queueThresholdBytes;     // mer enn dette i socketens sendekø regnes som kø
+  int controlIntervalTicks;    // hvor mange ticks mellom hver vurdering
+};
+
+class CongestionController
+{
+  public:
+  CongestionController(const CongestionConfig& config, double tickRateHz);
+
+  void reportSendError()          { sendErrors_++; }
+  void reportQueueDepth(int bytes);
+  void reportUtilization(double utilization) { utilization_ = utilization; }
+
+  // Kalles én gang per tick. Returnerer true hvis tilstanden skal sendes denne ticken.
+  bool shouldSendState();
+
+  double rateHz() const { return rateHz_; }
+  int totalSendErrors() const { return totalSendErrors_; }
+
+  private:
+  void evaluate();
+
+  CongestionConfig config_;
+  double tickRateHz_;
+  double rateHz_;
+  double accumulator_;
+  int ticksSinceEvaluation_;
+
+  int sendErrors_;
+  int totalSendErrors_;
+  int maxQueueDepth_;
+  double utilization_;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * Linux-node som forhandler CAN FD eller klassisk CAN med pong-serveren (main.cpp)
+ * og skriver ut tilstanden den mottar. Brukes for å teste FD-stien, feks. på vcan:
+ *
+ *   sudo ip link add dev vcan0 type vcan && sudo ip link set vcan0 mtu 72 up
+ *   ./pong_server --if=vcan0 --canfd
+ *   ./fdpeer --if=vcan0 [--brs] [--classic]
+ *
+ * Kompilering:
+ *   g++ -std=c++17 -O2 -o fdpeer fdpeer.cpp canfdstate.cpp
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <iostream>
+#include <string>
+#include <chrono>
+
+#include "canfdstate.h"
+#include "../felles/canmessages.h"
+
+const char *ifname = "can0";
+const int groupNumber = 6;
+
+const int idPlatePositionP1 = CanPlateP1::id(groupNumber);     // 26
+const int idPlatePositionP2 = CanPlateP2::id(groupNumber);     // 27
+const int idBallPosition    = CanBallPosition::id(groupNumber); // 56
+const int idScore           = CanScore::id(groupNumber);       // 57
+const int idModeRequest     = CanModeRequest::id(groupNumber); // 60
+const int idModeAcknowledge = CanModeAck::id(groupNumber);     // 61
+const int idFullStateFd     = CanFullStateFd::id(groupNumber); // 62
+
+const int modeRequestIntervalMs = 100;
+const int modeRequestTimeoutMs  = 500; // uten svar antar vi en gammel server og bruker klassisk
+
+bool createCanSocket(int& socketDescriptor) {
+    struct sockaddr_can addr;
+    struct ifreq ifr;
+    if ((socketDescriptor = socket(PF_CAN, SOCK_RAW, CAN_RAW)) < 0) return false;
+    strcpy(ifr.ifr_name, ifname);
+    if (ioctl(socketDescriptor, SIOCGIFINDEX, &ifr) < 0) return false;
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(socketDescriptor, (struct sockaddr *)&addr, sizeof(addr)) < 0) return false;
+    return true;
+}
+
+void sendModeRequest(int socketDescriptor, uint8_t mode, uint8_t flags) {
+    struct can_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    CanModeRequest::encode({mode, flags}, groupNumber, frame);
+    write(socketDescriptor, &frame, sizeof(struct can_frame));
+}
+
+int main(int argc, char* argv[]) {
+    bool wantBrs = false;
+    bool forceClassic = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--brs") wantBrs = true;
+        else if (arg == "--classic") forceClassic = true;
+        else if (arg.rfind("--if=", 0) == 0) ifname = argv[i] + 5;
+    }
+
+    int canSocketDescriptor;
+    if (!createCanSocket(canSocketDescriptor)) {
+        std::cout << "Fikk ikke åpnet " << ifname << std::endl;
+        return 1;
+    }
+
+    bool fdCapable = !forceClassic && enableCanFd(canSocketDescriptor, ifname);
+    uint8_t wantedMode = fdCapable ? CAN_MODE_FD : CAN_MODE_CLASSIC;
+    uint8_t wantedFlags = (fdCapable && wantBrs) ? canModeFlagBrs : 0;
+
+    // Forhandling: send forespørsel til vi får svar eller gir opp
+    uint8_t mode = CAN_MODE_CLASSIC;
+    uint8_t modeFlags = 0;
+    bool acknowledged = false;
+    auto start = std::chrono::steady_clock::now();
+    auto nextRequest = start;
+    while (!acknowledged) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - start > std::chrono::milliseconds(modeRequestTimeoutMs)) break;
+        if (now >= nextRequest) {
+            sendModeRequest(canSocketDescriptor, wantedMode, wantedFlags);
+            nextRequest = now + std::chrono::milliseconds(modeRequestIntervalMs);
+        }
+
+        struct canfd_frame rxFrame;
+        CanModeChoice ack;
+        while (recv(canSocketDescriptor, &rxFrame, sizeof(struct canfd_frame), MSG_DONTWAIT) > 0) {
+            if (rxFrame.can_id == idModeAcknowledge && CanModeAck::decode(rxFrame, ack)) {
+                mode = ack.mode;
+                modeFlags = ack.flags;
+                acknowledged = true;
+            }
+        }
+        usleep(1000);
+    }
+
+    if (!acknowledged) std::cout << "Ingen svar fra serveren, bruker klassisk CAN." << std::endl;
+    std::cout << "Modus: " << (mode == CAN_MODE_FD ? "CAN FD" : "klassisk")
+              << ((modeFlags & canModeFlagBrs) ? " med bitrate switch" : "") << std::endl;
+
+    CanBall ball = {};
+    CanPlate p1 = {}, p2 = {};
+    CanPoints score = {};
+    while (true) {
+        struct canfd_frame rxFrame;
+        ssize_t nbytes = recv(canSocketDescriptor, &rxFrame, sizeof(struct canfd_frame), 0);
+        if (nbytes <= 0) continue;
+
+        if (nbytes == CANFD_MTU && rxFrame.can_id == idFullStateFd) {
+            FullState state;
+            if (!unpackFullState(rxFrame, state) || state.historyCount == 0) continue;
+            std::cout << "\r[FD" << ((rxFrame.flags & CANFD_BRS) ? "+BRS" : "") << "] tick " << state.tick
+                      << "  Ball (" << (int)state.history[0].xBall << ", " << (int)state.history[0].yBall << ")"
+                      << "  P1 " << (int)state.history[0].platePosP1 << "  P2 " << (int)state.history[0].platePosP2
+                      << "  Score " << (int)state.scoreP1 << " - " << (int)state.scoreP2
+                      << "  historikk " << (int)state.historyCount << "   " << std::flush;
+            continue;
+        }
+
+        // Klassiske rammer
+        bool known = false;
+        if (rxFrame.can_id == idBallPosition)         known = CanBallPositionLegacy::decode(rxFrame, ball);
+        else if (rxFrame.can_id == idPlatePositionP1) known = CanPlateP1::decode(rxFrame, p1);
+        else if (rxFrame.can_id == idPlatePositionP2) known = CanPlateP2::decode(rxFrame, p2);
+        else if (rxFrame.can_id == idScore)           known = CanScore::decode(rxFrame, score);
+        if (!known) continue;
+
+        if (mode == CAN_MODE_CLASSIC) {
+            std::cout << "\r[klassisk] Ball (" << ball.x << ", " << ball.y << ")  P1 " << p1.position << "  P2 " << p2.position
+                      << "  Score " << score.scoreP1 << " - " << score.scoreP2 << "   " << std::flush;
+        }
+    }
+
+    close(canSocketDescriptor);
+    return 0;
+}
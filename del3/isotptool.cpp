@@ -0,0 +1,319 @@
+/*
+ * ISO-TP (ISO 15765-2) fra Linux, med CAN_ISOTP-socketen i kjernen (Linux 5.10 eller nyere).
+ * Motparten er en Teensy med ../felles/isotp.h (CanBusHandler::sendBulk() og bulk()).
+ *
+ * Sender og tar imot meldinger på inntil 4095 bytes: kamplogger, konfigtabeller og diagnose.
+ * Vi sender på gruppe + 110 og tar imot på gruppe + 111, nederst i gruppens ID-blokk, så
+ * spillrammene alltid vinner arbitreringen.
+ *
+ * Bruk:
+ *   ./isotptool --send=konfig.bin            send en fil
+ *   ./isotptool --receive                    skriv ut alt som kommer
+ *   ./isotptool --info                       be Teensyen om gruppenumre og tellere
+ *   ./isotptool --bench --size=4095 --count=20
+ *        send ekko-forespørsler til Teensyen og mål gjennomstrømningen begge veier
+ *   ./isotptool --bench --loopback --if=vcan0 --game-rate=100
+ *        begge endene i denne prosessen, og spillrammer på --game-id samtidig, så vi ser om
+ *        bulk-trafikken forsinker dem (bare på vcan, ikke på en buss der serveren kjører)
+ *
+ *   --bs=N       block size vi ber om når vi tar imot (0 = alle rammene uten ny flow control)
+ *   --stmin=us   minste tid mellom rammene vi tar imot (0-900 us i steg på 100, ellers hele ms)
+ *   --group=N    gruppenummeret ID-ene regnes fra (standard 6)
+ *
+ * Kompilering:
+ *   g++ -std=c++17 -O2 -pthread -o isotptool isotptool.cpp
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/can/isotp.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "../felles/isotp.h"
+#include "../felles/canmessages.h"
+
+const char *ifname = "can0";
+int groupNumber = 6;
+int blockSize = 8;
+uint32_t stMinUs = 0;
+int messageSize = IsoTp::maxMessage;
+int messageCount = 20;
+int gameRateHz = 100;
+uint32_t gameId = 56;
+
+const uint8_t bulkEcho = 1; // samme kommandoer som Kristie/objektorientert/pingponggame.ino
+const uint8_t bulkInfo = 2;
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int openIsoTpSocket(uint32_t txId, uint32_t rxId) {
+    int socketDescriptor = socket(PF_CAN, SOCK_DGRAM, CAN_ISOTP);
+    if (socketDescriptor < 0) {
+        std::cout << "Fikk ikke åpnet CAN_ISOTP-socket (modprobe can-isotp?)" << std::endl;
+        return -1;
+    }
+
+    // Det vi sier til senderen i flow control når vi tar imot
+    struct can_isotp_fc_options flowControl;
+    memset(&flowControl, 0, sizeof(flowControl));
+    flowControl.bs = blockSize;
+    flowControl.stmin = IsoTp::encodeStMin(stMinUs);
+    setsockopt(socketDescriptor, SOL_CAN_ISOTP, CAN_ISOTP_RECV_FC, &flowControl, sizeof(flowControl));
+
+    struct sockaddr_can addr;
+    struct ifreq ifr;
+    memset(&addr, 0, sizeof(addr));
+    strcpy(ifr.ifr_name, ifname);
+    if (ioctl(socketDescriptor, SIOCGIFINDEX, &ifr) < 0) {
+        std::cout << "Fant ikke " << ifname << std::endl;
+        close(socketDescriptor);
+        return -1;
+    }
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    addr.can_addr.tp.tx_id = txId;
+    addr.can_addr.tp.rx_id = rxId;
+    if (bind(socketDescriptor, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(socketDescriptor);
+        return -1;
+    }
+
+    // Gir opp å vente på et svar etter 2 s
+    struct timeval timeout = {2, 0};
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return socketDescriptor;
+}
+
+int openRawSocket() {
+    struct sockaddr_can addr;
+    struct ifreq ifr;
+    int socketDescriptor = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (socketDescriptor < 0) return -1;
+    strcpy(ifr.ifr_name, ifname);
+    if (ioctl(socketDescriptor, SIOCGIFINDEX, &ifr) < 0) return -1;
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(socketDescriptor, (struct sockaddr *)&addr, sizeof(addr)) < 0) return -1;
+    return socketDescriptor;
+}
+
+void printMessage(const uint8_t* data, int len) {
+    bool printable = std::all_of(data, data + len, [](uint8_t c) { return c >= 32 && c < 127; });
+    std::cout << len << " bytes: ";
+    if (printable) {
+        std::cout << std::string((const char*)data, len) << std::endl;
+        return;
+    }
+    char hex[4];
+    for (int i = 0; i < std::min(len, 32); i++) {
+        snprintf(hex, sizeof(hex), "%02x ", data[i]);
+        std::cout << hex;
+    }
+    std::cout << (len > 32 ? "..." : "") << std::endl;
+}
+
+// Spillrammer med fast rate mens bulk-trafikken går. Mottakeren måler største mellomrom.
+struct GameFrameStats {
+    std::atomic<bool> running{true};
+    int sent = 0;
+    int sendErrors = 0;
+    int received = 0;
+    double maxGapMs = 0;
+};
+
+void sendGameFrames(GameFrameStats& stats) {
+    int socketDescriptor = openRawSocket();
+    if (socketDescriptor < 0) return;
+    auto period = std::chrono::microseconds(1000000 / gameRateHz);
+    auto next = std::chrono::steady_clock::now();
+    while (stats.running) {
+        struct can_frame frame;
+        memset(&frame, 0, sizeof(frame));
+        frame.can_id = gameId;
+        frame.can_dlc = 6;
+        if (write(socketDescriptor, &frame, sizeof(frame)) == sizeof(frame)) stats.sent++;
+        else stats.sendErrors++; // sendekøen i kjernen er full av bulk
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+    close(socketDescriptor);
+}
+
+void receiveGameFrames(GameFrameStats& stats) {
+    int socketDescriptor = openRawSocket();
+    if (socketDescriptor < 0) return;
+    struct can_filter filter = {gameId, CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG};
+    setsockopt(socketDescriptor, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter));
+    struct timeval timeout = {0, 100000};
+    setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    auto last = std::chrono::steady_clock::now();
+    bool first = true;
+    while (stats.running) {
+        struct can_frame frame;
+        if (read(socketDescriptor, &frame, sizeof(frame)) != sizeof(frame)) continue;
+        auto now = std::chrono::steady_clock::now();
+        if (!first) stats.maxGapMs = std::max(stats.maxGapMs, std::chrono::duration<double, std::milli>(now - last).count());
+        first = false;
+        last = now;
+        stats.received++;
+    }
+    close(socketDescriptor);
+}
+
+// Sender count meldinger og venter på hver av dem tilbake (ekko fra Teensyen, eller fra
+// den andre socketen i loopback). Gjennomstrømningen regnes begge veier.
+int runBench(bool loopback) {
+    uint32_t ourTx = CanBulkToNode::id(groupNumber);
+    uint32_t ourRx = CanBulkFromNode::id(groupNumber);
+    int socketDescriptor = openIsoTpSocket(ourTx, ourRx);
+    if (socketDescriptor < 0) return 1;
+
+    int peerSocket = -1;
+    std::thread echoThread;
+    std::atomic<bool> echoRunning{true};
+    if (loopback) {
+        // Den andre enden gjør det samme som pingponggame.ino: sender meldingen tilbake
+        peerSocket = openIsoTpSocket(ourRx, ourTx);
+        if (peerSocket < 0) return 1;
+        echoThread = std::thread([&]() {
+            std::vector<uint8_t> buffer(IsoTp::maxMessage);
+            while (echoRunning) {
+                int len = read(peerSocket, buffer.data(), buffer.size());
+                if (len > 0) write(peerSocket, buffer.data(), len);
+            }
+        });
+    }
+
+    GameFrameStats gameStats;
+    std::thread gameSender, gameReceiver;
+    if (loopback && gameRateHz > 0) {
+        gameReceiver = std::thread(receiveGameFrames, std::ref(gameStats));
+        gameSender = std::thread(sendGameFrames, std::ref(gameStats));
+    }
+
+    std::vector<uint8_t> request(std::max(1, std::min(messageSize, (int)IsoTp::maxMessage)));
+    for (size_t i = 0; i < request.size(); i++) request[i] = (uint8_t)i;
+    request[0] = bulkEcho;
+    std::vector<uint8_t> reply(IsoTp::maxMessage);
+
+    int ok = 0;
+    double maxRoundTripMs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < messageCount; i++) {
+        auto sent = std::chrono::steady_clock::now();
+        if (write(socketDescriptor, request.data(), request.size()) != (ssize_t)request.size()) {
+            std::cout << "Sending feilet: " << strerror(errno) << std::endl;
+            break;
+        }
+        int len = read(socketDescriptor, reply.data(), reply.size());
+        if (len != (int)request.size() || memcmp(reply.data(), request.data(), len) != 0) {
+            std::cout << "Feil eller manglende ekko på melding " << i << std::endl;
+            continue;
+        }
+        ok++;
+        maxRoundTripMs = std::max(maxRoundTripMs, secondsSince(sent) * 1000.0);
+    }
+    double seconds = secondsSince(start);
+
+    gameStats.running = false;
+    if (gameSender.joinable()) gameSender.join();
+    if (gameReceiver.joinable()) gameReceiver.join();
+    echoRunning = false;
+    if (echoThread.joinable()) {
+        shutdown(peerSocket, SHUT_RDWR);
+        echoThread.join();
+        close(peerSocket);
+    }
+    close(socketDescriptor);
+
+    double bytes = 2.0 * ok * request.size();
+    std::cout << "Meldinger: " << ok << "/" << messageCount << " à " << request.size() << " bytes, bs " << blockSize
+              << ", STmin " << stMinUs << " us" << std::endl;
+    std::cout << "Gjennomstrømning: " << bytes / seconds / 1000.0 << " kB/s begge veier til sammen, maks rundtur "
+              << maxRoundTripMs << " ms" << std::endl;
+    if (loopback && gameRateHz > 0) {
+        std::cout << "Spillrammer: " << gameStats.sent << " sendt, " << gameStats.received << " mottatt, "
+                  << gameStats.sendErrors << " sendefeil, maks mellomrom " << gameStats.maxGapMs << " ms (skal være "
+                  << 1000.0 / gameRateHz << ")" << std::endl;
+    }
+    return ok == messageCount ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    std::string sendFile;
+    bool receiveMode = false, infoMode = false, benchMode = false, loopback = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--if=", 0) == 0) ifname = argv[i] + 5;
+        else if (arg.rfind("--send=", 0) == 0) sendFile = arg.substr(7);
+        else if (arg == "--receive") receiveMode = true;
+        else if (arg == "--info") infoMode = true;
+        else if (arg == "--bench") benchMode = true;
+        else if (arg == "--loopback") loopback = true;
+        else if (arg.rfind("--group=", 0) == 0) groupNumber = atoi(arg.c_str() + 8);
+        else if (arg.rfind("--bs=", 0) == 0) blockSize = std::max(0, std::min(255, atoi(arg.c_str() + 5)));
+        else if (arg.rfind("--stmin=", 0) == 0) stMinUs = std::max(0, atoi(arg.c_str() + 8));
+        else if (arg.rfind("--size=", 0) == 0) messageSize = std::max(1, atoi(arg.c_str() + 7));
+        else if (arg.rfind("--count=", 0) == 0) messageCount = std::max(1, atoi(arg.c_str() + 8));
+        else if (arg.rfind("--game-rate=", 0) == 0) gameRateHz = std::max(0, std::min(1000, atoi(arg.c_str() + 12)));
+        else if (arg.rfind("--game-id=", 0) == 0) gameId = strtoul(arg.c_str() + 10, nullptr, 0) & CAN_SFF_MASK;
+        else std::cout << "Ukjent argument: " << arg << std::endl;
+    }
+
+    if (benchMode) return runBench(loopback);
+
+    int socketDescriptor = openIsoTpSocket(CanBulkToNode::id(groupNumber), CanBulkFromNode::id(groupNumber));
+    if (socketDescriptor < 0) return 1;
+    std::vector<uint8_t> buffer(IsoTp::maxMessage);
+
+    if (!sendFile.empty()) {
+        std::ifstream file(sendFile, std::ios::binary);
+        file.read((char*)buffer.data(), buffer.size());
+        int len = file.gcount();
+        if (len <= 0 || file.peek() != EOF) {
+            std::cout << sendFile << " er tom, finnes ikke, eller er større enn " << IsoTp::maxMessage << " bytes" << std::endl;
+            return 1;
+        }
+        auto start = std::chrono::steady_clock::now();
+        if (write(socketDescriptor, buffer.data(), len) != len) {
+            std::cout << "Sending feilet: " << strerror(errno) << std::endl;
+            return 1;
+        }
+        std::cout << "Sendte " << len << " bytes på " << secondsSince(start) * 1000.0 << " ms" << std::endl;
+    }
+
+    if (infoMode) {
+        uint8_t request[1] = {bulkInfo};
+        write(socketDescriptor, request, 1);
+        int len = read(socketDescriptor, buffer.data(), buffer.size());
+        if (len <= 0) {
+            std::cout << "Ingen svar fra Teensyen" << std::endl;
+            return 1;
+        }
+        printMessage(buffer.data(), len);
+    }
+
+    while (receiveMode) {
+        int len = read(socketDescriptor, buffer.data(), buffer.size());
+        if (len > 0) printMessage(buffer.data(), len);
+    }
+
+    close(socketDescriptor);
+    return 0;
+}
@@ -7,21 +7,73 @@
  * 2. Mottar Tastatur-input fra RSP3 (P2).
  * 3. Beregner posisjon for BEGGE plater og ballen.
  * 4. Sender ALLE posisjoner tilbake til Teensy for tegning.
+ * 5. Publiserer spilltilstanden i shared memory (se sharedgamestate.h) slik at
+ *    andre prosesser på RSP3 kan følge med (feks. stateviewer.cpp).
+ * 6. Kan vise spillet i terminalen med "--vis" (eller "--vis=braille" for små terminaler)
+ *    og "--fps=N" for oppdateringsraten (standard 30).
+ * 7. Kan bruke CAN FD med "--canfd" (og "--brs" for bitrate switch) mot Linux-noder som ber om det,
+ *    se canfdstate.h. "--if=vcan0" velger et annet grensesnitt enn can0.
+ * 8. Senker raten på tilstandsrammene når bussen er full (se congestioncontroller.h).
+ *    "--bitrate=N" er bitraten på bussen (standard 500000), "--minrate=N" og "--maxrate=N" grensene i Hz.
+ * 9. Alle rammer går gjennom en sendekø (txmanager.h): tilstand er "nyeste verdi vinner",
+ *    hendelser sendes i rekkefølge.
+ * 10. Score, reset og reset ack går over en pålitelig kanal med sekvensnummer og ack
+ *    (se ../felles/reliableevents.h), slik at én tapt ramme ikke gir ulik tilstand.
+ * 11. Svarer på klokke-ping fra Teensy (se ../felles/clocksync.h), og ballrammene har med
+ *    ticken de ble laget i. Ticks kjøres på et fast skjema (ikke bare usleep), slik at
+ *    tick * 10 ms følger sanntid.
+ * 12. Ballrammen har med farten, slik at klientene kan gjette posisjonen mellom rammene
+ *    (se ../felles/ballpredictor.h). Ballen sendes derfor bare ~25 ganger i sekundet
+ *    ("--ballrate=N"), og med en gang når farten endres (sprett, scoring, reset).
+ * 13. "--trajectory": ballen sendes bare som baner (start, fart og tick) på ID 55 når den
+ *    spretter, scorer eller resettes, over den pålitelige kanalen. Klientene regner ut
+ *    posisjonen selv. ID 56 sendes da bare hvert andre sekund som en oppfriskning.
+ * 14. Joystick-rammer med sekvensnummer ([tilstand, seq]) brukes én gang hver, og ID 26
+ *    sender med siste behandlede seq. Da kan Teensyen flytte sin egen plate med en gang
+ *    og rette seg etter serveren uten å hoppe (client-side prediction).
+ * 15. Ser om Teensyen har falt ut (se ../felles/heartbeat.h): hører vi ingenting fra den
+ *    på 500 ms ("--teensy-timeout=ms") står spillet på pause til den er tilbake, i stedet
+ *    for at ballen går forbi en plate som ingen styrer. Gjelder bare Teensyer som har sagt
+ *    i hello (17) at de sender heartbeat, de gamle sender bare når joysticken flyttes.
+ * 16. En Teensy som har startet på nytt ber om hele tilstanden (ID 67) og får den med en
+ *    gang (ID 68), slik at den viser riktig poeng uten å vente på neste mål.
+ * 17. Teensyen sender hello (ID 69) med protokollversjon, rammeformater, tick-rate og funksjoner
+ *    (se ../felles/hello.h). Serveren svarer (ID 70) med det beste begge kan, eller grunnen til
+ *    at det ikke går. Gamle klienter uten hello får rammene som før.
+ *
+ * Kompilering:
+ *   g++ -std=c++17 -O2 -o pong_server main.cpp sharedgamestate.cpp terminalview.cpp canfdstate.cpp \
+ *       busloadestimator.cpp congestioncontroller.cpp txmanager.cpp -lrt
  */
 
 /*
   CAN BUS PROTOKOLL (Gruppe 6):
 
   [INPUT TIL RSP3]
-  ID 25: P1 Input (0=Stille, 1=Opp, 2=Ned) -> Fra Teensy
-  ID 58: Reset Signal (Hvis P1 trykker knapp) -> Fra Teensy
+  ID 25: P1 Input (0=Stille, 1=Opp, 2=Ned) -> Fra Teensy [tilstand] eller [tilstand, seq]
+  ID 58: Reset Signal (Hvis P1 trykker knapp) -> Fra Teensy [1, seq]
+  ID 60: Mode request (klassisk eller CAN FD) -> Fra Linux-noder
+  ID 64: Ack fra Teensy for hendelser (hendelses-ID lav, høy, seq)
+  ID 65: Klokke-ping fra Teensy [t1 (4 bytes)]
+  ID 31: Heartbeat fra Teensy hvert 100. ms [1 = spiller, 2 = game over]
+  ID 67: Be om hele tilstanden (Teensy har startet på nytt) [1]
+  ID 69: Hello [min versjon, maks versjon, rammeformater, funksjoner (2 bytes), tick Hz, bitrate / 10 kbit]
 
   [OUTPUT FRA RSP3]
-  ID 26: P1 Faktisk Posisjon (Sendes tilbake til Teensy for tegning)
+  ID 55: Ballbane (X, Y, tick lav, tick høy, fart X, fart Y, seq) -> kun med "--trajectory"
+  ID 26: P1 Faktisk Posisjon (Sendes tilbake til Teensy for tegning) [posisjon, siste input-seq]
   ID 27: P2 Faktisk Posisjon (Sendes til Teensy for tegning av motstander)
-  ID 56: Ball Posisjon (X, Y)
-  ID 57: Score (P1 Score, P2 Score)
-  ID 59: Reset signal (en melding som sier til teensyen at alt skal resetes)
+  ID 56: Ball Posisjon (X, Y, tick lav, tick høy, fart X, fart Y) (fart er 0 under pausen etter scoring)
+  ID 57: Score (P1 Score, P2 Score, seq)
+  ID 59: Reset signal (en melding som sier til teensyen at alt skal resetes) [1, seq]
+  ID 61: Mode ack (valgt modus)
+  ID 62: Full state med historikk (kun CAN FD, 64 bytes)
+  ID 63: Ack fra RSP3 for hendelser (hendelses-ID lav, høy, seq)
+  ID 66: Klokke-pong [t1 (ekko), tick (3 bytes), tid i ticken / 40 us]
+  ID 68: Hele tilstanden [P1 score, P2 score, fase (0 spill, 1 pause, 2 game over), P1 pos, P2 pos,
+         ball X, ball Y, fart X | fart Y << 4]
+  ID 70: Hello-svar [resultat, versjon, rammeformat, funksjoner (2 bytes), tick Hz, bitrate / 10 kbit]
+         Med gammelt rammeformat er ID 56 bare [X, Y] og ID 26 bare [posisjon].
 */
 
 
@@ -33,6 +85,8 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <linux/sockios.h>
 #include <termios.h>
 #include <linux/can.h>
 #include <linux/can/raw.h>
@@ -42,6 +96,20 @@
 #include <algorithm>
 #include <chrono>
 
+#include "sharedgamestate.h"
+#include "terminalview.h"
+#include "canfdstate.h"
+#include "busloadestimator.h"
+#include "congestioncontroller.h"
+#include "txmanager.h"
+#include "../felles/reliableevents.h"
+#include "../felles/clocksync.h"
+#include "../felles/heartbeat.h"
+#include "../felles/hello.h"
+#include "../felles/canmessages.h"
+#include "../felles/candispatch.h"
+#include <thread>
+
 
 
 // CAN KONFIGURASJON
@@ -50,16 +118,74 @@ int canSocketDescriptor;
 
 const int groupNumber = 6;
 
-// ID FOR INPUT
-const int idJoystickP1        = groupNumber + 19; // 25 (Input fra Teensy: 1=Opp, 2=Ned, 0=Stille)
-const int idResetRequest      = groupNumber + 52; // 58 (Teensy → RPi Teensyen som ber RPi om å resette)
+// ID FOR INPUT (ID-ene og innholdet står i felles/canmessages.h)
+const int idJoystickP1        = CanJoystickP1::id(groupNumber);      // 25 (Input fra Teensy: 1=Opp, 2=Ned, 0=Stille)
+const int idResetRequest      = CanResetGame::id(groupNumber);       // 58 (Teensy → RPi Teensyen som ber RPi om å resette)
+const int idModeRequest       = CanModeRequest::id(groupNumber);     // 60 (Linux-node → RPi: ønsker klassisk eller FD)
+const int idTimePing          = CanTimePing::id(groupNumber);        // 65 (Teensy → RPi: klokke-ping)
+const int idHeartbeatTeensy   = CanHeartbeatP1::id(groupNumber);     // 31 (Teensy → RPi: heartbeat)
+const int idSnapshotRequest   = CanSnapshotRequest::id(groupNumber); // 67 (Teensy → RPi: send hele tilstanden)
+const int idHello             = CanHello::id(groupNumber);           // 69 (Teensy → RPi: protokoll og funksjoner)
 
 // ID-er for Outputs (Sendes TIL Teensy)
-const int idPlatePositionP1   = groupNumber + 20; // 26 (RSP3 forteller hvor P1 er)
-const int idPlatePositionP2   = groupNumber + 21; // 27 (RSP3 forteller hvor P2 er)
-const int idBallPosition      = groupNumber + 50; // 56 (Ball posisjonen)
-const int idScore             = groupNumber + 51; // 57 (Scoren)
-const int idResetAcknowledge  = groupNumber + 53; // 59 (RPi → Teensy RPi som sender en melding til teensyen om at spillet faktisk blir resatt)
+const int idPlatePositionP1   = CanPlateAckP1::id(groupNumber);      // 26 (RSP3 forteller hvor P1 er)
+const int idPlatePositionP2   = CanPlateP2::id(groupNumber);         // 27 (RSP3 forteller hvor P2 er)
+const int idBallTrajectory    = CanBallTrajectory::id(groupNumber);  // 55 (Ballbane ved sprett/scoring/reset, med "--trajectory")
+const int idBallPosition      = CanBallPosition::id(groupNumber);    // 56 (Ball posisjonen)
+const int idScore             = CanScore::id(groupNumber);           // 57 (Scoren)
+const int idResetAcknowledge  = CanResetAck::id(groupNumber);        // 59 (RPi → Teensy RPi som sender en melding til teensyen om at spillet faktisk blir resatt)
+const int idModeAcknowledge   = CanModeAck::id(groupNumber);         // 61 (RPi → Linux-node: valgt modus)
+const int idFullStateFd       = CanFullStateFd::id(groupNumber);     // 62 (Hele tilstanden + historikk i én CAN FD-ramme)
+const int idEventAckServer    = CanEventAckP1::id(groupNumber);      // 63 (RPi → Teensy: ack for hendelser)
+const int idEventAckClient    = CanEventAckP2::id(groupNumber);      // 64 (Teensy → RPi: ack for hendelser)
+const int idTimePong          = CanTimePong::id(groupNumber);        // 66 (RPi → Teensy: svar på klokke-ping)
+const int idSnapshot          = CanSnapshotReply::id(groupNumber);   // 68 (RPi → Teensy: hele tilstanden, svar på ID 67)
+const int idHelloReply        = CanHelloReply::id(groupNumber);      // 70 (RPi → Teensy: valgt protokoll, eller hvorfor ikke)
+
+// CAN FD
+bool useCanFd = false;        // "--canfd": prøv å slå på FD
+bool useBrs = false;          // "--brs": bruk bitrate switch i FD-rammene
+bool canFdAvailable = false;  // grensesnittet og socketen støtter FD
+bool fdPeerActive = false;    // minst én node har forhandlet FD
+bool fdPeerUsesBrs = false;   // FD-noden kan ta imot bitrate switch
+bool classicPeerSeen = false; // en klassisk node (Teensy) er på bussen og trenger de vanlige rammene
+FullStateHistory fullStateHistory;
+
+// Metningskontroll for tilstandsrammene
+uint32_t busBitrate = 500000;
+CongestionConfig congestionConfig = {
+    20.0,   // minRateHz
+    100.0,  // maxRateHz
+    10.0,   // increaseStepHz
+    0.50,   // highUtilization: over 50 % begynner arbitreringen å forsinke ball-rammene merkbart
+    0.30,   // lowUtilization
+    256,    // queueThresholdBytes (16 klassiske rammer)
+    10      // controlIntervalTicks (100 ms)
+};
+CongestionController* congestionController = nullptr;
+BusLoadEstimator* busLoad = nullptr;
+std::chrono::steady_clock::time_point busLoadWindowStart;
+
+// Sendekø
+TxManager txManager;
+
+// Pålitelige hendelser (score, reset)
+void sendReliableFrame(uint32_t id, const uint8_t* data, uint8_t len);
+ReliableEvents reliableEvents(sendReliableFrame, idEventAckServer);
+const std::chrono::steady_clock::time_point serverStartTime = std::chrono::steady_clock::now();
+
+uint32_t millisSinceStart() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - serverStartTime).count();
+}
+
+// Serverklokka som Teensyen synkroniserer mot (se clocksync.h): tick = 10 ms siden start
+uint64_t microsSinceStart() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - serverStartTime).count();
+}
+
+uint16_t clockTick16() {
+    return (uint16_t)(microsSinceStart() / ClockSync::tickUs);
+}
 
 // Spill-variabler
 // Skjerm
@@ -76,6 +202,7 @@ const int plateSpeedP2 = 3; // Hvor fort platen for P2 beveger seg per 'tick'
 
 // Input lagring
 int p1MoveState = 0; // 0=Stille, 1=Opp, 2=Ned
+uint8_t lastP1InputSeq = 0; // siste joystick-ramme med seq som er brukt, sendes tilbake i ID 26
 int p2MoveState = 0; // 0=Stille, 1=Opp, 2=Ned
 int p2HoldCounter = 0;     // teller hvor mange 'tick' den skal gå mens den holdes nede
 const int holdThreshold = 4; // beveger seg med 4 'ticks' når knappen blir holdt nede
@@ -101,6 +228,48 @@ const int taskSleepTimeUs = 10000; // 10ms = 100Hz
 bool isPaused = false;
 std::chrono::steady_clock::time_point pauseEndTime;
 
+// Teensyen sender heartbeat hvert 100. ms, og alle rammer fra den teller som livstegn.
+// Forsvinner den står spillet stille (teensyLost) til den er tilbake. Bare klienter som har
+// sagt FEATURE_HEARTBEAT i hello følges: de gamle sender bare når joysticken flyttes.
+PeerMonitor teensyMonitor(100, 500);
+bool teensyHeartbeat = false;
+bool teensyLost = false;
+
+// Ballrammer: fast rate, og ekstra rammer når farten endres
+int ballRateHz = 25;
+bool trajectoryRequested = false;      // "--trajectory"
+bool useTrajectoryMode = false;        // banemodus er på, og Teensyen kan det (se handleHello)
+const int trajectoryRefreshTicks = 200; // vanlig ballramme hvert andre sekund i banemodus
+int ticksSinceBallFrame = 0;
+int8_t lastSentBallXVelocity = 0;
+int8_t lastSentBallYVelocity = 0;
+bool ballFrameForced = true; // ballen har hoppet (scoring/reset), send uansett
+
+// Rammeformat avtalt med hello. Klienter uten hello får det pakkede formatet,
+// som de gamle skissene også tåler (de leser bare de første bytene).
+bool useLegacyLayout = false;
+
+// Shared memory for eksterne lesere
+SharedGameStatePublisher sharedGameState;
+uint32_t tickCounter = 0; // teller antall ticks siden serveren startet
+
+// Terminalvisning (valgfri)
+TerminalView terminalView;
+bool useTerminalView = false;
+TerminalView::Mode terminalViewMode = TerminalView::HALF_BLOCKS;
+int terminalViewFps = 30;
+std::chrono::steady_clock::time_point nextRenderTime;
+
+// Settes av Ctrl+C slik at terminalen blir gjenopprettet før vi avslutter
+volatile sig_atomic_t keepRunning = 1;
+void handleSigint(int) { keepRunning = 0; }
+
+// Skriver en melding til konsollen, eller til meldingslinjen hvis terminalvisningen er på
+void statusMessage(const std::string& text) {
+    if (terminalView.isActive()) terminalView.setMessage(text);
+    else std::cout << text << std::endl;
+}
+
 
 // Tastatur (P2 Input)
 void setNonBlockingKeyboard(bool enable) {
@@ -129,19 +298,214 @@ bool createCanSocket(int& socketDescriptor) {
     if (bind(socketDescriptor, (struct sockaddr *)&addr, sizeof(addr)) < 0) return false;
     return true;
 }
-void sendCanMessage(int socketDescriptor, int id, uint8_t* data, int len) {
-    struct can_frame frame;
-    frame.can_id = id;
-    frame.can_dlc = len;
-    memcpy(frame.data, data, len);
-    write(socketDescriptor, &frame, sizeof(struct can_frame));
+// Rammen slik busbelastningen ser den: 29-bits ID-er har lengre header enn 11-bits (som i busload.cpp)
+CanFrameInfo busLoadFrameInfo(const struct canfd_frame& frame, bool fd) {
+    bool extended = (frame.can_id & CAN_EFF_FLAG) != 0;
+    bool rtr = (frame.can_id & CAN_RTR_FLAG) != 0;
+    uint32_t id = frame.can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+    return {id, extended, rtr, fd, fd && (frame.flags & CANFD_BRS), frame.len, frame.data};
+}
+// Egne rammer kommer ikke tilbake på socketen, så de telles i busbelastningen her
+void onFrameSent(const struct canfd_frame& frame, bool fd) {
+    if (!busLoad) return;
+    busLoad->addFrame(busLoadFrameInfo(frame, fd));
+}
+// Hendelser (score, reset, ack) sendes i rekkefølge og blir aldri byttet ut
+void sendEvent(int id, uint8_t* data, int len) {
+    txManager.queueEvent(id, data, len);
+}
+// Rammer fra den pålitelige kanalen (hendelser, retransmisjoner og acker) går i hendelseskøen
+void sendReliableFrame(uint32_t id, const uint8_t* data, uint8_t len) {
+    txManager.queueEvent(id, data, len);
+}
+// Tilstand (posisjoner) hvor bare den nyeste verdien er interessant
+void sendState(int id, uint8_t* data, int len) {
+    txManager.queueState(id, data, len);
+}
+// Sender alt som ligger i køen, og sier fra til metningskontrollen hvis kjernen var full
+void flushTxQueue() {
+    if (txManager.flush() > 0) congestionController->reportSendError();
+}
+void sendCanFdFullState() {
+    FullState state;
+    if (isGameOver) state.phase = PHASE_GAMEOVER;
+    else if (isPaused || teensyLost) state.phase = PHASE_PAUSED;
+    else state.phase = PHASE_PLAYING;
+    state.scoreP1 = scoreP1;
+    state.scoreP2 = scoreP2;
+    state.tick = tickCounter;
+    fullStateHistory.fill(state);
+
+    struct canfd_frame frame;
+    packFullState(state, frame);
+    frame.can_id = idFullStateFd;
+    if (useBrs && fdPeerUsesBrs) frame.flags |= CANFD_BRS; // dataraten brukes bare hvis begge sider kan det
+    txManager.queueStateFd(frame);
+}
+
+// Oppdaterer metningskontrollen med køen i socketen og belastningen på bussen
+void updateCongestionInputs() {
+    int queuedBytes = 0;
+    if (ioctl(canSocketDescriptor, SIOCOUTQ, &queuedBytes) == 0) {
+        congestionController->reportQueueDepth(queuedBytes);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    double windowUs = std::chrono::duration<double, std::micro>(now - busLoadWindowStart).count();
+    if (windowUs >= 100000.0) {
+        congestionController->reportUtilization(busLoad->utilization(windowUs));
+        busLoad->reset();
+        busLoadWindowStart = now;
+    }
+}
+
+// Svarer på en mode request. FD velges bare hvis både vi og grensesnittet støtter det.
+void handleModeRequest(const uint8_t* data, uint8_t len) {
+    CanModeChoice request = {CAN_MODE_CLASSIC, 0};
+    if (!CanModeRequest::decode(data, len, request)) CanModeRequestLegacy::decode(data, len, request); // uten flagg
+    uint8_t wantedMode = request.mode;
+    uint8_t peerFlags = request.flags;
+
+    uint8_t chosenMode = CAN_MODE_CLASSIC;
+    uint8_t chosenFlags = 0;
+    if (wantedMode == CAN_MODE_FD && canFdAvailable) {
+        chosenMode = CAN_MODE_FD;
+        fdPeerActive = true;
+        fdPeerUsesBrs = (peerFlags & canModeFlagBrs) != 0;
+        if (useBrs && fdPeerUsesBrs) chosenFlags |= canModeFlagBrs;
+    } else {
+        classicPeerSeen = true;
+    }
+
+    uint8_t ackData[CanModeAck::length];
+    sendEvent(idModeAcknowledge, ackData, CanModeAck::encode({chosenMode, chosenFlags}, ackData));
+    statusMessage(chosenMode == CAN_MODE_FD ? "Node forhandlet CAN FD" : "Node forhandlet klassisk CAN");
+}
+
+// Svarer på klokke-ping. Tiden leses rett før svaret legges i køen, og køen tømmes
+// rett etter RX-løkka, så tiden mellom t2 og t3 blir liten nok til å se bort fra.
+void handleTimePing(const uint8_t* ping) {
+    uint64_t nowUs = microsSinceStart();
+    uint8_t pongData[8];
+    uint8_t len = ClockSync::makePong(ping, (uint32_t)(nowUs / ClockSync::tickUs),
+                                      (uint32_t)(nowUs % ClockSync::tickUs), pongData);
+    sendEvent(idTimePong, pongData, len);
+}
+
+// En Teensy som nettopp har startet vet ingenting. Den får alt i én ramme med en gang,
+// og ballen sendes på nytt i neste tick (banemodus trenger en ny bane).
+void handleSnapshotRequest() {
+    uint8_t phase = PHASE_PLAYING;
+    if (isGameOver) phase = PHASE_GAMEOVER;
+    else if (isPaused) phase = PHASE_PAUSED;
+    uint8_t snapshotData[CanSnapshotReply::length];
+    int len = CanSnapshotReply::encode({scoreP1, scoreP2, phase, platePosP1, platePosP2, xBall, yBall,
+                                        ballXVelocity, ballYVelocity}, snapshotData);
+    sendEvent(idSnapshot, snapshotData, len);
+    ballFrameForced = true;
+}
+
+// Det serveren kan. Banemodus tilbys bare når den er slått på med "--trajectory".
+HelloCapabilities serverCapabilities() {
+    HelloCapabilities own;
+    own.minVersion = 1;
+    own.maxVersion = Hello::protocolVersion;
+    own.layouts = LAYOUT_LEGACY | LAYOUT_PACKED;
+    own.features = FEATURE_RELIABLE_EVENTS | FEATURE_CLOCK_SYNC | FEATURE_INPUT_SEQ | FEATURE_SNAPSHOT | FEATURE_HEARTBEAT;
+    if (trajectoryRequested) own.features |= FEATURE_TRAJECTORY;
+    own.requiredFeatures = 0;
+    own.tickHz = 1000000 / taskSleepTimeUs;
+    own.bitrate10k = (uint8_t)std::min<uint32_t>(255, busBitrate / 10000);
+    return own;
+}
+
+// Svarer på hello med det beste begge kan, eller grunnen til at det ikke finnes noe felles
+void handleHello(const uint8_t* data, uint8_t len) {
+    HelloCapabilities peer;
+    if (!Hello::readHello(data, len, peer)) return;
+
+    HelloCapabilities own = serverCapabilities();
+    HelloAgreement agreement = Hello::negotiate(own, peer);
+    uint8_t replyData[Hello::frameLength];
+    uint8_t replyLen = Hello::makeReply(agreement, own.bitrate10k, replyData);
+    sendEvent(idHelloReply, replyData, replyLen);
+
+    if (agreement.result != HELLO_OK) {
+        statusMessage(std::string("Hello fra Teensy avvist: ") + Hello::reasonText(agreement.result) +
+                      " (Teensy v" + std::to_string(peer.minVersion) + "-" + std::to_string(peer.maxVersion) +
+                      ", server v" + std::to_string(own.minVersion) + "-" + std::to_string(own.maxVersion) + ")");
+        return;
+    }
+
+    useLegacyLayout = agreement.layout == LAYOUT_LEGACY;
+    teensyHeartbeat = agreement.has(FEATURE_HEARTBEAT);
+    if (teensyHeartbeat) {
+        teensyMonitor.heard(millisSinceStart());
+    } else if (teensyLost) {
+        teensyLost = false; // en klient uten heartbeat kan ikke falle ut
+        statusMessage("Teensyen sender ikke heartbeat, spillet pauses ikke når den er stille");
+    }
+    useTrajectoryMode = trajectoryRequested && agreement.has(FEATURE_TRAJECTORY);
+    if (trajectoryRequested && !useTrajectoryMode) {
+        // Teensyen kan ikke regne ut banen selv, vanlige ballrammer i stedet
+        statusMessage("Teensyen kan ikke banemodus, sender ballen som vanlig");
+    }
+    ballFrameForced = true;
+
+    // Hører vi hverandre er bitraten lik, så et annet tall betyr at en av oss er satt opp feil
+    if (peer.bitrate10k != own.bitrate10k) {
+        statusMessage("Teensyen er satt opp med " + std::to_string(peer.bitrate10k * 10) + " kbit/s, serveren med " +
+                      std::to_string(own.bitrate10k * 10) + " kbit/s (\"--bitrate=\")");
+    }
+    statusMessage("Hello: versjon " + std::to_string(agreement.version) +
+                  (useLegacyLayout ? ", gammelt" : ", pakket") + " rammeformat, " +
+                  std::to_string(agreement.tickHz) + " Hz");
+}
+
+// Sender ballen hvis farten er endret siden forrige ramme, eller det har gått lenge nok.
+// onlyChanges: bare ved endring (brukes når metningskontrollen sier at det ikke er tid for tilstand).
+void sendBallFrameIfDue(bool onlyChanges) {
+    ticksSinceBallFrame++;
+    int8_t vx = isPaused ? 0 : ballXVelocity;
+    int8_t vy = isPaused ? 0 : ballYVelocity;
+    bool changed = ballFrameForced || vx != lastSentBallXVelocity || vy != lastSentBallYVelocity;
+    int interval = useTrajectoryMode ? trajectoryRefreshTicks : 100 / ballRateHz;
+    bool periodic = ticksSinceBallFrame >= interval;
+    if (!changed && (onlyChanges || !periodic)) return;
+
+    // Med ticken rammen gjelder for, slik at Teensyen vet hvor gammel den er
+    uint16_t tick = clockTick16();
+    uint8_t ballData[CanBallPosition::length];
+    CanBallPosition::encode({xBall, yBall, tick, vx, vy}, ballData);
+    static_assert(CanBallTrajectory::length == CanBallPosition::length, "banen sendes med samme buffer");
+    if (useTrajectoryMode && changed) {
+        // Banen gjelder fra ticken i rammen, så en retransmisjon er like riktig som originalen
+        reliableEvents.send(idBallTrajectory, ballData, CanBallTrajectory::length, millisSinceStart());
+    } else {
+        // Det gamle formatet er de første bytene av det nye
+        sendState(idBallPosition, ballData, useLegacyLayout ? CanBallPositionLegacy::length : CanBallPosition::length);
+    }
+
+    ticksSinceBallFrame = 0;
+    lastSentBallXVelocity = vx;
+    lastSentBallYVelocity = vy;
+    ballFrameForced = false;
 }
 
 
 // Logikk
 
+// Joystick-ramme med sekvensnummer: Teensyen sender én ramme per tick den holder joysticken,
+// og hver ramme flytter platen nøyaktig én gang. Da kan Teensyen regne ut det samme selv.
+void applyP1Input(uint8_t moveState, uint8_t seq) {
+    lastP1InputSeq = seq;
+    if (isGameOver || isPaused || teensyLost) return; // platene står stille her, som i updatePhysics()
+    if (moveState == 1) platePosP1 = std::max(0, platePosP1 - plateSpeedP1);
+    if (moveState == 2) platePosP1 = std::min(SCREEN_HEIGHT - plateHeight, platePosP1 + plateSpeedP1);
+}
+
 void updatePhysics() {
-    if (isGameOver) return;
+    if (isGameOver || teensyLost) return;
 
     if (isPaused){
         if (std::chrono::steady_clock::now() >= pauseEndTime) {
@@ -201,15 +565,18 @@ void updatePhysics() {
     else if (xBall < 0)       { scoreP1++; scored = true; }
 
     if (scored) {
-        uint8_t scoreData[2] = {(uint8_t)scoreP1, (uint8_t)scoreP2};
-        sendCanMessage(canSocketDescriptor, idScore, scoreData, 2);
-        std::cout << "\rScore: " << scoreP1 << " - " << scoreP2 << std::flush;
+        uint8_t scoreData[CanScore::length];
+        reliableEvents.send(idScore, scoreData, CanScore::encode({scoreP1, scoreP2}, scoreData), millisSinceStart());
+        if (!terminalView.isActive()) {
+            std::cout << "\rScore: " << scoreP1 << " - " << scoreP2 << std::flush;
+        }
 
         if (scoreP1 >= WINNING_SCORE || scoreP2 >= WINNING_SCORE) {
             isGameOver = true;
         } else {
             isPaused = true;
             pauseEndTime = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            ballFrameForced = true;
             xBall = SCREEN_WIDTH / 2;
             yBall = SCREEN_HEIGHT / 2;
             ballXVelocity = (scoreP1 > scoreP2) ? -1 : 1;
@@ -219,7 +586,8 @@ void updatePhysics() {
 }
 
 void resetGame() {
-    std::cout << "\n--- RESET ---" << std::endl;
+    if (!terminalView.isActive()) std::cout << std::endl;
+    statusMessage("--- RESET ---");
     scoreP1 = 0;
     scoreP2 = 0;
     isGameOver = false;
@@ -230,6 +598,8 @@ void resetGame() {
     ballYVelocity = 1;
     platePosP1 = 22;
     platePosP2 = 22;
+    fullStateHistory.clear();
+    ballFrameForced = true;
 
     p2HoldCounter = 0;
     p2MoveState = 0;
@@ -237,8 +607,8 @@ void resetGame() {
 
     // Send beskjed til Teensy om at spillet er reset
     // Dette vekker Teensy fra "Game Over"-skjermen
-    uint8_t resetData[1] = {1};
-    sendCanMessage(canSocketDescriptor, idResetAcknowledge, resetData, 1);
+    uint8_t resetData[CanResetAck::length];
+    reliableEvents.send(idResetAcknowledge, resetData, CanResetAck::encode({1}, resetData), millisSinceStart());
 
 }
 
@@ -261,56 +631,282 @@ void handleKeyboardInput() {
     sPressed = false;
 }
 
+// Mottak: én rute per ID (felles/candispatch.h). Svar som skal ut med en gang (pong,
+// tilstand, hello) setter answerPending, og køen tømmes rett etter RX-løkka.
+bool answerPending = false;
+
+// Alle rammer fra Teensyen teller som livstegn
+void heardTeensy() {
+    if (teensyHeartbeat) teensyMonitor.heard(millisSinceStart());
+    classicPeerSeen = true;
+}
+
+void onTeensyHeartbeat(void*, const uint8_t*, uint8_t) {
+    heardTeensy();
+}
+
+// Mottar input-kommando fra Teensy (ID 25)
+void onJoystick(void*, const uint8_t* data, uint8_t len) {
+    heardTeensy();
+    CanJoystick joystick;
+    if (CanJoystickP1::decode(data, len, joystick)) applyP1Input(joystick.moveState, joystick.seq);
+    else if (CanJoystickP1Legacy::decode(data, len, joystick)) p1MoveState = joystick.moveState; // gammel klient, gjelder denne ticken
+}
+
+// Klokke-ping fra Teensy, svares med en gang
+void onTimePing(void*, const uint8_t* data, uint8_t) {
+    heardTeensy();
+    handleTimePing(data);
+    answerPending = true;
+}
+
+// Teensyen har startet på nytt og vil ha hele tilstanden, svares med en gang
+void onSnapshotRequest(void*, const uint8_t*, uint8_t) {
+    heardTeensy();
+    handleSnapshotRequest();
+    answerPending = true;
+}
+
+// Teensyen har startet og vil bli enige om protokollen, svares med en gang
+void onHello(void*, const uint8_t* data, uint8_t len) {
+    heardTeensy();
+    handleHello(data, len);
+    answerPending = true;
+}
+
+// En Linux-node vil forhandle modus
+void onModeRequest(void*, const uint8_t* data, uint8_t len) {
+    handleModeRequest(data, len);
+}
+
+// Ack fra Teensy for score og reset
+void onEventAck(void*, const uint8_t* data, uint8_t len) {
+    heardTeensy();
+    reliableEvents.receiveAck(data, len);
+}
+
+// Reset-signal (duplikater blir acket, men bare behandlet én gang)
+void onResetRequest(void*, const uint8_t* data, uint8_t len) {
+    heardTeensy();
+    uint8_t payloadLen;
+    CanReset reset;
+    if (!reliableEvents.receive(idResetRequest, data, len, payloadLen)) return;
+    if (CanResetGame::decode(data, payloadLen, reset) && reset.request == 1) {
+        statusMessage("Received reset request from Teensy");
+        resetGame();
+    }
+}
+
+constexpr auto canRoutes = makeCanRoutes({
+    CanHeartbeatP1::route(CAN_BASE_OWN, onTeensyHeartbeat),
+    CanJoystickP1Legacy::route(CAN_BASE_OWN, onJoystick), // det gamle formatet er kortest
+    CanTimePing::route(CAN_BASE_OWN, onTimePing),
+    CanSnapshotRequest::route(CAN_BASE_OWN, onSnapshotRequest),
+    CanHello::route(CAN_BASE_OWN, onHello),
+    CanModeRequestLegacy::route(CAN_BASE_OWN, onModeRequest), // det gamle formatet er kortest
+    CanEventAckP2::route(CAN_BASE_OWN, onEventAck),
+    CanResetGame::route(CAN_BASE_OWN, onResetRequest),
+});
+CanDispatcher canDispatcher;
+
+void publishGameState() {
+    GameStateSnapshot state;
+    state.tick = tickCounter;
+    state.xBall = xBall;
+    state.yBall = yBall;
+    state.ballXVelocity = ballXVelocity;
+    state.ballYVelocity = ballYVelocity;
+    state.platePosP1 = platePosP1;
+    state.platePosP2 = platePosP2;
+    state.scoreP1 = scoreP1;
+    state.scoreP2 = scoreP2;
+    if (isGameOver) state.phase = PHASE_GAMEOVER;
+    else if (isPaused || teensyLost) state.phase = PHASE_PAUSED;
+    else state.phase = PHASE_PLAYING;
+    sharedGameState.publish(state);
+}
+
+void renderTerminalView() {
+    auto now = std::chrono::steady_clock::now();
+    if (now < nextRenderTime) return;
+    nextRenderTime = now + std::chrono::microseconds(1000000 / terminalViewFps);
+
+    terminalView.clear();
+    terminalView.fillRect(0, platePosP2, plateWidth, plateHeight);
+    terminalView.fillRect(SCREEN_WIDTH - plateWidth, platePosP1, plateWidth, plateHeight);
+    terminalView.fillCircle(xBall, yBall, ballRadius);
+
+    std::string status = "P2 (tastatur) " + std::to_string(scoreP2) + " - " +
+                         std::to_string(scoreP1) + " P1 (Teensy)";
+    if (isGameOver) status += "   GAME OVER, trykk R for nytt spill";
+    else if (teensyLost) status += "   venter på Teensy";
+    else if (isPaused) status += "   pause";
+    status += "   tilstand " + std::to_string((int)congestionController->rateHz()) + " Hz";
+    terminalView.setStatus(status);
+
+    terminalView.present();
+}
+
+void parseArguments(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--vis") {
+            useTerminalView = true;
+        } else if (arg == "--vis=braille") {
+            useTerminalView = true;
+            terminalViewMode = TerminalView::BRAILLE;
+        } else if (arg.rfind("--fps=", 0) == 0) {
+            terminalViewFps = std::max(1, std::min(60, atoi(arg.c_str() + 6)));
+        } else if (arg == "--canfd") {
+            useCanFd = true;
+        } else if (arg == "--brs") {
+            useCanFd = true;
+            useBrs = true;
+        } else if (arg.rfind("--if=", 0) == 0) {
+            ifname = argv[i] + 5;
+        } else if (arg == "--trajectory") {
+            trajectoryRequested = true;
+            useTrajectoryMode = true;
+        } else if (arg.rfind("--teensy-timeout=", 0) == 0) {
+            teensyMonitor.configure(100, std::max(200, atoi(arg.c_str() + 17)));
+        } else if (arg.rfind("--ballrate=", 0) == 0) {
+            ballRateHz = std::max(1, std::min(100, atoi(arg.c_str() + 11)));
+        } else if (arg.rfind("--bitrate=", 0) == 0) {
+            busBitrate = std::max(10000, atoi(arg.c_str() + 10));
+        } else if (arg.rfind("--minrate=", 0) == 0) {
+            congestionConfig.minRateHz = std::max(1.0, atof(arg.c_str() + 10));
+        } else if (arg.rfind("--maxrate=", 0) == 0) {
+            congestionConfig.maxRateHz = std::max(1.0, atof(arg.c_str() + 10));
+        } else {
+            std::cout << "Ukjent argument: " << arg << std::endl;
+        }
+    }
+}
+
 // Main
-int main() {
+int main(int argc, char* argv[]) {
+    parseArguments(argc, argv);
     if (!createCanSocket(canSocketDescriptor)) return 1;
+    if (useCanFd) {
+        canFdAvailable = enableCanFd(canSocketDescriptor, ifname);
+        if (!canFdAvailable) std::cout << ifname << " støtter ikke CAN FD (MTU 72), bruker klassisk CAN." << std::endl;
+    }
     setNonBlockingKeyboard(true);
+    signal(SIGINT, handleSigint);
+
+    congestionConfig.minRateHz = std::min(congestionConfig.minRateHz, congestionConfig.maxRateHz);
+    CongestionController controller(congestionConfig, 1000000.0 / taskSleepTimeUs);
+    BusLoadEstimator estimator(busBitrate, 0);
+    congestionController = &controller;
+    busLoad = &estimator;
+    busLoadWindowStart = std::chrono::steady_clock::now();
+
+    txManager.begin(canSocketDescriptor, onFrameSent);
+    txManager.addStateSlot(idPlatePositionP1);
+    txManager.addStateSlot(idPlatePositionP2);
+    txManager.addStateSlot(idBallPosition);
+    txManager.addStateSlot(idFullStateFd);
+
+    reliableEvents.addEventId(idScore);
+    reliableEvents.addEventId(idResetRequest);
+    reliableEvents.addEventId(idResetAcknowledge);
+    reliableEvents.addEventId(idBallTrajectory);
+    reliableEvents.begin((uint8_t)time(nullptr));
+    canDispatcher.setBases(groupNumber, groupNumber);
+    canDispatcher.setRoutes(canRoutes, nullptr);
+
+    if (!sharedGameState.open()) {
+        std::cout << "Fikk ikke opprettet shared memory, fortsetter uten." << std::endl;
+    }
 
     std::cout << "Master Server Started." << std::endl;
+    if (useTerminalView) terminalView.begin(terminalViewMode);
+
+    const std::chrono::microseconds tickDuration(taskSleepTimeUs);
+    auto startNow = std::chrono::steady_clock::now();
+    auto nextTickTime = serverStartTime + tickDuration * ((startNow - serverStartTime) / tickDuration);
+
+    while (keepRunning) {
+        // Sender det som ble liggende igjen fra forrige tick
+        flushTxQueue();
 
-    while (true) {
         // Leser input  fra CAN og tastatur
-        struct can_frame rxFrame;
+        // canfd_frame har samme layout som can_frame for de første feltene, så én buffer holder for begge
+        struct canfd_frame rxFrame;
+        answerPending = false;
         p1MoveState = 0;
-        while (recv(canSocketDescriptor, &rxFrame, sizeof(struct can_frame), MSG_DONTWAIT) > 0) {
-
-            // Mottar input-kommando fra Teensy (ID 25)
-            if (rxFrame.can_id == idJoystickP1) {
-                p1MoveState = rxFrame.data[0]; // 1=Opp, 2=Ned, 0=Stille
-            }
-
-            // Reset-signal
-            else if (rxFrame.can_id == idResetRequest && rxFrame.data[0] == 1) {
-                std::cout << "Received reset request from Teensy\n";
-                resetGame();
-                continue;
-            }
+        while (recv(canSocketDescriptor, &rxFrame, sizeof(struct canfd_frame), MSG_DONTWAIT) > 0) {
+
+            bool isFdFrame = rxFrame.len > CAN_MAX_DLEN;
+            busLoad->addFrame(busLoadFrameInfo(rxFrame, isFdFrame));
+
+            // FD-rammer er lengre enn noen rute og telles bare som avvist. RTR- og feilrammer har ingen data.
+            if (rxFrame.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) continue;
+            canDispatcher.dispatch(rxFrame.can_id & CAN_EFF_MASK, (rxFrame.can_id & CAN_EFF_FLAG) != 0, rxFrame.data, rxFrame.len);
+        }
+
+        if (answerPending) flushTxQueue(); // pong og tilstand skal ikke vente på fysikken
+
+        // Teensyen har falt ut eller kommet tilbake
+        PeerMonitor::Event teensyEvent = teensyHeartbeat ? teensyMonitor.update(millisSinceStart()) : PeerMonitor::PEER_NO_CHANGE;
+        if (teensyEvent == PeerMonitor::PEER_LOST) {
+            teensyLost = true;
+            statusMessage("Teensy svarer ikke, spillet står på pause");
+        } else if (teensyEvent == PeerMonitor::PEER_RETURNED) {
+            teensyLost = false;
+            ballFrameForced = true; // Teensyen kan ha mistet ballen
+            statusMessage("Teensy er tilbake");
         }
 
         handleKeyboardInput(); // P2 Input
+        reliableEvents.update(millisSinceStart()); // sender hendelser som ikke er acket på nytt
 
         // Bergn fysikken
         updatePhysics();
+        tickCounter++;
+        publishGameState();
+        fullStateHistory.push({(uint8_t)xBall, (uint8_t)yBall, (uint8_t)platePosP1, (uint8_t)platePosP2,
+                               (int8_t)ballXVelocity, (int8_t)ballYVelocity});
+
+        // Raten på tilstandsrammene styres av metningskontrollen, hendelser sendes alltid
+        updateCongestionInputs();
+        bool stateDue = congestionController->shouldSendState();
 
+        // FD-noder får hele tilstanden i én ramme
+        if (stateDue && fdPeerActive) sendCanFdFullState();
 
-        // Sender data til Teensy
-        if (!isGameOver) {
-            //Sender ball
-            uint8_t ballData[2] = {(uint8_t)xBall, (uint8_t)yBall};
-            sendCanMessage(canSocketDescriptor, idBallPosition, ballData, 2);
+        // Sender data til Teensy (klassiske rammer trengs så lenge en klassisk node kan lytte)
+        if (!stateDue && !isGameOver && (classicPeerSeen || !fdPeerActive)) {
+            sendBallFrameIfDue(true); // endringer i fart kan ikke vente på neste tilstandsramme
+        }
+        if (stateDue && !isGameOver && (classicPeerSeen || !fdPeerActive)) {
+            sendBallFrameIfDue(false);
 
             // Sender P1 Posisjon (Så Teensy vet hvor den selv er!)
-            uint8_t p1Data[1] = {(uint8_t)platePosP1};
-            sendCanMessage(canSocketDescriptor, idPlatePositionP1, p1Data, 1);
+            uint8_t p1Data[CanPlateAckP1::length];
+            CanPlateAckP1::encode({platePosP1, lastP1InputSeq}, p1Data);
+            sendState(idPlatePositionP1, p1Data, useLegacyLayout ? CanPlateP1::length : CanPlateAckP1::length);
 
             // Sender P2 Posisjon (Så Teensy ser motstander)
-            uint8_t p2Data[1] = {(uint8_t)platePosP2};
-            sendCanMessage(canSocketDescriptor, idPlatePositionP2, p2Data, 1);
+            uint8_t p2Data[CanPlateP2::length];
+            sendState(idPlatePositionP2, p2Data, CanPlateP2::encode({platePosP2, 0}, p2Data));
         }
+        flushTxQueue();
 
-        usleep(taskSleepTimeUs);
+        if (useTerminalView) renderTerminalView();
+
+        // Venter til neste tick på skjemaet. Hvis vi har ligget etter hopper vi over de
+        // tapte tickene i stedet for å kjøre dem raskt etter hverandre.
+        auto now = std::chrono::steady_clock::now();
+        nextTickTime += tickDuration;
+        if (nextTickTime < now) {
+            auto behind = std::chrono::duration_cast<std::chrono::microseconds>(now - serverStartTime);
+            nextTickTime = serverStartTime + tickDuration * (behind / tickDuration + 1);
+        }
+        std::this_thread::sleep_until(nextTickTime);
     }
 
+    terminalView.end();
     setNonBlockingKeyboard(false);
     close(canSocketDescriptor);
     return 0;
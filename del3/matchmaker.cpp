@@ -0,0 +1,196 @@
+/*
+ * Matchmaker for lobbyen i ../felles/lobby.h.
+ *
+ * Lytter etter noder som melder seg på bussen, parer to og to ledige noder (den som har
+ * ventet lengst først) og gir hver kamp en ledig ID-blokk. Ingen trenger å flashes på nytt
+ * for å spille mot en annen gruppe.
+ *
+ * En blokk er ledig igjen når ingen av nodene i kampen har meldt "i kamp" på --timeout ms.
+ * Noder som ikke har meldt seg på --timeout ms blir fjernet fra lobbyen.
+ *
+ * Bruk:
+ *   ./matchmaker --if=can0 --timeout=1000
+ *
+ * Kompilering:
+ *   g++ -std=c++17 -O2 -o matchmaker matchmaker.cpp
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <iostream>
+#include <string>
+#include <map>
+#include <chrono>
+#include <algorithm>
+
+#include "../felles/lobby.h"
+
+const char *ifname = "can0";
+uint32_t nodeTimeoutMs = 1000;
+
+struct LobbyNode {
+    uint32_t firstSeenMs;
+    uint32_t lastSeenMs;
+    bool inMatch;      // noden selv sier at den spiller
+    int block;         // indeks i blocks, -1 = ingen kamp
+    uint8_t role;
+};
+
+struct MatchBlock {
+    bool used;
+    uint32_t nodes[2];
+    uint32_t lastActiveMs;
+};
+
+std::map<uint32_t, LobbyNode> nodes;
+MatchBlock blocks[LobbyClient::maxBlocks];
+int socketDescriptor;
+auto startTime = std::chrono::steady_clock::now();
+
+uint32_t millisSinceStart() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+uint16_t blockBase(int block) {
+    return LobbyClient::firstBlock + block * LobbyClient::blockSpacing;
+}
+
+void sendAssign(uint32_t nodeId, const LobbyNode& node) {
+    struct can_frame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.can_id = LobbyClient::idAssign;
+    frame.can_dlc = LobbyClient::makeAssign(nodeId, blockBase(node.block), node.role, frame.data);
+    write(socketDescriptor, &frame, sizeof(frame));
+}
+
+void handleAnnounce(uint32_t nodeId, const uint8_t* data, uint8_t len, uint32_t nowMs) {
+    if (len < 4) return;
+    auto found = nodes.find(nodeId);
+    if (found == nodes.end()) {
+        nodes[nodeId] = {nowMs, nowMs, false, -1, 0};
+        found = nodes.find(nodeId);
+        std::cout << "Ny node " << std::hex << nodeId << std::dec << " i lobbyen" << std::endl;
+    }
+    LobbyNode& node = found->second;
+    node.lastSeenMs = nowMs;
+    node.inMatch = data[0] == LobbyClient::LOBBY_IN_MATCH;
+
+    if (node.block >= 0) {
+        if (node.inMatch) blocks[node.block].lastActiveMs = nowMs;
+        else sendAssign(nodeId, node); // har ikke fått tildelingen, eller venter på at kampen starter
+    }
+}
+
+int findFreeBlock() {
+    for (int i = 0; i < LobbyClient::maxBlocks; i++) {
+        if (!blocks[i].used) return i;
+    }
+    return -1;
+}
+
+void pairIdleNodes(uint32_t nowMs) {
+    while (true) {
+        // De to som har ventet lengst
+        uint32_t waiting[2];
+        int count = 0;
+        for (int pass = 0; pass < 2; pass++) {
+            uint32_t bestId = 0;
+            uint32_t bestSeen = UINT32_MAX;
+            for (auto& entry : nodes) {
+                if (entry.second.block >= 0 || entry.second.inMatch) continue; // spiller allerede (feks. uten lobby)
+                if (count == 1 && entry.first == waiting[0]) continue;
+                if (entry.second.firstSeenMs < bestSeen) {
+                    bestSeen = entry.second.firstSeenMs;
+                    bestId = entry.first;
+                }
+            }
+            if (bestSeen == UINT32_MAX) break;
+            waiting[count++] = bestId;
+        }
+        if (count < 2) return;
+
+        int block = findFreeBlock();
+        if (block < 0) return; // alle blokkene er i bruk, de venter
+        blocks[block] = {true, {waiting[0], waiting[1]}, nowMs};
+        for (int i = 0; i < 2; i++) {
+            LobbyNode& node = nodes[waiting[i]];
+            node.block = block;
+            node.role = i + 1;
+            sendAssign(waiting[i], node);
+        }
+        std::cout << "Kamp i blokk " << blockBase(block) << ": " << std::hex << waiting[0] << " (P1) mot "
+                  << waiting[1] << " (P2)" << std::dec << std::endl;
+    }
+}
+
+// Fjerner noder som er borte og frigjør blokker ingen spiller i lenger
+void expire(uint32_t nowMs) {
+    for (auto it = nodes.begin(); it != nodes.end();) {
+        if (nowMs - it->second.lastSeenMs > nodeTimeoutMs) {
+            std::cout << "Node " << std::hex << it->first << std::dec << " er borte" << std::endl;
+            it = nodes.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (int i = 0; i < LobbyClient::maxBlocks; i++) {
+        MatchBlock& block = blocks[i];
+        if (!block.used || nowMs - block.lastActiveMs <= nodeTimeoutMs) continue;
+        block.used = false;
+        for (uint32_t nodeId : block.nodes) {
+            auto found = nodes.find(nodeId);
+            if (found != nodes.end() && found->second.block == i) found->second.block = -1; // tilbake i lobbyen
+        }
+        std::cout << "Blokk " << blockBase(i) << " er ledig" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--if=", 0) == 0) ifname = argv[i] + 5;
+        else if (arg.rfind("--timeout=", 0) == 0) nodeTimeoutMs = std::max(200, atoi(arg.c_str() + 10));
+        else std::cout << "Ukjent argument: " << arg << std::endl;
+    }
+
+    struct sockaddr_can addr;
+    struct ifreq ifr;
+    if ((socketDescriptor = socket(PF_CAN, SOCK_RAW, CAN_RAW)) < 0) return 1;
+    strcpy(ifr.ifr_name, ifname);
+    if (ioctl(socketDescriptor, SIOCGIFINDEX, &ifr) < 0) {
+        std::cout << "Fant ikke " << ifname << std::endl;
+        return 1;
+    }
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(socketDescriptor, (struct sockaddr *)&addr, sizeof(addr)) < 0) return 1;
+
+    // Bare lobbymeldingene
+    struct can_filter filter;
+    filter.can_id = (LobbyClient::idAnnounceBase << 18) | CAN_EFF_FLAG;
+    filter.can_mask = (~LobbyClient::nodeIdMask & CAN_EFF_MASK) | CAN_EFF_FLAG;
+    setsockopt(socketDescriptor, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter));
+
+    std::cout << "Matchmaker på " << ifname << ", " << LobbyClient::maxBlocks << " blokker fra "
+              << LobbyClient::firstBlock << std::endl;
+
+    while (true) {
+        uint32_t nowMs = millisSinceStart();
+        struct can_frame rxFrame;
+        while (recv(socketDescriptor, &rxFrame, sizeof(rxFrame), MSG_DONTWAIT) > 0) {
+            uint32_t id = rxFrame.can_id & CAN_EFF_MASK;
+            if (!(rxFrame.can_id & CAN_EFF_FLAG) || !LobbyClient::isAnnounceId(id)) continue;
+            handleAnnounce(LobbyClient::nodeIdFromAnnounce(id), rxFrame.data, rxFrame.can_dlc, nowMs);
+        }
+        expire(nowMs);
+        pairIdleNodes(nowMs);
+        usleep(5000);
+    }
+    return 0;
+}
@@ -4,10 +4,13 @@
 #include <SPI.h>
 #include <FlexCAN_T4.h>
 #include "joystick.h"
+#include "../felles/reliableevents.h"
+#include "../felles/ballpredictor.h"
+#include "../felles/canmessages.h"
+#include "../felles/candispatch.h"
 
 
 /*
- - structen MessageID kan muligens være i en egen h-fil istedenfor i toppen her? 
  - det er generelt mange variabler som kan grupperes i struct. feks en hardwareconfig eller paddle som inneholder "height, width" osv. 
  - mangler fortsatt en reset-funksjon her. Den i chatgpt-koden fungerte ikke
 
@@ -26,15 +29,21 @@ constexpr uint8_t screenHeight{64};
 
 bool gameStarted = false;
 
+// ID-ene og innholdet står i felles/canmessages.h
+constexpr uint32_t groupNumber{6};
+
 struct MessageID
 {
-  const uint32_t joystickData{25};
-  const uint32_t paddlePositionPlayer1{26};
-  const uint32_t paddlePositionPlayer2{27};
-  const uint32_t ballPosition{56};
-  const uint32_t score{57};    // mottar scorePlayer1 (buf0) og scorePlayer2 (buf1)
-  const uint32_t idResetRequest{58}; // 58 (Teensy → RPi Teensyen som ber RPi om å resette)
-  const uint32_t idResetAcknowledge{59};// 59 (RPi → Teensy RPi som sender en melding til teensyen om at spillet faktisk blir resatt)
+  const uint32_t joystickData{CanJoystickP1::id(groupNumber)};          // 25
+  const uint32_t paddlePositionPlayer1{CanPlateP1::id(groupNumber)};    // 26
+  const uint32_t paddlePositionPlayer2{CanPlateP2::id(groupNumber)};    // 27
+  const uint32_t ballTrajectory{CanBallTrajectory::id(groupNumber)};    // 55, bare når serveren kjører "--trajectory"
+  const uint32_t ballPosition{CanBallPosition::id(groupNumber)};        // 56
+  const uint32_t score{CanScore::id(groupNumber)};                      // 57
+  const uint32_t idResetRequest{CanResetGame::id(groupNumber)};         // 58 (Teensy → RPi Teensyen som ber RPi om å resette)
+  const uint32_t idResetAcknowledge{CanResetAck::id(groupNumber)};      // 59 (RPi → Teensy RPi som sender en melding til teensyen om at spillet faktisk blir resatt)
+  const uint32_t eventAckServer{CanEventAckP1::id(groupNumber)};        // 63 (RPi acker hendelser vi sender)
+  const uint32_t eventAckClient{CanEventAckP2::id(groupNumber)};        // 64 (vi acker score og reset fra RPi)
 
 };
 
@@ -51,6 +60,11 @@ uint8_t ballXCoordinate;
 uint8_t ballYCoordinate;
 constexpr uint8_t ballRadius{3};
 
+// Ballen flyttes hver runde ut fra farten i siste ramme (se felles/ballpredictor.h).
+// Vi har ikke klokkesynk her, så tiden regnes som lokale ticks (millis() / 10) fra rammen kom.
+BallPredictor ballPredictor;
+int64_t localTick() { return millis() / 10; }
+
 uint8_t scorePlayer1;
 uint8_t scorePlayer2;
 uint8_t winningScore{5};
@@ -59,12 +73,36 @@ Adafruit_SSD1306 display(screenWidth, screenHeight, &SPI, oledDC, oledReset, ole
 FlexCAN_T4 < CAN0, RX_SIZE_256, TX_SIZE_16 > can0;
 Joystick joystick(joyUp, joyDown, joyClick); 
 
+// score og reset ack kommer med sekvensnummer, og må ackes (se felles/reliableevents.h)
+void sendReliableFrame(uint32_t id, const uint8_t* data, uint8_t len);
+ReliableEvents reliableEvents(sendReliableFrame, messageID.eventAckClient);
+
 void updateScore();
 void gameOver();
 void sendJoystickData();
 void readCANInbox(MessageID& messageID);
 void resetDisplay();
 
+// Mottak: én rute per ID (felles/candispatch.h)
+void onPaddlePlayer1(void*, const uint8_t* data, uint8_t len);
+void onPaddlePlayer2(void*, const uint8_t* data, uint8_t len);
+void onBallPosition(void*, const uint8_t* data, uint8_t len);
+void onBallTrajectory(void*, const uint8_t* data, uint8_t len);
+void onEventAck(void*, const uint8_t* data, uint8_t len);
+void onScore(void*, const uint8_t* data, uint8_t len);
+void onResetAcknowledge(void*, const uint8_t* data, uint8_t len);
+
+constexpr auto canRoutes = makeCanRoutes({
+  CanPlateP1::route(CAN_BASE_OWN, onPaddlePlayer1),
+  CanPlateP2::route(CAN_BASE_OWN, onPaddlePlayer2),
+  CanBallPositionLegacy::route(CAN_BASE_OWN, onBallPosition),
+  CanBallTrajectory::route(CAN_BASE_OWN, onBallTrajectory),
+  CanEventAckP1::route(CAN_BASE_OWN, onEventAck),
+  CanScore::route(CAN_BASE_OWN, onScore),
+  CanResetAck::route(CAN_BASE_OWN, onResetAcknowledge),
+});
+CanDispatcher canDispatcher;
+
 
 
 unsigned long lastSendTime{0};          // lagrer tiden (ms) siden siste sendte melding
@@ -76,6 +114,12 @@ void setup()
   delay(200);
   can0.begin();
   can0.setBaudRate(250000);
+  reliableEvents.addEventId(messageID.score);
+  reliableEvents.addEventId(messageID.idResetAcknowledge);
+  reliableEvents.addEventId(messageID.ballTrajectory);
+  reliableEvents.begin(micros());
+  canDispatcher.setBases(groupNumber, groupNumber);
+  canDispatcher.setRoutes(canRoutes, nullptr);
 
   if (!display.begin(SSD1306_SWITCHCAPVCC)) 
   {
@@ -117,6 +161,11 @@ void loop()
   sendJoystickData(); 
   readCANInbox();
   
+  int predictedX, predictedY;
+  ballPredictor.position(localTick(), predictedX, predictedY);
+  ballXCoordinate = predictedX;
+  ballYCoordinate = predictedY;
+
   display.clearDisplay(); 
   display.fillRect(paddleXPosition, paddleYPosition, paddleWidth, paddleHeight, SSD1306_WHITE); // player1 teensy 
   display.fillRect(0, paddleYPositionOpponent, paddleWidth, paddleHeight, SSD1306_WHITE);       // player2 raspberry
@@ -139,6 +188,7 @@ void initGameState() {
   paddleYPositionOpponent = (screenHeight - paddleHeight) / 2;
   ballXCoordinate = screenWidth / 2;
   ballYCoordinate = screenHeight / 2;
+  ballPredictor = BallPredictor();
 }
 
 
@@ -148,19 +198,17 @@ void sendJoystickData()
 {
   if (!gameStarted) return; // don't send anything before first input
 
-  CAN_message_t joystickData;
-  joystickData.id = messageID.joystickData;
-  joystickData.len = 1;
+  CAN_message_t joystickData; // gammelt format, bare [tilstand]
 
   if ( joystick.joyUp() && millis() - lastSendTime > sendInterval )
   {
-    joystickData.buf[0] = 1;
+    CanJoystickP1Legacy::encode({1, 0}, groupNumber, joystickData);
     can0.write(joystickData);
     lastSendTime = millis();
   }
   if ( joystick.joyDown() && millis() - lastSendTime > sendInterval )
   {
-    joystickData.buf[0] = 2;
+    CanJoystickP1Legacy::encode({2, 0}, groupNumber, joystickData);
     can0.write(joystickData);
     lastSendTime = millis();
   }
@@ -168,35 +216,83 @@ void sendJoystickData()
 
 
 
+void sendReliableFrame(uint32_t id, const uint8_t* data, uint8_t len)
+{
+  CAN_message_t msg;
+  msg.id = id;
+  msg.len = len;
+  memcpy(msg.buf, data, len);
+  can0.write(msg);
+}
+
+
 void readCANInbox()
 {
   CAN_message_t receivedMessage; 
-  can0.read(receivedMessage); 
-  if ( receivedMessage.id == messageID.paddlePositionPlayer1 )
+  // Leser ALLE meldinger i køen hver gang, ellers blir gamle posisjoner tegnet én og én etter hverandre
+  while ( can0.read(receivedMessage) )
   {
-    paddleYPosition = receivedMessage.buf[0];
+    canDispatcher.dispatch(receivedMessage.id, receivedMessage.flags.extended, receivedMessage.buf, receivedMessage.len);
   }
+}
 
-  if ( receivedMessage.id == messageID.paddlePositionPlayer2 ) // for player2 (raspberry)
-  {
-    paddleYPositionOpponent = receivedMessage.buf[0]; 
-  }
-  
-  if ( receivedMessage.id == messageID.ballPosition )
-  {
-    ballXCoordinate = receivedMessage.buf[0];
-    ballYCoordinate = receivedMessage.buf[1];
-  }
+void onPaddlePlayer1(void*, const uint8_t* data, uint8_t len)
+{
+  CanPlate plate;
+  if ( !CanPlateP1::decode(data, len, plate) ) return;
+  paddleYPosition = plate.position;
+  ballPredictor.setPlates(paddleYPositionOpponent, paddleYPosition);
+}
 
-  if ( receivedMessage.id == messageID.score )
-  {
-    scorePlayer1 = receivedMessage.buf[0];
-    scorePlayer2 = receivedMessage.buf[1]; 
-  }
+void onPaddlePlayer2(void*, const uint8_t* data, uint8_t len) // for player2 (raspberry)
+{
+  CanPlate plate;
+  if ( !CanPlateP2::decode(data, len, plate) ) return;
+  paddleYPositionOpponent = plate.position;
+  ballPredictor.setPlates(paddleYPositionOpponent, paddleYPosition);
+}
 
-  if(receivedMessage.id == messageID.idResetAcknowledge){
-    resetDisplay();
-  }
+void onBallPosition(void*, const uint8_t* data, uint8_t len)
+{
+  CanBall ball;
+  if ( !CanBallPositionLegacy::decode(data, len, ball) ) return;
+  if ( !CanBallPosition::decode(data, len, ball) ) ball.vx = ball.vy = 0; // gammelt format uten fart
+  BallState state = {(int16_t)ball.x, (int16_t)ball.y, (int8_t)ball.vx, (int8_t)ball.vy};
+  ballPredictor.onServerFrame(state, localTick());
+}
+
+// Ballbane (kommer bare ved sprett/scoring/reset). Uten klokkesynk regnes den fra når den kom.
+void onBallTrajectory(void*, const uint8_t* data, uint8_t len)
+{
+  uint8_t payloadLen;
+  CanBall ball;
+  if ( !reliableEvents.receive(messageID.ballTrajectory, data, len, payloadLen) ) return;
+  if ( !CanBallTrajectory::decode(data, payloadLen, ball) ) return;
+  BallState state = {(int16_t)ball.x, (int16_t)ball.y, (int8_t)ball.vx, (int8_t)ball.vy};
+  ballPredictor.setMaxExtrapolationTicks(BallPredictor::trajectoryMaxExtrapolationTicks);
+  ballPredictor.onServerFrame(state, localTick());
+}
+
+void onEventAck(void*, const uint8_t* data, uint8_t len)
+{
+  reliableEvents.receiveAck(data, len);
+}
+
+// duplikater (retransmisjoner vi allerede har fått) blir acket, men ikke brukt på nytt
+void onScore(void*, const uint8_t* data, uint8_t len)
+{
+  uint8_t payloadLen;
+  CanPoints score;
+  if ( !reliableEvents.receive(messageID.score, data, len, payloadLen) ) return;
+  if ( !CanScore::decode(data, payloadLen, score) ) return;
+  scorePlayer1 = score.scoreP1;
+  scorePlayer2 = score.scoreP2;
+}
+
+void onResetAcknowledge(void*, const uint8_t* data, uint8_t len)
+{
+  uint8_t payloadLen;
+  if ( reliableEvents.receive(messageID.idResetAcknowledge, data, len, payloadLen) ) resetDisplay();
 }
 
 
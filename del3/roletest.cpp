@@ -0,0 +1,150 @@
+/*
+ * Tester rollefordelingen i ../felles/rolearbiter.h med to simulerte noder på et CAN-grensesnitt
+ * (vcan). Hver node har sin egen socket, så de ser hverandres rammer som på en ekte buss.
+ *
+ * Hver runde starter begge med ny nonce og claimer med inntil --spread ms mellomrom
+ * (0 = samme tick, det verste tilfellet). Runden er OK når begge har en rolle og rollene er ulike.
+ * Skriver antall split-brain og tiden det tok å bli enige.
+ *
+ * Bruk:
+ *   sudo ip link add dev vcan0 type vcan && sudo ip link set up vcan0
+ *   ./roletest --if=vcan0 --rounds=200 --spread=0
+ *
+ * Kompilering:
+ *   g++ -std=c++17 -O2 -o roletest roletest.cpp
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+#include "../felles/rolearbiter.h"
+#include "../felles/canmessages.h"
+
+const char *ifname = "vcan0";
+const int groupNumber = 6;
+const uint32_t idRoleClaim = CanRoleClaim::id(groupNumber); // 16, samme som Lars/EndeligPingPong.cpp
+
+int rounds = 100;
+int spreadMs = 0;
+const uint32_t roundTimeoutMs = 1000;
+
+struct SimNode {
+    int socketDescriptor;
+    RoleArbiter arbiter{idRoleClaim << 18, 100, 3};
+    uint32_t claimAtMs;
+    uint32_t decidedAtMs;
+};
+
+bool openSocket(int& socketDescriptor) {
+    struct sockaddr_can addr;
+    struct ifreq ifr;
+    if ((socketDescriptor = socket(PF_CAN, SOCK_RAW, CAN_RAW)) < 0) return false;
+    strcpy(ifr.ifr_name, ifname);
+    if (ioctl(socketDescriptor, SIOCGIFINDEX, &ifr) < 0) return false;
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(socketDescriptor, (struct sockaddr *)&addr, sizeof(addr)) < 0) return false;
+
+    // Bare rollerammene (utvidet ID med basen i de øverste bitene)
+    struct can_filter filter;
+    filter.can_id = (idRoleClaim << 18) | CAN_EFF_FLAG;
+    filter.can_mask = (~RoleArbiter::nonceMask & CAN_EFF_MASK) | CAN_EFF_FLAG;
+    setsockopt(socketDescriptor, SOL_CAN_RAW, CAN_RAW_FILTER, &filter, sizeof(filter));
+    return true;
+}
+
+// Én runde i loopen til en node, som handleRoleAssignment()/receiveCANMessages() på Teensyen
+void stepNode(SimNode& node, uint32_t nowMs) {
+    struct can_frame rxFrame;
+    while (recv(node.socketDescriptor, &rxFrame, sizeof(rxFrame), MSG_DONTWAIT) > 0) {
+        if (!(rxFrame.can_id & CAN_EFF_FLAG)) continue;
+        node.arbiter.receive(rxFrame.can_id & CAN_EFF_MASK, rxFrame.data, rxFrame.can_dlc);
+    }
+
+    node.arbiter.addEntropy((uint32_t)std::chrono::steady_clock::now().time_since_epoch().count());
+    if (nowMs >= node.claimAtMs) node.arbiter.claim(nowMs);
+
+    struct can_frame txFrame;
+    memset(&txFrame, 0, sizeof(txFrame));
+    uint32_t id;
+    uint8_t len;
+    if (node.arbiter.pollFrame(nowMs, id, txFrame.data, len)) {
+        txFrame.can_id = id | CAN_EFF_FLAG;
+        txFrame.can_dlc = len;
+        write(node.socketDescriptor, &txFrame, sizeof(txFrame));
+    }
+
+    if (node.arbiter.isDecided() && node.decidedAtMs == UINT32_MAX) node.decidedAtMs = nowMs;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--if=", 0) == 0) ifname = argv[i] + 5;
+        else if (arg.rfind("--rounds=", 0) == 0) rounds = std::max(1, atoi(arg.c_str() + 9));
+        else if (arg.rfind("--spread=", 0) == 0) spreadMs = std::max(0, atoi(arg.c_str() + 9));
+        else std::cout << "Ukjent argument: " << arg << std::endl;
+    }
+
+    SimNode nodes[2];
+    for (SimNode& node : nodes) {
+        if (!openSocket(node.socketDescriptor)) {
+            std::cout << "Fikk ikke åpnet " << ifname << std::endl;
+            return 1;
+        }
+    }
+
+    std::mt19937 random(std::random_device{}());
+    int splitBrain = 0;
+    int undecided = 0;
+    uint32_t maxDecideMs = 0;
+    uint64_t sumDecideMs = 0;
+
+    for (int round = 0; round < rounds; round++) {
+        for (SimNode& node : nodes) {
+            node.arbiter.begin(random());
+            node.claimAtMs = spreadMs > 0 ? random() % (spreadMs + 1) : 0;
+            node.decidedAtMs = UINT32_MAX;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        uint32_t nowMs = 0;
+        while (nowMs < roundTimeoutMs) {
+            // Rekkefølgen byttes hver runde, så ingen node alltid sender først
+            stepNode(nodes[round % 2], nowMs);
+            stepNode(nodes[(round + 1) % 2], nowMs);
+            if (nodes[0].arbiter.isDecided() && nodes[1].arbiter.isDecided() && nowMs > roundTimeoutMs / 2) break;
+            usleep(1000);
+            nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        RoleArbiter::Role roleA = nodes[0].arbiter.role();
+        RoleArbiter::Role roleB = nodes[1].arbiter.role();
+        if (roleA == RoleArbiter::ROLE_NONE || roleB == RoleArbiter::ROLE_NONE) undecided++;
+        else if (roleA == roleB) splitBrain++;
+
+        uint32_t firstClaim = std::min(nodes[0].claimAtMs, nodes[1].claimAtMs);
+        uint32_t decided = std::max(nodes[0].decidedAtMs, nodes[1].decidedAtMs);
+        if (decided != UINT32_MAX) {
+            maxDecideMs = std::max(maxDecideMs, decided - firstClaim);
+            sumDecideMs += decided - firstClaim;
+        }
+    }
+
+    std::cout << "Runder: " << rounds << ", spredning " << spreadMs << " ms" << std::endl;
+    std::cout << "Split-brain: " << splitBrain << ", uten rolle: " << undecided << std::endl;
+    std::cout << "Tid til enige: snitt " << (double)sumDecideMs / rounds << " ms, maks " << maxDecideMs << " ms" << std::endl;
+
+    for (SimNode& node : nodes) close(node.socketDescriptor);
+    return splitBrain == 0 && undecided == 0 ? 0 : 1;
+}
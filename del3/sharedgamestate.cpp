@@ -0,0 +1,127 @@
+#include "sharedgamestate.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+SharedGameStatePublisher::SharedGameStatePublisher()
+  : shared_{nullptr}
+{}
+
+SharedGameStatePublisher::~SharedGameStatePublisher()
+{
+  if (shared_ != nullptr)
+  {
+    munmap(shared_, sizeof(SharedGameStateLayout));
+    shm_unlink(sharedGameStateName);
+  }
+}
+
+
+bool SharedGameStatePublisher::open()
+{
+  int fd = shm_open(sharedGameStateName, O_CREAT | O_RDWR, 0644);
+  if (fd < 0) return false;
+
+  if (ftruncate(fd, sizeof(SharedGameStateLayout)) < 0)
+  {
+    close(fd);
+    return false;
+  }
+
+  void* mem = mmap(nullptr, sizeof(SharedGameStateLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // mappingen lever videre uten fd
+  if (mem == MAP_FAILED) return false;
+
+  shared_ = static_cast<SharedGameStateLayout*>(mem);
+  shared_->sequence.store(0, std::memory_order_relaxed);
+  return true;
+}
+
+
+void SharedGameStatePublisher::publish(const GameStateSnapshot& state)
+{
+  if (shared_ == nullptr) return;
+
+  // Oddetall = skriving pågår
+  uint32_t seq = shared_->sequence.load(std::memory_order_relaxed);
+  shared_->sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  shared_->tick.store(state.tick, std::memory_order_relaxed);
+  shared_->xBall.store(state.xBall, std::memory_order_relaxed);
+  shared_->yBall.store(state.yBall, std::memory_order_relaxed);
+  shared_->ballXVelocity.store(state.ballXVelocity, std::memory_order_relaxed);
+  shared_->ballYVelocity.store(state.ballYVelocity, std::memory_order_relaxed);
+  shared_->platePosP1.store(state.platePosP1, std::memory_order_relaxed);
+  shared_->platePosP2.store(state.platePosP2, std::memory_order_relaxed);
+  shared_->scoreP1.store(state.scoreP1, std::memory_order_relaxed);
+  shared_->scoreP2.store(state.scoreP2, std::memory_order_relaxed);
+  shared_->phase.store(state.phase, std::memory_order_relaxed);
+
+  // Partall = ferdig skrevet
+  shared_->sequence.store(seq + 2, std::memory_order_release);
+}
+
+
+
+SharedGameStateReader::SharedGameStateReader()
+  : shared_{nullptr}
+{}
+
+SharedGameStateReader::~SharedGameStateReader()
+{
+  if (shared_ != nullptr)
+  {
+    munmap(const_cast<SharedGameStateLayout*>(shared_), sizeof(SharedGameStateLayout));
+  }
+}
+
+
+bool SharedGameStateReader::open()
+{
+  int fd = shm_open(sharedGameStateName, O_RDONLY, 0);
+  if (fd < 0) return false; // serveren kjører ikke (enda)
+
+  void* mem = mmap(nullptr, sizeof(SharedGameStateLayout), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) return false;
+
+  shared_ = static_cast<const SharedGameStateLayout*>(mem);
+  return true;
+}
+
+
+bool SharedGameStateReader::trySnapshot(GameStateSnapshot& out) const
+{
+  if (shared_ == nullptr) return false;
+
+  uint32_t before = shared_->sequence.load(std::memory_order_acquire);
+  if (before & 1) return false; // skriveren er midt i en oppdatering
+
+  out.tick          = shared_->tick.load(std::memory_order_relaxed);
+  out.xBall         = shared_->xBall.load(std::memory_order_relaxed);
+  out.yBall         = shared_->yBall.load(std::memory_order_relaxed);
+  out.ballXVelocity = shared_->ballXVelocity.load(std::memory_order_relaxed);
+  out.ballYVelocity = shared_->ballYVelocity.load(std::memory_order_relaxed);
+  out.platePosP1    = shared_->platePosP1.load(std::memory_order_relaxed);
+  out.platePosP2    = shared_->platePosP2.load(std::memory_order_relaxed);
+  out.scoreP1       = shared_->scoreP1.load(std::memory_order_relaxed);
+  out.scoreP2       = shared_->scoreP2.load(std::memory_order_relaxed);
+  out.phase         = shared_->phase.load(std::memory_order_relaxed);
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  uint32_t after = shared_->sequence.load(std::memory_order_relaxed);
+  return before == after;
+}
+
+
+void SharedGameStateReader::snapshot(GameStateSnapshot& out) const
+{
+  if (shared_ == nullptr) return;
+
+  while (!trySnapshot(out))
+  {
+    // skriveren holder aldri låsen lenger enn noen få stores, så vi bare prøver igjen
+  }
+}
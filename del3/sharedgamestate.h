@@ -0,0 +1,91 @@
+#ifndef SHAREDGAMESTATE_H
+#define SHAREDGAMESTATE_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Spilltilstanden til serveren publisert i et POSIX shared memory-segment.
+ * Segmentet er beskyttet av en seqlock:
+ *  - Serveren (eneste skriver) gjør sekvensnummeret oddetall, skriver feltene
+ *    og gjør det partall igjen. Det koster bare noen få stores per tick.
+ *  - Lesere (viewere, dashboards, opptak) kopierer feltene og sjekker at
+ *    sekvensnummeret var likt og partall før og etter. Hvis ikke prøver de igjen.
+ * Leserne skriver aldri til segmentet, så antall lesere påvirker ikke spillet.
+ */
+
+const char* const sharedGameStateName = "/pong_gruppe6_state";
+
+enum GamePhase : int32_t
+{
+  PHASE_PLAYING  = 0,
+  PHASE_PAUSED   = 1, // pustepause etter poeng
+  PHASE_GAMEOVER = 2
+};
+
+// Vanlig kopi av tilstanden som leserne får ut
+struct GameStateSnapshot
+{
+  uint32_t tick;
+  int32_t  xBall;
+  int32_t  yBall;
+  int32_t  ballXVelocity;
+  int32_t  ballYVelocity;
+  int32_t  platePosP1;
+  int32_t  platePosP2;
+  int32_t  scoreP1;
+  int32_t  scoreP2;
+  int32_t  phase;
+};
+
+// Layouten i selve segmentet. Alle felt er lock-free atomics slik at
+// samtidig lesing og skriving er veldefinert også mellom prosesser.
+struct SharedGameStateLayout
+{
+  std::atomic<uint32_t> sequence;
+  std::atomic<uint32_t> tick;
+  std::atomic<int32_t>  xBall;
+  std::atomic<int32_t>  yBall;
+  std::atomic<int32_t>  ballXVelocity;
+  std::atomic<int32_t>  ballYVelocity;
+  std::atomic<int32_t>  platePosP1;
+  std::atomic<int32_t>  platePosP2;
+  std::atomic<int32_t>  scoreP1;
+  std::atomic<int32_t>  scoreP2;
+  std::atomic<int32_t>  phase;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock krever lock-free atomics");
+
+
+// Skrivesiden (brukes av serveren i del3/main.cpp)
+class SharedGameStatePublisher
+{
+  public:
+  SharedGameStatePublisher();
+  ~SharedGameStatePublisher();
+
+  bool open();
+  void publish(const GameStateSnapshot& state);
+
+  private:
+  SharedGameStateLayout* shared_;
+};
+
+
+// Lesesiden (brukes av eksterne prosesser)
+class SharedGameStateReader
+{
+  public:
+  SharedGameStateReader();
+  ~SharedGameStateReader();
+
+  bool open();
+  bool trySnapshot(GameStateSnapshot& out) const; // false hvis skriveren var midt i en oppdatering
+  void snapshot(GameStateSnapshot& out) const;    // prøver til den får en konsistent kopi
+
+  private:
+  const SharedGameStateLayout* shared_;
+};
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * Enkel leser av spilltilstanden som pong-serveren (main.cpp) publiserer i shared memory.
+ * Kan kjøres i så mange eksemplarer man vil samtidig som serveren, den påvirker ikke spillet.
+ *
+ * Kompilering:
+ *   g++ -std=c++17 -O2 -o stateviewer stateviewer.cpp sharedgamestate.cpp -lrt
+ */
+
+#include <iostream>
+#include <unistd.h>
+
+#include "sharedgamestate.h"
+
+const int sampleSleepTimeUs = 50000; // 20 Hz er nok for å følge med
+
+const char* phaseName(int32_t phase) {
+    if (phase == PHASE_PAUSED) return "pause";
+    if (phase == PHASE_GAMEOVER) return "game over";
+    return "spiller";
+}
+
+int main() {
+    SharedGameStateReader reader;
+    while (!reader.open()) {
+        std::cout << "\rVenter på pong-serveren..." << std::flush;
+        sleep(1);
+    }
+    std::cout << std::endl;
+
+    uint32_t lastTick = 0;
+    while (true) {
+        GameStateSnapshot state;
+        reader.snapshot(state);
+
+        if (state.tick != lastTick) {
+            std::cout << "\rTick " << state.tick
+                      << "  Ball (" << state.xBall << ", " << state.yBall << ")"
+                      << "  P1 " << state.platePosP1 << "  P2 " << state.platePosP2
+                      << "  Score " << state.scoreP1 << " - " << state.scoreP2
+                      << "  [" << phaseName(state.phase) << "]   " << std::flush;
+            lastTick = state.tick;
+        }
+        usleep(sampleSleepTimeUs);
+    }
+    return 0;
+}
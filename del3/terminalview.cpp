@@ -0,0 +1,212 @@
+#include "terminalview.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+TerminalView::TerminalView()
+  : mode_{HALF_BLOCKS}
+  , active_{false}
+  , forceRedraw_{true}
+  , cols_{maxCols}
+  , rows_{maxRows}
+  , pendingOffset_{0}
+  , stdoutFlags_{-1}
+{
+  clear();
+  memset(previousCells_, 0, sizeof(previousCells_));
+}
+
+TerminalView::~TerminalView()
+{
+  end();
+}
+
+
+void TerminalView::begin(Mode mode)
+{
+  mode_ = mode;
+  cols_ = (mode_ == BRAILLE) ? fieldWidth / 2 : fieldWidth;
+  rows_ = (mode_ == BRAILLE) ? fieldHeight / 4 : fieldHeight / 2;
+  active_ = true;
+  forceRedraw_ = true;
+  out_.reserve(64 * 1024);
+
+  // present() skal aldri blokkere spill-løkka, så stdout må være ikke-blokkerende.
+  // stdin er det bare når begge peker på samme terminal, så vi setter det selv.
+  if (stdoutFlags_ < 0) {
+    stdoutFlags_ = fcntl(STDOUT_FILENO, F_GETFL, 0);
+    if (stdoutFlags_ >= 0) fcntl(STDOUT_FILENO, F_SETFL, stdoutFlags_ | O_NONBLOCK);
+  }
+
+  // Alternativ skjerm, skjul cursor
+  const char enter[] = "\x1b[?1049h\x1b[?25l\x1b[2J";
+  out_.assign(enter);
+  pendingOffset_ = 0;
+  flushPending();
+}
+
+
+void TerminalView::end()
+{
+  if (!active_) return;
+  active_ = false;
+
+  // Gjenopprett flaggene og så vanlig skjerm og cursor, her venter vi til alt er skrevet
+  if (stdoutFlags_ >= 0) fcntl(STDOUT_FILENO, F_SETFL, stdoutFlags_);
+  stdoutFlags_ = -1;
+  out_.erase(0, pendingOffset_);
+  out_.append("\x1b[0m\x1b[?25h\x1b[?1049l");
+  size_t offset = 0;
+  while (offset < out_.size()) {
+    ssize_t n = write(STDOUT_FILENO, out_.data() + offset, out_.size() - offset);
+    if (n > 0) offset += n;
+    else if (n < 0 && errno != EAGAIN && errno != EINTR) break;
+  }
+  out_.clear();
+  pendingOffset_ = 0;
+}
+
+
+void TerminalView::clear()
+{
+  memset(pixels_, 0, sizeof(pixels_));
+}
+
+
+void TerminalView::setPixel(int x, int y)
+{
+  if (x < 0 || x >= fieldWidth || y < 0 || y >= fieldHeight) return;
+  pixels_[y][x] = 1;
+}
+
+
+void TerminalView::fillRect(int x, int y, int w, int h)
+{
+  for (int yy = y; yy < y + h; yy++) {
+    for (int xx = x; xx < x + w; xx++) {
+      setPixel(xx, yy);
+    }
+  }
+}
+
+
+void TerminalView::fillCircle(int x0, int y0, int r)
+{
+  // Samme form som Adafruit GFX tegner for små radier
+  for (int dy = -r; dy <= r; dy++) {
+    for (int dx = -r; dx <= r; dx++) {
+      if (dx * dx + dy * dy <= r * r + r) setPixel(x0 + dx, y0 + dy);
+    }
+  }
+}
+
+
+uint8_t TerminalView::cellCode(int col, int row) const
+{
+  if (mode_ == HALF_BLOCKS) {
+    uint8_t code = 0;
+    if (pixels_[row * 2][col])     code |= 0x01; // øvre halvdel
+    if (pixels_[row * 2 + 1][col]) code |= 0x02; // nedre halvdel
+    return code;
+  }
+
+  // Braille: 2x4 prikker, bitrekkefølgen er bestemt av Unicode
+  static const uint8_t dotBits[4][2] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+  uint8_t code = 0;
+  for (int dy = 0; dy < 4; dy++) {
+    for (int dx = 0; dx < 2; dx++) {
+      if (pixels_[row * 4 + dy][col * 2 + dx]) code |= dotBits[dy][dx];
+    }
+  }
+  return code;
+}
+
+
+void TerminalView::appendGlyph(uint8_t code)
+{
+  if (mode_ == HALF_BLOCKS) {
+    if (code == 0)      out_.push_back(' ');
+    else if (code == 1) out_.append("\xe2\x96\x80"); // ▀
+    else if (code == 2) out_.append("\xe2\x96\x84"); // ▄
+    else                out_.append("\xe2\x96\x88"); // █
+    return;
+  }
+
+  // U+2800 + code i UTF-8
+  out_.push_back((char)0xe2);
+  out_.push_back((char)(0xa0 | (code >> 6)));
+  out_.push_back((char)(0x80 | (code & 0x3f)));
+}
+
+
+void TerminalView::appendLine(int row, const std::string& text, std::string& previous)
+{
+  if (!forceRedraw_ && text == previous) return;
+
+  out_.append("\x1b[" + std::to_string(row) + ";1H\x1b[2K");
+  out_.append(text);
+  previous = text;
+}
+
+
+bool TerminalView::flushPending()
+{
+  while (pendingOffset_ < out_.size()) {
+    ssize_t n = write(STDOUT_FILENO, out_.data() + pendingOffset_, out_.size() - pendingOffset_);
+    if (n > 0) {
+      pendingOffset_ += n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && errno == EAGAIN) {
+      return false; // terminalen henger etter, resten sendes ved neste present()
+    } else {
+      break; // ukjent feil, vi gir opp dette bildet
+    }
+  }
+  out_.clear();
+  pendingOffset_ = 0;
+  return true;
+}
+
+
+size_t TerminalView::present()
+{
+  if (!active_) return 0;
+
+  // Hvis forrige bilde ikke er ferdig skrevet hopper vi over dette bildet
+  if (!flushPending()) return 0;
+
+  int cursorRow = -1;
+  int cursorCol = -1;
+
+  for (int row = 0; row < rows_; row++) {
+    for (int col = 0; col < cols_; col++) {
+      uint8_t code = cellCode(col, row);
+      if (!forceRedraw_ && code == previousCells_[row][col]) continue;
+
+      // Terminalen er 1-indeksert, og cursoren står allerede riktig hvis forrige tegn var rett til venstre
+      if (cursorRow != row + 1 || cursorCol != col + 1) {
+        out_.append("\x1b[" + std::to_string(row + 1) + ";" + std::to_string(col + 1) + "H");
+      }
+      appendGlyph(code);
+      previousCells_[row][col] = code;
+      cursorRow = row + 1;
+      cursorCol = col + 2;
+    }
+  }
+
+  if (forceRedraw_) {
+    // Bunnkanten av brettet tegnes bare én gang
+    out_.append("\x1b[" + std::to_string(rows_ + 1) + ";1H");
+    for (int col = 0; col < cols_; col++) out_.append("\xe2\x94\x80"); // ─
+  }
+  appendLine(rows_ + 2, status_, previousStatus_);
+  appendLine(rows_ + 3, message_, previousMessage_);
+  forceRedraw_ = false;
+
+  size_t bytes = out_.size();
+  flushPending();
+  return bytes;
+}
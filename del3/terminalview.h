@@ -0,0 +1,71 @@
+#ifndef TERMINALVIEW_H
+#define TERMINALVIEW_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Tegner spillbrettet (128x64) i terminalen til serveren.
+ * Forrige bilde huskes, og kun tegnene som har endret seg blir sendt
+ * (med cursor-flytt der det trengs). Alt for ett bilde samles i én write().
+ *
+ * To tegnemoduser:
+ *  - HALF_BLOCKS: ▀ ▄ █, 2 piksler per tegn -> 128x32 tegn (trenger bred terminal)
+ *  - BRAILLE:     2x4 piksler per tegn      -> 64x16 tegn
+ */
+
+class TerminalView
+{
+  public:
+  enum Mode { HALF_BLOCKS, BRAILLE };
+
+  static const int fieldWidth  = 128;
+  static const int fieldHeight = 64;
+
+  TerminalView();
+  ~TerminalView();
+
+  void begin(Mode mode);
+  void end();
+  bool isActive() const { return active_; }
+
+  // Tegning i pikselbufferet (kopi av det Teensy tegner)
+  void clear();
+  void fillRect(int x, int y, int w, int h);
+  void fillCircle(int x0, int y0, int r);
+  void setStatus(const std::string& status) { status_ = status; }
+  void setMessage(const std::string& message) { message_ = message; }
+
+  // Sammenligner med forrige bilde og skriver kun forskjellen. Returnerer antall bytes sendt.
+  size_t present();
+
+  private:
+  static const int maxCols = fieldWidth;    // halvblokk har flest kolonner
+  static const int maxRows = fieldHeight / 2;
+
+  void setPixel(int x, int y);
+  uint8_t cellCode(int col, int row) const;
+  void appendGlyph(uint8_t code);
+  void appendLine(int row, const std::string& text, std::string& previous);
+  bool flushPending();
+
+  Mode mode_;
+  bool active_;
+  bool forceRedraw_;
+  int cols_;
+  int rows_;
+
+  uint8_t pixels_[fieldHeight][fieldWidth];
+  uint8_t previousCells_[maxRows][maxCols];
+
+  std::string status_;
+  std::string message_;
+  std::string previousStatus_;
+  std::string previousMessage_;
+
+  std::string out_;        // bytes for bildet som bygges
+  size_t pendingOffset_;   // hvor langt vi kom hvis forrige write() ble avbrutt
+  int stdoutFlags_;        // flaggene stdout hadde før begin(), -1 når vi ikke har endret dem
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "txmanager.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+namespace
+{
+  // Kjernen runder opp til sitt minimum (noen få rammer), det er akkurat det vi vil
+  const int smallSendBufferBytes = 1;
+}
+
+TxManager::TxManager()
+  : socketDescriptor_{-1}
+  , onSent_{nullptr}
+  , stateSlotCount_{0}
+  , eventHead_{0}
+  , eventCount_{0}
+  , replacedStateFrames_{0}
+  , droppedEvents_{0}
+{}
+
+
+void TxManager::begin(int socketDescriptor, SentCallback onSent)
+{
+  socketDescriptor_ = socketDescriptor;
+  onSent_ = onSent;
+  setsockopt(socketDescriptor_, SOL_SOCKET, SO_SNDBUF, &smallSendBufferBytes, sizeof(smallSendBufferBytes));
+}
+
+
+bool TxManager::addStateSlot(uint32_t id)
+{
+  if (findSlot(id) != nullptr) return true;
+  if (stateSlotCount_ >= maxStateSlots) return false;
+
+  // Sett inn sortert slik at flush() sender i samme rekkefølge som arbitreringen ville gjort
+  int index = stateSlotCount_;
+  while (index > 0 && stateSlots_[index - 1].id > id)
+  {
+    stateSlots_[index] = stateSlots_[index - 1];
+    index--;
+  }
+  stateSlots_[index].id = id;
+  stateSlots_[index].pending = false;
+  stateSlots_[index].fd = false;
+  stateSlotCount_++;
+  return true;
+}
+
+
+TxManager::Slot* TxManager::findSlot(uint32_t id)
+{
+  for (int i = 0; i < stateSlotCount_; i++)
+  {
+    if (stateSlots_[i].id == id) return &stateSlots_[i];
+  }
+  return nullptr;
+}
+
+
+void TxManager::queueEvent(uint32_t id, const uint8_t* data, uint8_t len)
+{
+  if (eventCount_ >= maxEvents)
+  {
+    droppedEvents_++; // skal ikke skje, det sendes bare noen få hendelser per spill
+    return;
+  }
+
+  struct canfd_frame& frame = events_[(eventHead_ + eventCount_) % maxEvents];
+  memset(&frame, 0, sizeof(frame));
+  frame.can_id = id;
+  frame.len = len > CAN_MAX_DLEN ? CAN_MAX_DLEN : len;
+  memcpy(frame.data, data, frame.len);
+  eventCount_++;
+}
+
+
+void TxManager::queueState(uint32_t id, const uint8_t* data, uint8_t len)
+{
+  Slot* slot = findSlot(id);
+  if (slot == nullptr) return;
+
+  if (slot->pending) replacedStateFrames_++;
+  memset(&slot->frame, 0, sizeof(slot->frame));
+  slot->frame.can_id = id;
+  slot->frame.len = len > CAN_MAX_DLEN ? CAN_MAX_DLEN : len;
+  memcpy(slot->frame.data, data, slot->frame.len);
+  slot->fd = false;
+  slot->pending = true;
+}
+
+
+void TxManager::queueStateFd(const struct canfd_frame& frame)
+{
+  Slot* slot = findSlot(frame.can_id);
+  if (slot == nullptr) return;
+
+  if (slot->pending) replacedStateFrames_++;
+  slot->frame = frame;
+  slot->fd = true;
+  slot->pending = true;
+}
+
+
+bool TxManager::write(const struct canfd_frame& frame, bool fd, bool& full)
+{
+  size_t size = fd ? sizeof(struct canfd_frame) : sizeof(struct can_frame);
+  if (send(socketDescriptor_, &frame, size, MSG_DONTWAIT) < 0)
+  {
+    full = (errno == ENOBUFS || errno == EAGAIN);
+    return false;
+  }
+  if (onSent_) onSent_(frame, fd);
+  return true;
+}
+
+
+int TxManager::flush()
+{
+  if (socketDescriptor_ < 0) return 0;
+  int fullCount = 0;
+
+  // Hendelser først, i rekkefølge
+  while (eventCount_ > 0)
+  {
+    bool full = false;
+    if (!write(events_[eventHead_], false, full))
+    {
+      if (full) return fullCount + 1; // prøver igjen ved neste flush
+      // Andre feil (feks. bussen er nede): kast rammen så køen ikke låser seg
+    }
+    eventHead_ = (eventHead_ + 1) % maxEvents;
+    eventCount_--;
+  }
+
+  // Så nyeste tilstand per ID
+  for (int i = 0; i < stateSlotCount_; i++)
+  {
+    Slot& slot = stateSlots_[i];
+    if (!slot.pending) continue;
+
+    bool full = false;
+    if (!write(slot.frame, slot.fd, full) && full)
+    {
+      fullCount++;
+      break; // resten venter, og blir byttet ut hvis nyere verdier kommer før neste flush
+    }
+    slot.pending = false;
+  }
+  return fullCount;
+}
@@ -0,0 +1,71 @@
+#ifndef TXMANAGER_H
+#define TXMANAGER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <linux/can.h>
+
+/*
+ * Sendekø for serveren med to typer meldinger:
+ *  - Tilstand (ball, plater, FD full state): én plass per ID. Hvis en eldre verdi ikke
+ *    er sendt enda blir den byttet ut med den nyeste ("latest value wins"), slik at en
+ *    full buss aldri gir en haug med gamle posisjoner som kommer på rad.
+ *  - Hendelser (score 57, reset ack 59, mode ack 61 ...): vanlig FIFO, ingenting forsvinner.
+ *
+ * Rammene skrives med MSG_DONTWAIT. Socketens sendebuffer settes lite, slik at kjernen
+ * bare har noen få rammer av gangen og resten blir liggende her hvor de kan byttes ut.
+ */
+
+class TxManager
+{
+  public:
+  typedef void (*SentCallback)(const struct canfd_frame& frame, bool fd);
+
+  TxManager();
+
+  void begin(int socketDescriptor, SentCallback onSent);
+
+  // Registrerer en tilstands-ID (må gjøres før queueState brukes på ID-en)
+  bool addStateSlot(uint32_t id);
+
+  void queueEvent(uint32_t id, const uint8_t* data, uint8_t len);
+  void queueState(uint32_t id, const uint8_t* data, uint8_t len);
+  void queueStateFd(const struct canfd_frame& frame);
+
+  // Skriver så mye som kjernen tar imot. Returnerer antall ganger den var full (ENOBUFS/EAGAIN).
+  int flush();
+
+  int pendingEvents() const { return eventCount_; }
+  uint32_t replacedStateFrames() const { return replacedStateFrames_; }
+  uint32_t droppedEvents() const { return droppedEvents_; }
+
+  private:
+  static const int maxStateSlots = 8;
+  static const int maxEvents = 64;
+
+  struct Slot
+  {
+    uint32_t id;
+    bool pending;
+    bool fd;
+    struct canfd_frame frame;
+  };
+
+  Slot* findSlot(uint32_t id);
+  bool write(const struct canfd_frame& frame, bool fd, bool& full);
+
+  int socketDescriptor_;
+  SentCallback onSent_;
+
+  Slot stateSlots_[maxStateSlots]; // sortert på ID, lavest ID (høyest prioritet) først
+  int stateSlotCount_;
+
+  struct canfd_frame events_[maxEvents];
+  int eventHead_;
+  int eventCount_;
+
+  uint32_t replacedStateFrames_;
+  uint32_t droppedEvents_;
+};
+
+#endif
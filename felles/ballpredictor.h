@@ -0,0 +1,182 @@
+#ifndef BALLPREDICTOR_H
+#define BALLPREDICTOR_H
+
+#include <stdint.h>
+
+/*
+ * Dead reckoning av ballen på klientene (Teensy) mellom rammene fra serveren.
+ *
+ * Serveren sender ballen (ID 56) som [x, y, tick lav, tick høy, vx, vy], men bare ~25 ganger
+ * i sekundet og ved hver endring i fart. I banemodus ("--trajectory") kommer den samme
+ * rammen bare ved sprett, scoring og reset (ID 55), og klienten regner ut resten.
+ *
+ * Klienten kjører den samme ballfysikken som updatePhysics() i del3/main.cpp fra siste
+ * ramme og frem til nå, slik at ballen beveger seg hver tick selv om rammene kommer
+ * sjeldnere eller blir borte.
+ *
+ * Når en ny ramme kommer og gjetningen var litt feil, hopper ikke ballen: differansen
+ * legges på som en feil som krymper litt for hver tick. Store feil (feks. etter scoring)
+ * snappes med en gang.
+ *
+ * Tid regnes i serverens ticks (10 ms). Med felles/clocksync.h er det serverens ticker,
+ * uten kan klienten bruke sin egen teller (feks. millis() / 10) og se bort fra forsinkelsen.
+ */
+
+struct BallState
+{
+  int16_t x;
+  int16_t y;
+  int8_t vx; // piksler per tick
+  int8_t vy;
+};
+
+class BallPredictor
+{
+  public:
+  // Må være lik serveren
+  static const int screenWidth = 128;
+  static const int screenHeight = 64;
+  static const int ballRadius = 3;
+  static const int plateWidth = 4;
+  static const int plateHeight = 20;
+
+  static const int defaultMaxExtrapolationTicks = 50;     // lenger enn 0,5 s uten ramme: ballen står stille
+  static const int trajectoryMaxExtrapolationTicks = 300; // baner kommer sjelden, oppfriskning hvert 2. s
+  static const int snapDistance = 10;                     // piksler
+  static constexpr float errorDecayPerTick = 0.7f;
+
+  BallPredictor()
+    : hasBase_{false}
+    , maxExtrapolationTicks_{defaultMaxExtrapolationTicks}
+    , baseTick_{0}
+    , leftPlate_{22}
+    , rightPlate_{22}
+    , errorX_{0}
+    , errorY_{0}
+    , lastTick_{0}
+    , lastX_{screenWidth / 2}
+    , lastY_{screenHeight / 2}
+  {
+    base_ = {screenWidth / 2, screenHeight / 2, 0, 0};
+  }
+
+  // Platene brukes for å gjette sprett mellom rammene
+  void setPlates(int leftY, int rightY) { leftPlate_ = leftY; rightPlate_ = rightY; }
+
+  // Hvor lenge vi gjetter uten ny ramme. Må økes når serveren bare sender baner (ID 55).
+  void setMaxExtrapolationTicks(int ticks) { maxExtrapolationTicks_ = ticks; }
+
+  // En ramme fra serveren som gjaldt ved frameTick
+  void onServerFrame(const BallState& state, int64_t frameTick)
+  {
+    if (hasBase_ && frameTick < baseTick_) return; // eldre enn den vi har
+
+    int64_t previousTick = lastTick_;
+    base_ = state;
+    baseTick_ = frameTick;
+
+    if (!hasBase_)
+    {
+      hasBase_ = true;
+      lastTick_ = frameTick;
+      lastX_ = state.x;
+      lastY_ = state.y;
+      return;
+    }
+
+    // Det vi viste sist mot det vi nå mener var riktig ved samme tick
+    BallState corrected = extrapolate(previousTick);
+    errorX_ = lastX_ - corrected.x;
+    errorY_ = lastY_ - corrected.y;
+    if (errorX_ > snapDistance || errorX_ < -snapDistance || errorY_ > snapDistance || errorY_ < -snapDistance)
+    {
+      errorX_ = 0;
+      errorY_ = 0;
+    }
+  }
+
+  // Posisjonen som skal tegnes ved nowTick
+  void position(int64_t nowTick, int& x, int& y)
+  {
+    if (!hasBase_)
+    {
+      x = lastX_;
+      y = lastY_;
+      return;
+    }
+
+    for (int64_t tick = lastTick_; tick < nowTick; tick++)
+    {
+      errorX_ *= errorDecayPerTick;
+      errorY_ *= errorDecayPerTick;
+    }
+    if (nowTick > lastTick_) lastTick_ = nowTick;
+
+    BallState predicted = extrapolate(nowTick);
+    lastX_ = predicted.x + (int)(errorX_ + (errorX_ < 0 ? -0.5f : 0.5f));
+    lastY_ = predicted.y + (int)(errorY_ + (errorY_ < 0 ? -0.5f : 0.5f));
+    x = lastX_;
+    y = lastY_;
+  }
+
+  // Ballen fra siste ramme, flyttet frem til tick
+  BallState extrapolate(int64_t tick) const
+  {
+    BallState state = base_;
+    int64_t ticks = tick - baseTick_;
+    if (ticks > maxExtrapolationTicks_) ticks = maxExtrapolationTicks_;
+    for (int64_t i = 0; i < ticks; i++) step(state, leftPlate_, rightPlate_);
+    return state;
+  }
+
+  // Én tick av ballfysikken i updatePhysics(). Utenfor banen (scoring) blir ballen stående,
+  // serveren sender ny posisjon når den er lagt på midten igjen.
+  static void step(BallState& ball, int leftPlate, int rightPlate)
+  {
+    if (ball.x > screenWidth || ball.x < 0) return;
+
+    ball.x += ball.vx;
+    ball.y += ball.vy;
+
+    int rightX = screenWidth - plateWidth;
+    if (ball.x + ballRadius >= rightX && ball.y >= rightPlate && ball.y <= rightPlate + plateHeight && ball.vx > 0)
+    {
+      ball.vx = -ball.vx;
+      ball.x = rightX - ballRadius;
+    }
+
+    int leftX = plateWidth;
+    if (ball.x - ballRadius <= leftX && ball.y >= leftPlate && ball.y <= leftPlate + plateHeight && ball.vx < 0)
+    {
+      ball.vx = -ball.vx;
+      ball.x = leftX + ballRadius;
+    }
+
+    if (ball.y - ballRadius <= 0 && ball.vy < 0)
+    {
+      ball.vy = -ball.vy;
+      ball.y = ballRadius;
+    }
+    else if (ball.y + ballRadius >= screenHeight && ball.vy > 0)
+    {
+      ball.vy = -ball.vy;
+      ball.y = screenHeight - ballRadius;
+    }
+  }
+
+  private:
+  bool hasBase_;
+  int maxExtrapolationTicks_;
+  BallState base_;
+  int64_t baseTick_;
+  int leftPlate_;
+  int rightPlate_;
+
+  float errorX_;
+  float errorY_;
+  int64_t lastTick_;
+  int lastX_;
+  int lastY_;
+};
+
+#endif
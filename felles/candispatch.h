@@ -0,0 +1,211 @@
+#ifndef CANDISPATCH_H
+#define CANDISPATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Mottak via tabell: hver meldingstype har én rute (ID, tillatt lengde, funksjon), og
+ * rammen finner ruten sin med ett oppslag på ID-en i stedet for en if-kjede som blir lengre
+ * for hver meldingstype vi legger til.
+ *
+ * ID-ene i prosjektet regnes fra et gruppenummer som kan byttes mens vi kjører (lobbyen,
+ * felles/lobby.h), så en rute peker på en base og et offset:
+ *   CAN_BASE_OWN      egen gruppe (gruppe + 20 er vår plate)
+ *   CAN_BASE_PEER     motstanderens gruppe
+ *   CAN_BASE_ABSOLUTE offset er hele ID-en (f.eks. lobbyens 0x7F1)
+ *
+ * Rutene lages med makeCanRoutes() som constexpr, og feil i tabellen (samme ID to ganger,
+ * lengde over 8, min over maks, manglende funksjon) stopper byggingen. Teensyen bygger uten
+ * unntak, så feilen kommer av at en funksjon som ikke er constexpr blir kalt; kompilatoren
+ * peker på den med navnet som forklaring.
+ *
+ *   void onPaddle(void* context, const uint8_t* data, uint8_t len);
+ *   constexpr auto routes = makeCanRoutes({
+ *     {CAN_BASE_PEER, 20, 1, 8, onPaddle},
+ *   });
+ *   dispatcher.setRoutes(routes, &enemyPaddle);
+ *
+ * CanDispatcher slår opp i slot_, én byte per standard-ID (2 KB), som bygges på nytt bare
+ * når en base endres. Hver ramme koster da ett oppslag og én lengdesjekk uansett hvor mange
+ * ruter det er. Utvidede ID-er (rollefordeling, lobbyen) går til én egen funksjon.
+ */
+
+enum CanRouteBase : uint8_t
+{
+  CAN_BASE_OWN = 0,
+  CAN_BASE_PEER = 1,
+  CAN_BASE_ABSOLUTE = 2
+};
+
+typedef void (*CanHandler)(void* context, const uint8_t* data, uint8_t len);
+typedef void (*CanExtendedHandler)(void* context, uint32_t id, const uint8_t* data, uint8_t len);
+
+struct CanRoute
+{
+  uint8_t base;     // CanRouteBase
+  uint16_t offset;
+  uint8_t minLen;
+  uint8_t maxLen;
+  CanHandler handler;
+};
+
+template <size_t N>
+struct CanRouteList
+{
+  CanRoute routes[N];
+};
+
+// Ikke constexpr med vilje: kalles bare når tabellen er feil, og da stopper byggingen her
+inline void duplicateCanRoute() {}
+inline void invalidCanRouteLength() {}
+inline void invalidCanRouteBase() {}
+inline void missingCanRouteHandler() {}
+
+template <size_t N>
+constexpr CanRouteList<N> makeCanRoutes(const CanRoute (&routes)[N])
+{
+  CanRouteList<N> list{};
+  for (size_t i = 0; i < N; i++)
+  {
+    const CanRoute& route = routes[i];
+    if (route.base > CAN_BASE_ABSOLUTE) invalidCanRouteBase();
+    if (route.maxLen > 8 || route.minLen > route.maxLen) invalidCanRouteLength();
+    if (route.handler == nullptr) missingCanRouteHandler();
+    for (size_t j = 0; j < i; j++)
+    {
+      if (routes[j].base == route.base && routes[j].offset == route.offset) duplicateCanRoute();
+    }
+    list.routes[i] = route;
+  }
+  return list;
+}
+
+class CanDispatcher
+{
+  public:
+  static const uint16_t idCount = 0x800; // standard-ID-er, 11 bit
+  static const uint8_t maxRoutes = 255;  // 0 i slot_ betyr ingen rute
+
+  CanDispatcher()
+    : routes_{nullptr}
+    , routeCount_{0}
+    , context_{nullptr}
+    , extendedHandler_{nullptr}
+    , extendedContext_{nullptr}
+    , conflicts_{0}
+    , handled_{0}
+    , rejected_{0}
+    , unhandled_{0}
+  {
+    bases_[CAN_BASE_OWN] = 0;
+    bases_[CAN_BASE_PEER] = 0;
+    clearSlots();
+  }
+
+  // Tabellen må leve like lenge som dispatcheren (en constexpr-global i skissen)
+  template <size_t N>
+  void setRoutes(const CanRouteList<N>& list, void* context)
+  {
+    static_assert(N <= maxRoutes, "for mange CAN-ruter");
+    routes_ = list.routes;
+    routeCount_ = N;
+    context_ = context;
+    rebuild();
+  }
+
+  void setExtendedHandler(CanExtendedHandler handler, void* context)
+  {
+    extendedHandler_ = handler;
+    extendedContext_ = context;
+  }
+
+  // Bygger oppslaget på nytt, så det gjøres når gruppenumrene byttes og ikke per ramme
+  void setBases(uint16_t ownBase, uint16_t peerBase)
+  {
+    if (ownBase == bases_[CAN_BASE_OWN] && peerBase == bases_[CAN_BASE_PEER]) return;
+    bases_[CAN_BASE_OWN] = ownBase;
+    bases_[CAN_BASE_PEER] = peerBase;
+    rebuild();
+  }
+
+  // Returnerer true hvis rammen hadde en rute og riktig lengde
+  bool dispatch(uint32_t id, bool extended, const uint8_t* data, uint8_t len)
+  {
+    if (extended)
+    {
+      if (extendedHandler_ == nullptr)
+      {
+        unhandled_++;
+        return false;
+      }
+      extendedHandler_(extendedContext_, id, data, len);
+      handled_++;
+      return true;
+    }
+
+    uint8_t slot = id < idCount ? slot_[id] : 0;
+    if (slot == 0)
+    {
+      unhandled_++;
+      return false;
+    }
+    const CanRoute& route = routes_[slot - 1];
+    if (len < route.minLen || len > route.maxLen)
+    {
+      rejected_++;
+      return false;
+    }
+    route.handler(context_, data, len);
+    handled_++;
+    return true;
+  }
+
+  uint16_t routeId(const CanRoute& route) const
+  {
+    return route.base == CAN_BASE_ABSOLUTE ? route.offset : bases_[route.base] + route.offset;
+  }
+
+  // Ruter som fikk samme ID med de nåværende basene (første rute vinner)
+  uint8_t conflicts() const {return conflicts_;}
+  uint32_t handled() const {return handled_;}
+  uint32_t rejected() const {return rejected_;}   // kjent ID, feil lengde
+  uint32_t unhandled() const {return unhandled_;}
+
+  private:
+  void clearSlots()
+  {
+    for (uint16_t id = 0; id < idCount; id++) slot_[id] = 0;
+  }
+
+  void rebuild()
+  {
+    clearSlots();
+    conflicts_ = 0;
+    for (uint8_t i = 0; i < routeCount_; i++)
+    {
+      uint16_t id = routeId(routes_[i]);
+      if (id >= idCount) continue;
+      if (slot_[id] != 0)
+      {
+        conflicts_++;
+        continue;
+      }
+      slot_[id] = i + 1;
+    }
+  }
+
+  const CanRoute* routes_;
+  uint8_t routeCount_;
+  void* context_;
+  CanExtendedHandler extendedHandler_;
+  void* extendedContext_;
+  uint16_t bases_[2];
+  uint8_t conflicts_;
+  uint32_t handled_;
+  uint32_t rejected_;
+  uint32_t unhandled_;
+  uint8_t slot_[idCount];
+};
+
+#endif
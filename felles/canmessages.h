@@ -0,0 +1,326 @@
+#ifndef CANMESSAGES_H
+#define CANMESSAGES_H
+
+#include <stdint.h>
+#include "canschema.h"
+
+/*
+ * Alle CAN-meldingene i prosjektet, én gang. ID-en er offset fra gruppenummeret (gruppe 6 gir
+ * ID-ene i kommentarene), og feltene står med plass og bredde (se felles/canschema.h).
+ *
+ *   constexpr int idBallPosition = CanBallPosition::id(groupNumber);   // 56
+ *
+ *   uint8_t ballData[CanBallPosition::length];
+ *   CanBallPosition::encode({xBall, yBall, tick, vx, vy}, ballData);
+ *
+ *   CanBall ball;
+ *   if (CanBallPosition::decode(rxMsg, ball)) ...
+ *
+ * Noen ID-er har en kortere, eldre utgave (LAYOUT_LEGACY i felles/hello.h) med de samme
+ * første feltene. Begge står her, så mottakeren velger på lengden.
+ *
+ * Headerne som eier en protokoll (klokkesynk, hello, acker, rollback) pakker rammene sine med
+ * meldingene her. Bare rammer uten fast format står som CanMessage uten felt: rollefordelingen
+ * (innholdet ligger i den utvidede ID-en), CAN FD-tilstanden (over 8 byte) og ISO-TP.
+ * Hendelser (felles/reliableevents.h) får seq lagt til etter feltene, så lengden her er uten seq.
+ */
+
+// ---------- Verdiene ----------
+
+struct CanJoystick
+{
+  int moveState;  // 0 stille, 1 opp, 2 ned
+  uint8_t seq;    // input-seq, serveren svarer med siste brukte i CanPlateAckP1
+};
+
+struct CanPlate
+{
+  int position;   // øverste piksel
+  uint8_t seq;    // bare i CanPlateAckP1
+};
+
+struct CanBall
+{
+  int x;
+  int y;
+  uint16_t tick;  // serverens tick rammen gjelder for (felles/clocksync.h)
+  int vx;
+  int vy;
+};
+
+struct CanPoints
+{
+  int scoreP1;
+  int scoreP2;
+};
+
+struct CanReset
+{
+  int request;    // alltid 1 (også i CanSnapshotRequest)
+};
+
+struct CanSnapshot
+{
+  int scoreP1;
+  int scoreP2;
+  int phase;      // PHASE_PLAYING, PHASE_PAUSED eller PHASE_GAMEOVER (del3/sharedgamestate.h)
+  int plateP1;
+  int plateP2;
+  int x;
+  int y;
+  int vx;         // fire bit med fortegn, farten er aldri over 7
+  int vy;
+};
+
+struct CanResyncState
+{
+  int part;       // 0/1 resync, 2/3 gjenopptak (del A, så del B)
+  uint32_t tick;  // de 16 laveste bitene, mottakeren pakker ut med rollback.unwrapTick()
+  int x;          // xBall + 64, ballen kan være litt utenfor skjermen
+  int y;
+  int vx;
+  int vy;
+  int plateP1;
+  int plateP2;
+  int scoreP1;
+  int scoreP2;
+  int pauseTicks; // maks 200
+  int gameOver;
+  int epoch;      // spill-nr
+};
+
+struct CanHash
+{
+  int epoch;
+  uint32_t tick;  // de 16 laveste bitene
+  uint32_t hash;  // PongSim::hash()
+};
+
+struct CanInputs
+{
+  int epoch;      // spill-nr
+  uint32_t start; // første tick i rammen, de 16 laveste bitene
+  uint32_t ack;   // første tick avsenderen mangler fra motparten, de 16 laveste bitene
+  int input0;     // RollbackSession::noInput for ticks som ikke er simulert enda
+  int input1;
+  int input2;
+};
+
+struct CanHeartbeat
+{
+  int flags;      // Lars: heartbeatInGame osv. Klienten til serveren: 1 spiller, 2 game over
+  int epoch;      // spill-nr, bare i CanHeartbeatEpochP1/P2
+};
+
+struct CanModeChoice
+{
+  int mode;       // CAN_MODE_CLASSIC eller CAN_MODE_FD (del3/canfdstate.h)
+  int flags;      // canModeFlagBrs
+};
+
+struct CanEventAck
+{
+  uint32_t eventId;
+  uint8_t seq;
+};
+
+struct CanTimeSync
+{
+  uint32_t pingUs; // klientens micros() i pingen, sendes tilbake uendret
+  uint32_t tick;   // serverens tick, de 24 laveste bitene
+  int subTick;     // tid inn i ticken / ClockSync::subTickResolutionUs
+};
+
+struct CanHelloOffer
+{
+  int minVersion;
+  int maxVersion;
+  int layouts;     // HelloLayout-bits
+  int features;    // HelloFeature-bits
+  int tickHz;
+  int bitrate10k;
+};
+
+struct CanHelloChoice
+{
+  int result;      // HELLO_OK eller grunnen
+  int version;
+  int layout;
+  int features;
+  int tickHz;
+  int bitrate10k;  // serverens
+};
+
+// ---------- Spillet ----------
+
+// ID 25: klient -> server
+using CanJoystickP1 = CanMessage<19, 2,
+  CanUnsigned<&CanJoystick::moveState, 0, 8>,
+  CanWrapping<&CanJoystick::seq, 8, 8>>;
+using CanJoystickP1Legacy = CanMessage<19, 1,
+  CanUnsigned<&CanJoystick::moveState, 0, 8>>;
+
+// ID 26 og 27. Noder uten server (Kristie, Lars) sender sin egen plate på gruppe + 20 eller + 21.
+using CanPlateP1 = CanMessage<20, 1,
+  CanUnsigned<&CanPlate::position, 0, 8>>;
+using CanPlateP2 = CanMessage<21, 1,
+  CanUnsigned<&CanPlate::position, 0, 8>>;
+// ID 26 fra serveren med seq-en til siste joystick-ramme den har brukt (Oppg3 avstemmer mot den)
+using CanPlateAckP1 = CanMessage<20, 2,
+  CanUnsigned<&CanPlate::position, 0, 8>,
+  CanWrapping<&CanPlate::seq, 8, 8>>;
+
+// ID 56: ballen, og ID 55: ballbanen i banemodus (hendelse, samme felt)
+using CanBallPosition = CanMessage<50, 6,
+  CanUnsigned<&CanBall::x, 0, 8>,
+  CanUnsigned<&CanBall::y, 8, 8>,
+  CanWrapping<&CanBall::tick, 16, 16>,
+  CanSigned<&CanBall::vx, 32, 8>,
+  CanSigned<&CanBall::vy, 40, 8>>;
+using CanBallPositionLegacy = CanMessage<50, 2,
+  CanUnsigned<&CanBall::x, 0, 8>,
+  CanUnsigned<&CanBall::y, 8, 8>>;
+using CanBallTrajectory = CanMessage<49, 6,
+  CanUnsigned<&CanBall::x, 0, 8>,
+  CanUnsigned<&CanBall::y, 8, 8>,
+  CanWrapping<&CanBall::tick, 16, 16>,
+  CanSigned<&CanBall::vx, 32, 8>,
+  CanSigned<&CanBall::vy, 40, 8>>;
+
+// ID 57: poengsum (hendelse)
+using CanScore = CanMessage<51, 2,
+  CanUnsigned<&CanPoints::scoreP1, 0, 8>,
+  CanUnsigned<&CanPoints::scoreP2, 8, 8>>;
+
+// ID 58: be om ny runde, ID 59: serveren har resatt (hendelser)
+using CanResetGame = CanMessage<52, 1,
+  CanUnsigned<&CanReset::request, 0, 8>>;
+using CanResetAck = CanMessage<53, 1,
+  CanUnsigned<&CanReset::request, 0, 8>>;
+
+// ID 68: hele tilstanden til en klient som nettopp har startet (hendelse, svar på ID 67)
+using CanSnapshotReply = CanMessage<62, 8,
+  CanUnsigned<&CanSnapshot::scoreP1, 0, 8>,
+  CanUnsigned<&CanSnapshot::scoreP2, 8, 8>,
+  CanUnsigned<&CanSnapshot::phase, 16, 8>,
+  CanUnsigned<&CanSnapshot::plateP1, 24, 8>,
+  CanUnsigned<&CanSnapshot::plateP2, 32, 8>,
+  CanUnsigned<&CanSnapshot::x, 40, 8>,
+  CanUnsigned<&CanSnapshot::y, 48, 8>,
+  CanSigned<&CanSnapshot::vx, 56, 4>,
+  CanSigned<&CanSnapshot::vy, 60, 4>>;
+
+// ---------- Rollback (Lars/EndeligPingPong.cpp) ----------
+
+// ID 30: siste bekreftede tilstand i to rammer med samme ID, delen står i første byte
+using CanResyncBall = CanMessage<24, 8,
+  CanUnsigned<&CanResyncState::part, 0, 8>,
+  CanWrapping<&CanResyncState::tick, 8, 16>,
+  CanUnsigned<&CanResyncState::x, 24, 8>,
+  CanUnsigned<&CanResyncState::y, 32, 8>,
+  CanSigned<&CanResyncState::vx, 40, 4>,
+  CanSigned<&CanResyncState::vy, 44, 4>,
+  CanUnsigned<&CanResyncState::plateP1, 48, 8>,
+  CanUnsigned<&CanResyncState::plateP2, 56, 8>>;
+
+using CanResyncScore = CanMessage<24, 8,
+  CanUnsigned<&CanResyncState::part, 0, 8>,
+  CanWrapping<&CanResyncState::tick, 8, 16>,
+  CanUnsigned<&CanResyncState::scoreP1, 24, 8>,
+  CanUnsigned<&CanResyncState::scoreP2, 32, 8>,
+  CanUnsigned<&CanResyncState::pauseTicks, 40, 8>,
+  CanUnsigned<&CanResyncState::gameOver, 48, 8>,
+  CanUnsigned<&CanResyncState::epoch, 56, 8>>;
+
+// ID 106: hash av en bekreftet tick (lav prioritet)
+using CanStateHash = CanMessage<100, 7,
+  CanUnsigned<&CanHash::epoch, 0, 8>,
+  CanWrapping<&CanHash::tick, 8, 16>,
+  CanUnsigned<&CanHash::hash, 24, 32>>;
+
+// ID 28 og 29: input for de siste tickene (felles/rollback.h), P1 og P2 har samme innhold
+using CanInputP1 = CanMessage<22, 8,
+  CanUnsigned<&CanInputs::epoch, 0, 8>,
+  CanWrapping<&CanInputs::start, 8, 16>,
+  CanWrapping<&CanInputs::ack, 24, 16>,
+  CanUnsigned<&CanInputs::input0, 40, 8>,
+  CanUnsigned<&CanInputs::input1, 48, 8>,
+  CanUnsigned<&CanInputs::input2, 56, 8>>;
+using CanInputP2 = CanMessage<23, 8,
+  CanUnsigned<&CanInputs::epoch, 0, 8>,
+  CanWrapping<&CanInputs::start, 8, 16>,
+  CanWrapping<&CanInputs::ack, 24, 16>,
+  CanUnsigned<&CanInputs::input0, 40, 8>,
+  CanUnsigned<&CanInputs::input1, 48, 8>,
+  CanUnsigned<&CanInputs::input2, 56, 8>>;
+
+// ---------- Drift ----------
+
+// ID 31 og 32: heartbeat (felles/heartbeat.h). Klienten til serveren sender bare flaggene,
+// EndeligPingPong også spill-nr.
+using CanHeartbeatP1 = CanMessage<25, 1,
+  CanUnsigned<&CanHeartbeat::flags, 0, 8>>;
+using CanHeartbeatP2 = CanMessage<26, 1,
+  CanUnsigned<&CanHeartbeat::flags, 0, 8>>;
+using CanHeartbeatEpochP1 = CanMessage<25, 2,
+  CanUnsigned<&CanHeartbeat::flags, 0, 8>,
+  CanUnsigned<&CanHeartbeat::epoch, 8, 8>>;
+using CanHeartbeatEpochP2 = CanMessage<26, 2,
+  CanUnsigned<&CanHeartbeat::flags, 0, 8>,
+  CanUnsigned<&CanHeartbeat::epoch, 8, 8>>;
+
+// ID 60: en Linux-node vil ha klassisk CAN eller FD (del3/main.cpp), ID 61: svaret.
+// De første nodene sendte bare modusen.
+using CanModeRequest = CanMessage<54, 2,
+  CanUnsigned<&CanModeChoice::mode, 0, 8>,
+  CanUnsigned<&CanModeChoice::flags, 8, 8>>;
+using CanModeRequestLegacy = CanMessage<54, 1,
+  CanUnsigned<&CanModeChoice::mode, 0, 8>>;
+using CanModeAck = CanMessage<55, 2,
+  CanUnsigned<&CanModeChoice::mode, 0, 8>,
+  CanUnsigned<&CanModeChoice::flags, 8, 8>>;
+
+// ID 63 og 64: ack for en hendelse (felles/reliableevents.h), fra P1/serveren og fra P2/klienten
+using CanEventAckP1 = CanMessage<57, 3,
+  CanUnsigned<&CanEventAck::eventId, 0, 16>,
+  CanWrapping<&CanEventAck::seq, 16, 8>>;
+using CanEventAckP2 = CanMessage<58, 3,
+  CanUnsigned<&CanEventAck::eventId, 0, 16>,
+  CanWrapping<&CanEventAck::seq, 16, 8>>;
+
+// ID 65: klokke-ping, ID 66: svaret med serverens tid (felles/clocksync.h)
+using CanTimePing = CanMessage<59, 4,
+  CanWrapping<&CanTimeSync::pingUs, 0, 32>>;
+using CanTimePong = CanMessage<60, 8,
+  CanWrapping<&CanTimeSync::pingUs, 0, 32>,
+  CanWrapping<&CanTimeSync::tick, 32, 24>,
+  CanUnsigned<&CanTimeSync::subTick, 56, 8>>;
+
+// ID 67: be om hele tilstanden (svaret er CanSnapshotReply)
+using CanSnapshotRequest = CanMessage<61, 1,
+  CanUnsigned<&CanReset::request, 0, 8>>;
+
+// ID 69: hva klienten kan, ID 70: det serveren valgte (felles/hello.h)
+using CanHello = CanMessage<63, 7,
+  CanUnsigned<&CanHelloOffer::minVersion, 0, 8>,
+  CanUnsigned<&CanHelloOffer::maxVersion, 8, 8>,
+  CanUnsigned<&CanHelloOffer::layouts, 16, 8>,
+  CanUnsigned<&CanHelloOffer::features, 24, 16>,
+  CanUnsigned<&CanHelloOffer::tickHz, 40, 8>,
+  CanUnsigned<&CanHelloOffer::bitrate10k, 48, 8>>;
+using CanHelloReply = CanMessage<64, 7,
+  CanUnsigned<&CanHelloChoice::result, 0, 8>,
+  CanUnsigned<&CanHelloChoice::version, 8, 8>,
+  CanUnsigned<&CanHelloChoice::layout, 16, 8>,
+  CanUnsigned<&CanHelloChoice::features, 24, 16>,
+  CanUnsigned<&CanHelloChoice::tickHz, 40, 8>,
+  CanUnsigned<&CanHelloChoice::bitrate10k, 48, 8>>;
+
+// ---------- Uten fast format ----------
+
+using CanRoleClaim      = CanMessage<10, 0>;  // ID 16, bare de 11 øverste bitene av en utvidet ID (felles/rolearbiter.h)
+using CanFullStateFd    = CanMessage<56, 0>;  // ID 62, CAN FD, del3/canfdstate.h
+using CanBulkToNode     = CanMessage<110, 0>; // ID 116, felles/isotp.h (verktøy -> node)
+using CanBulkFromNode   = CanMessage<111, 0>; // ID 117 (node -> verktøy)
+
+#endif
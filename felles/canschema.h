@@ -0,0 +1,276 @@
+#ifndef CANSCHEMA_H
+#define CANSCHEMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
+#include "candispatch.h"
+
+/*
+ * Maskineriet bak meldingsskjemaet i felles/canmessages.h. En melding er en ID (offset fra
+ * gruppenummeret), en lengde og en liste felt, hvert med plass i rammen (bit-offset og antall
+ * bit) og medlemmet i en vanlig struct det hører til:
+ *
+ *   struct CanPoints { int scoreP1; int scoreP2; };
+ *   using CanScore = CanMessage<51, 2,
+ *     CanUnsigned<&CanPoints::scoreP1, 0, 8>,
+ *     CanUnsigned<&CanPoints::scoreP2, 8, 8>>;
+ *
+ *   uint8_t data[CanScore::length];
+ *   CanScore::encode({scoreP1, scoreP2}, data);
+ *   CanPoints score;
+ *   if (CanScore::decode(rxMsg, score)) ...   // CAN_message_t, can_frame eller canfd_frame
+ *
+ * Bitene telles fra bit 0 i byte 0, og felt over flere byte er little endian, slik rammene
+ * alltid har vært (tick lav, tick høy). Felt trenger ikke ligge på hele byte: fire bit fart
+ * i hver halvdel av en byte er CanSigned<.., 56, 4> og CanSigned<.., 60, 4>.
+ *
+ * Felttyper:
+ *   CanUnsigned  0 .. 2^bit - 1, verdier utenfor settes til nærmeste grense
+ *   CanSigned    toerkomplement, -2^(bit-1) .. 2^(bit-1) - 1, også med grense
+ *   CanWrapping  bare de laveste bitene sendes (tick og sekvensnumre som skal gå rundt)
+ * Med Scale sendes verdi / Scale, og decode gir tilbake rå * Scale.
+ *
+ * Grensene erstatter (uint8_t)-castene vi hadde: en ball på x = -2 blir 0 og ikke 254.
+ * Medlemmene kan derfor være int, så det ikke skjer noen stille avkorting før encode().
+ *
+ * Feil i et skjema stopper byggingen: felt som overlapper, felt utenfor lengden, en lengde
+ * over 8, for mange bit for medlemmet, og felt fra ulike structer i samme melding.
+ *
+ * Alt er konstanter for kompilatoren, så encode/decode blir de samme skift og masker som
+ * vi skrev for hånd, uten løkker og uten kopi av rammen. Ett felt kan også leses rett fra
+ * bufferet med CanX::get<&Struct::felt>(data).
+ */
+
+enum CanFieldKind : uint8_t
+{
+  CAN_FIELD_UNSIGNED,
+  CAN_FIELD_SIGNED,
+  CAN_FIELD_WRAPPING
+};
+
+template <typename M>
+struct CanMemberTraits;
+
+template <typename T, typename C>
+struct CanMemberTraits<T C::*>
+{
+  typedef T Type;
+  typedef C Owner;
+};
+
+template <auto Member, uint8_t BitOffset, uint8_t Bits, CanFieldKind Kind, int32_t Scale = 1>
+struct CanField
+{
+  typedef typename CanMemberTraits<decltype(Member)>::Type Type;
+  typedef typename CanMemberTraits<decltype(Member)>::Owner Owner;
+
+  static constexpr auto member = Member;
+  static constexpr uint8_t bitOffset = BitOffset;
+  static constexpr uint8_t bits = Bits;
+  static constexpr uint8_t endBit = BitOffset + Bits;
+  static constexpr uint64_t frameMask = (((uint64_t)1 << Bits) - 1) << BitOffset;
+
+  static_assert(Bits >= 1 && Bits <= 32, "CAN-felt må være 1 til 32 bit");
+  static_assert(BitOffset + Bits <= 64, "CAN-felt ligger utenfor 8 byte");
+  static_assert(Scale >= 1, "Scale må være 1 eller mer");
+  static_assert(std::is_integral<Type>::value || std::is_enum<Type>::value, "CAN-felt må være heltall");
+  static_assert(Scale > 1 || Bits <= sizeof(Type) * 8, "feltet har flere bit enn medlemmet");
+  static_assert(Kind != CAN_FIELD_SIGNED || Bits >= 2, "et felt med fortegn trenger minst 2 bit");
+
+  static constexpr uint8_t firstByte = BitOffset / 8;
+  static constexpr uint8_t shift = BitOffset % 8;
+  static constexpr uint8_t byteCount = (shift + Bits + 7) / 8;
+  static constexpr uint32_t mask = Bits == 32 ? 0xffffffffu : (1u << Bits) - 1;
+  static constexpr int64_t rawMin = Kind == CAN_FIELD_SIGNED ? -((int64_t)1 << (Bits - 1)) : 0;
+  static constexpr int64_t rawMax = Kind == CAN_FIELD_SIGNED ? ((int64_t)1 << (Bits - 1)) - 1 : mask;
+
+  static uint32_t readRaw(const uint8_t* data)
+  {
+    uint64_t word = 0;
+    for (uint8_t i = 0; i < byteCount; i++) word |= (uint64_t)data[firstByte + i] << (8 * i);
+    return (uint32_t)(word >> shift) & mask;
+  }
+
+  // Forutsetter at bitene er 0 fra før (encode() nuller rammen)
+  static void writeRaw(uint8_t* data, uint32_t raw)
+  {
+    uint64_t word = (uint64_t)(raw & mask) << shift;
+    for (uint8_t i = 0; i < byteCount; i++) data[firstByte + i] |= (uint8_t)(word >> (8 * i));
+  }
+
+  static Type get(const uint8_t* data)
+  {
+    uint32_t raw = readRaw(data);
+    if (Kind == CAN_FIELD_SIGNED)
+    {
+      int32_t value = (int32_t)(raw << (32 - Bits)) >> (32 - Bits);
+      return (Type)(value * Scale);
+    }
+    return (Type)((int64_t)raw * Scale);
+  }
+
+  static void put(uint8_t* data, Type value)
+  {
+    int64_t scaled = (int64_t)value / Scale;
+    if (Kind != CAN_FIELD_WRAPPING)
+    {
+      scaled = scaled < rawMin ? rawMin : scaled;
+      scaled = scaled > rawMax ? rawMax : scaled;
+    }
+    writeRaw(data, (uint32_t)scaled);
+  }
+};
+
+template <auto Member, uint8_t BitOffset, uint8_t Bits, int32_t Scale = 1>
+using CanUnsigned = CanField<Member, BitOffset, Bits, CAN_FIELD_UNSIGNED, Scale>;
+
+template <auto Member, uint8_t BitOffset, uint8_t Bits, int32_t Scale = 1>
+using CanSigned = CanField<Member, BitOffset, Bits, CAN_FIELD_SIGNED, Scale>;
+
+template <auto Member, uint8_t BitOffset, uint8_t Bits>
+using CanWrapping = CanField<Member, BitOffset, Bits, CAN_FIELD_WRAPPING>;
+
+// Meldinger uten felt: innholdet eies av en annen header (felles/clocksync.h osv.)
+struct CanOpaque {};
+
+// ---------- Sjekker av skjemaet ----------
+
+template <typename... Fields>
+constexpr bool canFieldsDisjoint()
+{
+  const uint64_t masks[] = {0, Fields::frameMask...};
+  uint64_t used = 0;
+  for (uint64_t mask : masks)
+  {
+    if (used & mask) return false;
+    used |= mask;
+  }
+  return true;
+}
+
+template <uint8_t Length, typename... Fields>
+constexpr bool canFieldsFit()
+{
+  const uint8_t ends[] = {0, Fields::endBit...};
+  for (uint8_t end : ends)
+  {
+    if (end > Length * 8) return false;
+  }
+  return true;
+}
+
+template <typename... Fields>
+struct CanOwnerOf
+{
+  typedef CanOpaque Type;
+};
+
+template <typename First, typename... Rest>
+struct CanOwnerOf<First, Rest...>
+{
+  typedef typename First::Owner Type;
+  static_assert((std::is_same<typename Rest::Owner, Type>::value && ...), "alle feltene i en melding må høre til samme struct");
+};
+
+// Feltet som hører til et medlem, for get<&Struct::felt>()
+template <auto A, auto B>
+constexpr bool canSameMember()
+{
+  if constexpr (std::is_same<decltype(A), decltype(B)>::value) return A == B;
+  else return false;
+}
+
+template <auto Member, typename... Fields>
+struct CanFieldFor;
+
+template <auto Member, typename First, typename... Rest>
+struct CanFieldFor<Member, First, Rest...>
+{
+  typedef typename std::conditional<canSameMember<First::member, Member>(), First,
+                                    typename CanFieldFor<Member, Rest...>::Type>::type Type;
+};
+
+template <auto Member>
+struct CanFieldFor<Member>
+{
+  typedef void Type;
+};
+
+// ---------- Rammer ----------
+// CAN_message_t (Teensy) har id/len/buf, can_frame og canfd_frame (Linux) har can_id/len/data.
+
+template <typename Frame>
+auto canFrameData(Frame& frame) -> decltype(frame.buf + 0) {return frame.buf;}
+
+template <typename Frame>
+auto canFrameData(Frame& frame) -> decltype(frame.data + 0) {return frame.data;}
+
+template <typename Frame>
+auto setCanFrameId(Frame& frame, uint32_t id) -> decltype(frame.id = id, void()) {frame.id = id;}
+
+template <typename Frame>
+auto setCanFrameId(Frame& frame, uint32_t id) -> decltype(frame.can_id = id, void()) {frame.can_id = id;}
+
+// ---------- Meldingen ----------
+
+template <uint16_t Offset, uint8_t Length, typename... Fields>
+struct CanMessage
+{
+  typedef typename CanOwnerOf<Fields...>::Type Value;
+
+  static constexpr uint16_t offset = Offset;
+  static constexpr uint8_t length = Length;
+
+  static_assert(Length <= 8, "en klassisk CAN-ramme har maks 8 byte");
+  static_assert(canFieldsFit<Length, Fields...>(), "et felt ligger utenfor meldingens lengde");
+  static_assert(canFieldsDisjoint<Fields...>(), "to felt bruker de samme bitene");
+
+  static constexpr uint32_t id(uint32_t groupNumber) {return groupNumber + Offset;}
+
+  // Rute for felles/candispatch.h: lengden sjekkes før handleren kalles
+  static constexpr CanRoute route(uint8_t base, CanHandler handler)
+  {
+    return {base, Offset, Length, 8, handler};
+  }
+
+  // Skriver hele meldingen (også bit som ingen felt bruker, som blir 0). Returnerer lengden.
+  static uint8_t encode(const Value& value, uint8_t* data)
+  {
+    for (uint8_t i = 0; i < Length; i++) data[i] = 0;
+    (Fields::put(data, value.*(Fields::member)), ...);
+    return Length;
+  }
+
+  // Leser feltene hvis rammen er lang nok. Lengre rammer er greit (nyere versjoner kan legge til felt).
+  static bool decode(const uint8_t* data, uint8_t len, Value& value)
+  {
+    if (len < Length) return false;
+    ((value.*(Fields::member) = Fields::get(data)), ...);
+    return true;
+  }
+
+  template <typename Frame>
+  static void encode(const Value& value, uint32_t groupNumber, Frame& frame)
+  {
+    setCanFrameId(frame, id(groupNumber));
+    frame.len = encode(value, canFrameData(frame));
+  }
+
+  template <typename Frame>
+  static bool decode(const Frame& frame, Value& value)
+  {
+    return decode(canFrameData(frame), frame.len, value);
+  }
+
+  // Ett felt rett fra bufferet (uten lengdesjekk, den er caller sitt ansvar)
+  template <auto Member>
+  static auto get(const uint8_t* data)
+  {
+    typedef typename CanFieldFor<Member, Fields...>::Type Field;
+    static_assert(!std::is_void<Field>::value, "meldingen har ikke dette feltet");
+    return Field::get(data);
+  }
+};
+
+#endif
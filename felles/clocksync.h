@@ -0,0 +1,157 @@
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <stdint.h>
+#include "canmessages.h"
+
+/*
+ * NTP-lignende klokkesynkronisering mellom pong-serveren og en Teensy over CAN.
+ *
+ * Serverens klokke er tick-basert: tid = tick * 10 ms + tid siden ticken startet.
+ * Serveren holder tickene på et fast skjema, så denne klokken går i takt med sanntid.
+ *
+ *  Teensy -> server, ping (ID 65, CanTimePing): [t1 (lokal micros(), 4 bytes LE)]
+ *  Server -> Teensy, pong (ID 66, CanTimePong): [t1 (ekko, 4 bytes)] [tick (24 bit LE)] [tid i ticken / 40 us]
+ *
+ *  t4 = lokal tid når pongen leses
+ *  RTT    = t4 - t1
+ *  offset = servertid - (t1 + t4) / 2     (servertid ~ lokal tid + offset)
+ *
+ * Teensyen leser CAN bare én gang per loop, så noen svar blir forsinket. Vi tar derfor
+ * offseten fra målingen med lavest RTT blant de siste, den er minst påvirket av ventetid.
+ *
+ * Tilstandsrammer (feks. ball, ID 56) har de 16 laveste bitene av ticken med. Med offseten
+ * kan klienten regne ut når rammen ble laget i sin egen tid, og dermed måle forsinkelsen.
+ */
+
+class ClockSync
+{
+  public:
+  static const uint32_t tickUs = 10000;       // serverens tick (100 Hz)
+  static const uint32_t subTickResolutionUs = 40;
+  static const int sampleWindow = 8;
+
+  ClockSync()
+    : hasLocal_{false}
+    , lastLocalUs_{0}
+    , lastExtendedUs_{0}
+    , sampleCount_{0}
+    , nextSample_{0}
+    , offsetUs_{0}
+    , rttUs_{0}
+    , synchronized_{false}
+  {}
+
+  // ---------- Klientsiden (Teensy) ----------
+
+  static uint8_t makePing(uint32_t localUs, uint8_t* data)
+  {
+    return CanTimePing::encode({localUs, 0, 0}, data);
+  }
+
+  void handlePong(const uint8_t* data, uint8_t len, uint32_t localUs)
+  {
+    CanTimeSync pong;
+    if (!CanTimePong::decode(data, len, pong)) return;
+
+    uint64_t t1 = extendLocal(pong.pingUs);
+    uint64_t t4 = extendLocal(localUs);
+    if (t4 < t1) return;
+
+    uint64_t serverUs = (uint64_t)pong.tick * tickUs + (uint64_t)pong.subTick * subTickResolutionUs;
+
+    Sample& sample = samples_[nextSample_];
+    sample.rttUs = (uint32_t)(t4 - t1);
+    sample.offsetUs = (int64_t)serverUs - (int64_t)((t1 + t4) / 2);
+    nextSample_ = (nextSample_ + 1) % sampleWindow;
+    if (sampleCount_ < sampleWindow) sampleCount_++;
+
+    // Beste måling i vinduet
+    int best = 0;
+    for (int i = 1; i < sampleCount_; i++)
+    {
+      if (samples_[i].rttUs < samples_[best].rttUs) best = i;
+    }
+    offsetUs_ = samples_[best].offsetUs;
+    rttUs_ = samples_[best].rttUs;
+    synchronized_ = true;
+  }
+
+  bool isSynchronized() const { return synchronized_; }
+  bool hasFullWindow() const { return sampleCount_ >= sampleWindow; }
+  int64_t offsetUs() const { return offsetUs_; }
+  uint32_t rttUs() const { return rttUs_; }
+
+  // Gjør om 16-bits tick fra en tilstandsramme til lokal tid (micros()) for starten av ticken.
+  // Ticken antas å være fra de siste ~650 sekundene.
+  uint32_t tickToLocalUs(uint16_t tick16, uint32_t nowLocalUs)
+  {
+    return (uint32_t)(fullTick(tick16, nowLocalUs) * tickUs - offsetUs_);
+  }
+
+  // Hele ticknummeret til en 16-bits tick, ut fra hva serveren er på nå
+  int64_t fullTick(uint16_t tick16, uint32_t nowLocalUs)
+  {
+    int64_t serverNowUs = (int64_t)extendLocal(nowLocalUs) + offsetUs_;
+    int64_t serverNowTick = serverNowUs / tickUs;
+    int64_t age = (uint16_t)((uint16_t)serverNowTick - tick16);
+    if (age > 0x8000) age -= 0x10000; // litt i fremtiden pga. unøyaktig offset
+    return serverNowTick - age;
+  }
+
+  // Nåværende servertick ut fra lokal tid
+  int64_t serverTickNow(uint32_t nowLocalUs)
+  {
+    return ((int64_t)extendLocal(nowLocalUs) + offsetUs_) / tickUs;
+  }
+
+  // ---------- Serversiden ----------
+
+  static uint8_t makePong(const uint8_t* ping, uint32_t tick, uint32_t usSinceTickStart, uint8_t* data)
+  {
+    // subTick over 255 settes til 255 av CanTimePong
+    uint32_t pingUs = CanTimePing::get<&CanTimeSync::pingUs>(ping);
+    return CanTimePong::encode({pingUs, tick, (int)(usSinceTickStart / subTickResolutionUs)}, data);
+  }
+
+  private:
+  struct Sample
+  {
+    uint32_t rttUs;
+    int64_t offsetUs;
+  };
+
+  // micros() på Teensy er 32 bit og går rundt etter ~71 minutter. Utvider til 64 bit ut fra
+  // avstanden til forrige verdi, slik at både litt eldre (t1) og nyere tider blir riktige.
+  uint64_t extendLocal(uint32_t us)
+  {
+    if (!hasLocal_)
+    {
+      hasLocal_ = true;
+      lastLocalUs_ = us;
+      lastExtendedUs_ = us;
+    }
+    int32_t delta = (int32_t)(us - lastLocalUs_);
+    uint64_t extended = lastExtendedUs_ + (int64_t)delta;
+    if (delta > 0)
+    {
+      lastLocalUs_ = us;
+      lastExtendedUs_ = extended;
+    }
+    return extended;
+  }
+
+  bool hasLocal_;
+  uint32_t lastLocalUs_;
+  uint64_t lastExtendedUs_;
+
+  Sample samples_[sampleWindow];
+  int sampleCount_;
+  int nextSample_;
+
+  int64_t offsetUs_;
+  uint32_t rttUs_;
+  bool synchronized_;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#include <stdint.h>
+
+/*
+ * Heartbeat og timeout for å se om motparten på bussen lever.
+ *
+ * Hver node sender en heartbeat hvert heartbeatPeriodMs på sin egen ID (heartbeatDue()
+ * sier når), og kaller heard() for hver ramme fra motparten. Hører vi ingenting på
+ * timeoutMs regnes motparten som borte. update() gir beskjed én gang når den forsvinner
+ * og én gang når den kommer tilbake, slik at kalleren kan ta over eller forhandle på nytt.
+ *
+ * Brukes av Lars/EndeligPingPong.cpp (P1 og P2 overvåker hverandre) og av del3/main.cpp
+ * (serveren ser om Teensyen har falt ut). Tiden er millis() på Teensy og ms siden start på Linux.
+ */
+
+class PeerMonitor
+{
+  public:
+  enum Event
+  {
+    PEER_NO_CHANGE,
+    PEER_LOST,
+    PEER_RETURNED
+  };
+
+  PeerMonitor(uint32_t heartbeatPeriodMs, uint32_t timeoutMs)
+    : heartbeatPeriodMs_{heartbeatPeriodMs}
+    , timeoutMs_{timeoutMs}
+    , lastSentMs_{0}
+    , lastHeardMs_{0}
+    , seen_{false}
+    , alive_{false}
+    , returnedPending_{false}
+    , lostCount_{0}
+  {}
+
+  void configure(uint32_t heartbeatPeriodMs, uint32_t timeoutMs)
+  {
+    heartbeatPeriodMs_ = heartbeatPeriodMs;
+    timeoutMs_ = timeoutMs;
+  }
+
+  // True når det er tid for å sende en ny heartbeat
+  bool heartbeatDue(uint32_t nowMs)
+  {
+    if (nowMs - lastSentMs_ < heartbeatPeriodMs_) return false;
+    lastSentMs_ = nowMs;
+    return true;
+  }
+
+  // Kalles for hver ramme fra motparten (heartbeat eller annet)
+  void heard(uint32_t nowMs)
+  {
+    lastHeardMs_ = nowMs;
+    if (seen_ && !alive_) returnedPending_ = true;
+    seen_ = true;
+    alive_ = true;
+  }
+
+  Event update(uint32_t nowMs)
+  {
+    if (returnedPending_)
+    {
+      returnedPending_ = false;
+      return PEER_RETURNED;
+    }
+    if (alive_ && nowMs - lastHeardMs_ > timeoutMs_)
+    {
+      alive_ = false;
+      lostCount_++;
+      return PEER_LOST;
+    }
+    return PEER_NO_CHANGE;
+  }
+
+  // Glemmer motparten (feks. ved nytt spill), neste ramme regnes ikke som "tilbake"
+  void reset()
+  {
+    seen_ = false;
+    alive_ = false;
+    returnedPending_ = false;
+  }
+
+  bool isAlive() const { return alive_; }
+  bool hasBeenSeen() const { return seen_; }
+  uint32_t lostCount() const { return lostCount_; }
+  uint32_t silentForMs(uint32_t nowMs) const { return nowMs - lastHeardMs_; }
+
+  private:
+  uint32_t heartbeatPeriodMs_;
+  uint32_t timeoutMs_;
+  uint32_t lastSentMs_;
+  uint32_t lastHeardMs_;
+  bool seen_;
+  bool alive_;
+  bool returnedPending_;
+  uint32_t lostCount_;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef HELLO_H
+#define HELLO_H
+
+#include <stdint.h>
+#include "canmessages.h"
+
+/*
+ * Hello og forhandling av protokoll mellom en klient (Teensy) og serveren (del3/main.cpp).
+ *
+ * Skissene har brukt ulike konvensjoner (bitrate, rammeformat, hvilke ID-er som finnes), og
+ * feil kombinasjon ga bare søppel på skjermen. Nå sender klienten hva den kan ved oppstart,
+ * og serveren svarer med det begge kan, eller en grunn til at det ikke går.
+ *
+ * Hello (ID 69, CanHello, klient -> server):
+ *   [min versjon, maks versjon, rammeformater, funksjoner lav, funksjoner høy, tick Hz, bitrate / 10 kbit]
+ * Svar (ID 70, CanHelloReply, server -> klient):
+ *   [resultat (HELLO_OK eller grunn), versjon, rammeformat, funksjoner lav, funksjoner høy, tick Hz, bitrate / 10 kbit]
+ *
+ * Begge velger det mest effektive de har felles: høyeste versjon, det tetteste rammeformatet
+ * og laveste tick-rate. Funksjonene er de begge har.
+ *
+ * Ulik bitrate kan ikke forhandles, da hører nodene ikke hverandre i det hele tatt. Får
+ * klienten ikke svar, er det derfor det første den skal be brukeren sjekke.
+ */
+
+enum HelloLayout : uint8_t
+{
+  LAYOUT_LEGACY = 0x01, // ball [x, y], joystick [tilstand], plate [posisjon]
+  LAYOUT_PACKED = 0x02  // ball [x, y, tick, vx, vy], joystick [tilstand, seq], plate [posisjon, seq]
+};
+
+enum HelloFeature : uint16_t
+{
+  FEATURE_RELIABLE_EVENTS = 0x0001, // felles/reliableevents.h
+  FEATURE_CLOCK_SYNC      = 0x0002, // felles/clocksync.h
+  FEATURE_TRAJECTORY      = 0x0004, // ballbaner på ID 55
+  FEATURE_INPUT_SEQ       = 0x0008, // seq i joystick-rammene
+  FEATURE_SNAPSHOT        = 0x0010, // hele tilstanden på ID 67/68
+  FEATURE_HEARTBEAT       = 0x0020  // felles/heartbeat.h
+};
+
+enum HelloResult : uint8_t
+{
+  HELLO_OK = 0,
+  HELLO_NO_COMMON_VERSION = 1,
+  HELLO_NO_COMMON_LAYOUT = 2,
+  HELLO_NO_COMMON_TICK_RATE = 3,
+  HELLO_MISSING_REQUIRED_FEATURE = 4
+};
+
+struct HelloCapabilities
+{
+  uint8_t minVersion;
+  uint8_t maxVersion;
+  uint8_t layouts;        // HelloLayout-bits
+  uint16_t features;      // HelloFeature-bits
+  uint16_t requiredFeatures; // sendes ikke, bare for den som forhandler
+  uint8_t tickHz;         // høyeste tick-rate vi klarer
+  uint8_t bitrate10k;     // bitraten vi er satt opp med, bare for feilmeldinger
+};
+
+struct HelloAgreement
+{
+  uint8_t result;
+  uint8_t version;
+  uint8_t layout;
+  uint16_t features;
+  uint8_t tickHz;
+  uint8_t peerBitrate10k;
+
+  bool has(uint16_t feature) const { return (features & feature) != 0; }
+};
+
+class Hello
+{
+  public:
+  static const uint8_t protocolVersion = 2; // 1: før sekvensnumre og tick i rammene
+  static const uint8_t frameLength = CanHello::length;
+  static_assert(CanHelloReply::length == CanHello::length, "hello og svaret bruker samme buffer");
+
+  static uint8_t makeHello(const HelloCapabilities& own, uint8_t* data)
+  {
+    return CanHello::encode({own.minVersion, own.maxVersion, own.layouts, own.features, own.tickHz, own.bitrate10k}, data);
+  }
+
+  static bool readHello(const uint8_t* data, uint8_t len, HelloCapabilities& peer)
+  {
+    CanHelloOffer offer;
+    if (!CanHello::decode(data, len, offer)) return false;
+    peer.minVersion = offer.minVersion;
+    peer.maxVersion = offer.maxVersion;
+    peer.layouts = offer.layouts;
+    peer.features = offer.features;
+    peer.requiredFeatures = 0;
+    peer.tickHz = offer.tickHz;
+    peer.bitrate10k = offer.bitrate10k;
+    return true;
+  }
+
+  // Det beste begge kan. result er HELLO_OK eller grunnen til at det ikke finnes noe felles.
+  static HelloAgreement negotiate(const HelloCapabilities& own, const HelloCapabilities& peer)
+  {
+    HelloAgreement agreement = {HELLO_OK, 0, 0, 0, 0, peer.bitrate10k};
+
+    uint8_t highestMin = own.minVersion > peer.minVersion ? own.minVersion : peer.minVersion;
+    uint8_t lowestMax = own.maxVersion < peer.maxVersion ? own.maxVersion : peer.maxVersion;
+    if (lowestMax < highestMin)
+    {
+      agreement.result = HELLO_NO_COMMON_VERSION;
+      return agreement;
+    }
+    agreement.version = lowestMax;
+
+    uint8_t commonLayouts = own.layouts & peer.layouts;
+    if (commonLayouts == 0)
+    {
+      agreement.result = HELLO_NO_COMMON_LAYOUT;
+      return agreement;
+    }
+    agreement.layout = (commonLayouts & LAYOUT_PACKED) ? LAYOUT_PACKED : LAYOUT_LEGACY;
+
+    agreement.tickHz = own.tickHz < peer.tickHz ? own.tickHz : peer.tickHz;
+    if (agreement.tickHz == 0)
+    {
+      agreement.result = HELLO_NO_COMMON_TICK_RATE;
+      return agreement;
+    }
+
+    agreement.features = own.features & peer.features;
+    if ((agreement.features & own.requiredFeatures) != own.requiredFeatures)
+    {
+      agreement.result = HELLO_MISSING_REQUIRED_FEATURE;
+      return agreement;
+    }
+    return agreement;
+  }
+
+  static uint8_t makeReply(const HelloAgreement& agreement, uint8_t ownBitrate10k, uint8_t* data)
+  {
+    return CanHelloReply::encode({agreement.result, agreement.version, agreement.layout, agreement.features,
+                                  agreement.tickHz, ownBitrate10k}, data);
+  }
+
+  static bool readReply(const uint8_t* data, uint8_t len, HelloAgreement& agreement)
+  {
+    CanHelloChoice choice;
+    if (!CanHelloReply::decode(data, len, choice)) return false;
+    agreement.result = choice.result;
+    agreement.version = choice.version;
+    agreement.layout = choice.layout;
+    agreement.features = choice.features;
+    agreement.tickHz = choice.tickHz;
+    agreement.peerBitrate10k = choice.bitrate10k;
+    return true;
+  }
+
+  // Kort nok for OLED-skjermen (21 tegn)
+  static const char* reasonText(uint8_t result)
+  {
+    switch (result)
+    {
+      case HELLO_OK: return "OK";
+      case HELLO_NO_COMMON_VERSION: return "Ulik protokollversjon";
+      case HELLO_NO_COMMON_LAYOUT: return "Ulikt rammeformat";
+      case HELLO_NO_COMMON_TICK_RATE: return "Ingen felles tickrate";
+      case HELLO_MISSING_REQUIRED_FEATURE: return "Mangler funksjon";
+      default: return "Ukjent feil";
+    }
+  }
+};
+
+#endif
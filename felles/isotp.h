@@ -0,0 +1,325 @@
+#ifndef ISOTP_H
+#define ISOTP_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * ISO 15765-2 (ISO-TP) over klassisk CAN, for meldinger som ikke får plass i én ramme
+ * (kamplogger, konfigtabeller, diagnose). Samme format som CAN_ISOTP-socketen i Linux-kjernen
+ * (normal adressering, ingen padding), så en Teensy kan snakke med del3/isotptool.cpp.
+ *
+ * Rammer (første byte er PCI):
+ *   Single frame      [0x0L, data (L <= 7)]
+ *   First frame       [0x1H, lengde lav, 6 bytes data]   lengde = H << 8 | lav, maks 4095
+ *   Consecutive frame [0x2N, 7 bytes data]               N = sekvensnummer 1, 2 .. 15, 0, 1 ..
+ *   Flow control      [0x3S, block size, STmin]          S = 0 send, 1 vent, 2 for stor
+ *
+ * Mottakeren bestemmer tempoet: etter first frame, og etter hver block size consecutive
+ * frames, sender den flow control med hvor mange rammer som kan komme (0 = alle) og minste
+ * tid mellom dem (STmin). Ingen flow control innen timeoutMs avbryter overføringen.
+ *
+ * Spillrammene skal ikke sulte: ISO-TP-ID-ene ligger nederst i gruppens blokk (gruppe + 110
+ * og + 111), så alle spillrammer vinner arbitreringen. I tillegg sender update() maks
+ * framesPerUpdate rammer per kall, så sendekøen (16 på Teensyen) aldri blir full av bulk.
+ *
+ * Bare logikk: sendefunksjonen gir rammene til CAN, og innkommende gis til receive().
+ * Én instans kan sende og motta samtidig (flow control for det vi sender kommer på rxId).
+ */
+
+class IsoTp
+{
+  public:
+  // Returnerer false hvis rammen ikke kom i sendekøen (prøves igjen ved neste update())
+  typedef bool (*SendFunction)(void* context, uint32_t id, const uint8_t* data, uint8_t len);
+
+  static const uint16_t maxMessage = 4095; // største lengde en first frame kan ha
+  static const uint32_t timeoutMs = 1000;  // N_Bs og N_Cr i standarden
+
+  enum FlowStatus : uint8_t
+  {
+    FLOW_CONTINUE = 0,
+    FLOW_WAIT = 1,
+    FLOW_OVERFLOW = 2
+  };
+
+  IsoTp(SendFunction send, void* context, uint32_t txId, uint32_t rxId, uint8_t blockSize = 8, uint32_t stMinUs = 0)
+    : send_{send}
+    , context_{context}
+    , txId_{txId}
+    , rxId_{rxId}
+    , blockSize_{blockSize}
+    , stMin_{encodeStMin(stMinUs)}
+    , framesPerUpdate_{8}
+    , txState_{TX_IDLE}
+    , rxState_{RX_IDLE}
+    , hasMessage_{false}
+    , flowPending_{false}
+    , sentMessages_{0}
+    , receivedMessages_{0}
+    , failures_{0}
+  {}
+
+  void setIds(uint32_t txId, uint32_t rxId) { txId_ = txId; rxId_ = rxId; }
+
+  // Det vi ber motparten om når vi tar imot
+  void setFlowControl(uint8_t blockSize, uint32_t stMinUs) { blockSize_ = blockSize; stMin_ = encodeStMin(stMinUs); }
+  void setFramesPerUpdate(uint8_t frames) { framesPerUpdate_ = frames > 0 ? frames : 1; }
+
+  // Starter en overføring. Data kopieres, så kalleren kan gjenbruke bufferen.
+  bool send(const uint8_t* data, uint16_t len, uint32_t nowUs)
+  {
+    if (txState_ != TX_IDLE || len == 0 || len > maxMessage) return false;
+
+    uint8_t frame[8];
+    if (len <= 7)
+    {
+      frame[0] = len;
+      memcpy(frame + 1, data, len);
+      if (!send_(context_, txId_, frame, len + 1)) return false;
+      sentMessages_++;
+      return true;
+    }
+
+    memcpy(txBuffer_, data, len);
+    txLength_ = len;
+    frame[0] = 0x10 | (len >> 8);
+    frame[1] = len & 0xff;
+    memcpy(frame + 2, txBuffer_, 6);
+    if (!send_(context_, txId_, frame, 8)) return false;
+    txPos_ = 6;
+    txSeq_ = 1;
+    txState_ = TX_WAIT_FLOW;
+    txDeadlineUs_ = nowUs + timeoutMs * 1000;
+    return true;
+  }
+
+  bool isSending() const { return txState_ != TX_IDLE; }
+
+  // Sender consecutive frames når flow control og STmin tillater det, og sjekker timeouts
+  void update(uint32_t nowUs)
+  {
+    if (txState_ == TX_WAIT_FLOW && (int32_t)(nowUs - txDeadlineUs_) >= 0)
+    {
+      txState_ = TX_IDLE; // mottakeren svarer ikke
+      failures_++;
+    }
+    if (rxState_ == RX_RECEIVING && (int32_t)(nowUs - rxDeadlineUs_) >= 0)
+    {
+      rxState_ = RX_IDLE; // senderen har stoppet midt i
+      failures_++;
+    }
+    if (flowPending_) sendFlowControl(pendingFlowStatus_);
+
+    for (uint8_t sent = 0; txState_ == TX_SENDING && sent < framesPerUpdate_; sent++)
+    {
+      if ((int32_t)(nowUs - txNextUs_) < 0) return;
+
+      uint8_t frame[8];
+      uint16_t chunk = txLength_ - txPos_ < 7 ? txLength_ - txPos_ : 7;
+      frame[0] = 0x20 | txSeq_;
+      memcpy(frame + 1, txBuffer_ + txPos_, chunk);
+      if (!send_(context_, txId_, frame, chunk + 1)) return; // sendekøen er full
+
+      txPos_ += chunk;
+      txSeq_ = (txSeq_ + 1) & 0x0f;
+      txNextUs_ = nowUs + txStMinUs_;
+      if (txPos_ >= txLength_)
+      {
+        txState_ = TX_IDLE;
+        sentMessages_++;
+      }
+      else if (txBlockSize_ != 0 && ++txBlockCount_ >= txBlockSize_)
+      {
+        txState_ = TX_WAIT_FLOW;
+        txDeadlineUs_ = nowUs + timeoutMs * 1000;
+      }
+    }
+  }
+
+  // Kalles for hver mottatt ramme. Returnerer true hvis rammen var vår (rxId).
+  bool receive(uint32_t id, const uint8_t* data, uint8_t len, uint32_t nowUs)
+  {
+    if (id != rxId_ || len < 1) return false;
+
+    switch (data[0] >> 4)
+    {
+      case 0: receiveSingle(data, len); break;
+      case 1: receiveFirst(data, len, nowUs); break;
+      case 2: receiveConsecutive(data, len, nowUs); break;
+      case 3: receiveFlowControl(data, len, nowUs); break;
+      default: break;
+    }
+    return true;
+  }
+
+  // Ferdig mottatt melding. Ligger der til release(), og nye meldinger blir avvist imens.
+  bool hasMessage() const { return hasMessage_; }
+  const uint8_t* message() const { return rxBuffer_; }
+  uint16_t messageLength() const { return rxLength_; }
+  void release() { hasMessage_ = false; }
+
+  uint32_t sentMessages() const { return sentMessages_; }
+  uint32_t receivedMessages() const { return receivedMessages_; }
+  uint32_t failures() const { return failures_; }
+
+  // STmin: 0-127 ms, eller 100-900 us som 0xF1-0xF9
+  static uint8_t encodeStMin(uint32_t stMinUs)
+  {
+    if (stMinUs == 0) return 0;
+    if (stMinUs <= 900) return 0xF0 + (stMinUs + 99) / 100;
+    return stMinUs >= 127000 ? 127 : (stMinUs + 999) / 1000;
+  }
+
+  static uint32_t decodeStMin(uint8_t stMin)
+  {
+    if (stMin <= 0x7F) return stMin * 1000;
+    if (stMin >= 0xF1 && stMin <= 0xF9) return (stMin - 0xF0) * 100;
+    return 127000; // reservert: tregeste lovlige verdi
+  }
+
+  private:
+  enum TxState : uint8_t
+  {
+    TX_IDLE,
+    TX_WAIT_FLOW,
+    TX_SENDING
+  };
+
+  enum RxState : uint8_t
+  {
+    RX_IDLE,
+    RX_RECEIVING
+  };
+
+  // Kom den ikke i sendekøen prøves den igjen i update(), ellers venter senderen til timeout
+  void sendFlowControl(FlowStatus status)
+  {
+    uint8_t frame[3] = {(uint8_t)(0x30 | status), blockSize_, stMin_};
+    flowPending_ = !send_(context_, txId_, frame, 3);
+    pendingFlowStatus_ = status;
+  }
+
+  void receiveSingle(const uint8_t* data, uint8_t len)
+  {
+    uint8_t length = data[0] & 0x0f;
+    if (length == 0 || length > 7 || length + 1 > len || hasMessage_) return;
+    memcpy(rxBuffer_, data + 1, length);
+    rxLength_ = length;
+    rxState_ = RX_IDLE;
+    deliver();
+  }
+
+  void receiveFirst(const uint8_t* data, uint8_t len, uint32_t nowUs)
+  {
+    if (len < 8) return;
+    uint16_t length = ((data[0] & 0x0f) << 8) | data[1];
+    if (length <= 7) return; // skulle vært single frame
+    if (length > maxMessage || hasMessage_)
+    {
+      sendFlowControl(FLOW_OVERFLOW);
+      return;
+    }
+    memcpy(rxBuffer_, data + 2, 6);
+    rxLength_ = length;
+    rxPos_ = 6;
+    rxSeq_ = 1;
+    rxBlockCount_ = 0;
+    rxState_ = RX_RECEIVING;
+    rxDeadlineUs_ = nowUs + timeoutMs * 1000;
+    sendFlowControl(FLOW_CONTINUE);
+  }
+
+  void receiveConsecutive(const uint8_t* data, uint8_t len, uint32_t nowUs)
+  {
+    if (rxState_ != RX_RECEIVING) return;
+    if ((data[0] & 0x0f) != rxSeq_)
+    {
+      rxState_ = RX_IDLE; // tapt ramme, hele meldingen må sendes på nytt
+      failures_++;
+      return;
+    }
+
+    uint16_t chunk = rxLength_ - rxPos_ < 7 ? rxLength_ - rxPos_ : 7;
+    if (len < chunk + 1) return;
+    memcpy(rxBuffer_ + rxPos_, data + 1, chunk);
+    rxPos_ += chunk;
+    rxSeq_ = (rxSeq_ + 1) & 0x0f;
+    rxDeadlineUs_ = nowUs + timeoutMs * 1000;
+
+    if (rxPos_ >= rxLength_)
+    {
+      rxState_ = RX_IDLE;
+      deliver();
+    }
+    else if (blockSize_ != 0 && ++rxBlockCount_ >= blockSize_)
+    {
+      rxBlockCount_ = 0;
+      sendFlowControl(FLOW_CONTINUE);
+    }
+  }
+
+  void receiveFlowControl(const uint8_t* data, uint8_t len, uint32_t nowUs)
+  {
+    if (txState_ != TX_WAIT_FLOW || len < 3) return;
+    switch (data[0] & 0x0f)
+    {
+      case FLOW_CONTINUE:
+        txBlockSize_ = data[1];
+        txStMinUs_ = decodeStMin(data[2]);
+        txBlockCount_ = 0;
+        txNextUs_ = nowUs;
+        txState_ = TX_SENDING;
+        break;
+      case FLOW_WAIT:
+        txDeadlineUs_ = nowUs + timeoutMs * 1000;
+        break;
+      default:
+        txState_ = TX_IDLE; // for stor for mottakeren
+        failures_++;
+        break;
+    }
+  }
+
+  void deliver()
+  {
+    hasMessage_ = true;
+    receivedMessages_++;
+  }
+
+  SendFunction send_;
+  void* context_;
+  uint32_t txId_;
+  uint32_t rxId_;
+  uint8_t blockSize_;
+  uint8_t stMin_;
+  uint8_t framesPerUpdate_;
+
+  TxState txState_;
+  uint8_t txBuffer_[maxMessage];
+  uint16_t txLength_;
+  uint16_t txPos_;
+  uint8_t txSeq_;
+  uint8_t txBlockSize_;
+  uint8_t txBlockCount_;
+  uint32_t txStMinUs_;
+  uint32_t txNextUs_;
+  uint32_t txDeadlineUs_;
+
+  RxState rxState_;
+  uint8_t rxBuffer_[maxMessage];
+  uint16_t rxLength_;
+  uint16_t rxPos_;
+  uint8_t rxSeq_;
+  uint8_t rxBlockCount_;
+  uint32_t rxDeadlineUs_;
+  bool hasMessage_;
+  bool flowPending_;
+  FlowStatus pendingFlowStatus_;
+
+  uint32_t sentMessages_;
+  uint32_t receivedMessages_;
+  uint32_t failures_;
+};
+
+#endif
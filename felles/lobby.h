@@ -0,0 +1,128 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include <stdint.h>
+#include "canmessages.h"
+
+/*
+ * Lobby: noder melder seg på bussen og får tildelt kamp og ID-blokk av matchmakeren
+ * (del3/matchmaker.cpp), i stedet for at gruppenummeret er kompilert inn.
+ *
+ * Melding fra node (utvidet ID (0x7F0 << 18) | node-ID, lavest prioritet på bussen), hvert announcePeriodMs:
+ *   [tilstand (0 ledig, 1 i kamp), rolle, blokk lav, blokk høy]
+ * Node-ID-en ligger i ID-en, så to noder sender aldri samme ID (de ville kollidert i datafeltet).
+ *
+ * Tildeling fra matchmakeren (ID 0x7F1, bare matchmakeren sender den):
+ *   [node-ID (3 bytes), blokk lav, blokk høy, rolle (1 = P1, 2 = P2)]
+ * Blokken er basen som alle ID-ene i kampen regnes fra. P1 bruker blokk som sitt gruppenummer
+ * og P2 blokk + roleSpacing, slik CanBusHandler(gruppe, motstander) vil ha det. Offsetene i
+ * felles/canmessages.h går fra 10 (rollefordeling) til 111 (ISO-TP), så med roleSpacing over
+ * det spennet bruker P1 og P2 aldri samme ID, heller ikke ISO-TP-paret. Blokkene ligger
+ * blockSpacing fra hverandre, så P2 i én blokk når heller ikke P1 i neste.
+ *
+ * Noden gjentar "ledig" til tildelingen kommer, og matchmakeren svarer på hver melding,
+ * så en tapt ramme koster bare én periode.
+ */
+
+class LobbyClient
+{
+  public:
+  static const uint32_t idAnnounceBase = 0x7F0;        // de 11 øverste bitene av den utvidede ID-en
+  static const uint32_t idAssign = 0x7F1;
+  static const uint32_t nodeIdMask = (1u << 18) - 1;
+  static const uint16_t firstBlock = 0x200;
+  static const uint16_t roleSpacing = 0x80;           // P2 = blokk + roleSpacing
+  static const uint16_t blockSpacing = 0x100;
+  static const int maxBlocks = 6;                      // P2 i siste blokk + 111 er under 0x7F0
+
+  // Laveste og høyeste offset i felles/canmessages.h
+  static const uint16_t lowestOffset = CanRoleClaim::offset;
+  static const uint16_t highestOffset = CanBulkFromNode::offset;
+
+  static_assert(highestOffset < roleSpacing + lowestOffset, "P1 og P2 i samme blokk får felles ID-er");
+  static_assert(roleSpacing + highestOffset < blockSpacing + lowestOffset, "P2 når P1 i neste blokk");
+  static_assert(firstBlock + (maxBlocks - 1) * blockSpacing + roleSpacing + highestOffset < idAnnounceBase,
+                "siste blokk går inn i lobby-ID-ene");
+
+  enum State : uint8_t
+  {
+    LOBBY_IDLE = 0,
+    LOBBY_IN_MATCH = 1
+  };
+
+  LobbyClient(uint32_t nodeId, uint32_t announcePeriodMs = 200)
+    : nodeId_{nodeId & nodeIdMask}
+    , announcePeriodMs_{announcePeriodMs}
+    , lastAnnounceMs_{0}
+    , announcedOnce_{false}
+    , assigned_{false}
+    , inMatch_{false}
+    , block_{0}
+    , role_{0}
+  {}
+
+  // Melding som skal sendes nå (utvidet ID), hvis det er tid
+  bool pollAnnounce(uint32_t nowMs, uint32_t& id, uint8_t* data, uint8_t& len)
+  {
+    if (announcedOnce_ && nowMs - lastAnnounceMs_ < announcePeriodMs_) return false;
+    announcedOnce_ = true;
+    lastAnnounceMs_ = nowMs;
+    id = (idAnnounceBase << 18) | nodeId_;
+    data[0] = inMatch_ ? LOBBY_IN_MATCH : LOBBY_IDLE;
+    data[1] = role_;
+    data[2] = block_ & 0xff;
+    data[3] = block_ >> 8;
+    len = 4;
+    return true;
+  }
+
+  // Tildeling fra matchmakeren. Returnerer true første gang vi får en kamp.
+  bool receive(uint32_t id, const uint8_t* data, uint8_t len)
+  {
+    if (id != idAssign || len < 6) return false;
+    uint32_t nodeId = data[0] | (data[1] << 8) | ((uint32_t)data[2] << 16);
+    if (nodeId != nodeId_ || data[5] < 1 || data[5] > 2) return false;
+
+    bool isNew = !assigned_;
+    assigned_ = true;
+    block_ = data[3] | (data[4] << 8);
+    role_ = data[5];
+    return isNew;
+  }
+
+  // Settes når spillet er i gang, så matchmakeren holder blokken reservert
+  void setInMatch(bool inMatch) { inMatch_ = inMatch; }
+
+  bool isAssigned() const { return assigned_; }
+  uint16_t block() const { return block_; }
+  uint8_t role() const { return role_; }
+  uint16_t ownGroupNumber() const { return role_ == 2 ? block_ + roleSpacing : block_; }
+  uint16_t enemyGroupNumber() const { return role_ == 2 ? block_ : block_ + roleSpacing; }
+  uint32_t nodeId() const { return nodeId_; }
+
+  // For matchmakeren
+  static bool isAnnounceId(uint32_t extendedId) { return (extendedId >> 18) == idAnnounceBase; }
+  static uint32_t nodeIdFromAnnounce(uint32_t extendedId) { return extendedId & nodeIdMask; }
+  static uint8_t makeAssign(uint32_t nodeId, uint16_t block, uint8_t role, uint8_t* data)
+  {
+    data[0] = nodeId & 0xff;
+    data[1] = (nodeId >> 8) & 0xff;
+    data[2] = (nodeId >> 16) & 0xff;
+    data[3] = block & 0xff;
+    data[4] = block >> 8;
+    data[5] = role;
+    return 6;
+  }
+
+  private:
+  uint32_t nodeId_;
+  uint32_t announcePeriodMs_;
+  uint32_t lastAnnounceMs_;
+  bool announcedOnce_;
+  bool assigned_;
+  bool inMatch_;
+  uint16_t block_;
+  uint8_t role_;
+};
+
+#endif
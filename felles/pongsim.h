@@ -0,0 +1,153 @@
+#ifndef PONGSIM_H
+#define PONGSIM_H
+
+#include <stdint.h>
+
+/*
+ * Deterministisk simulering av pong for to-Teensy-modusen (Lars/EndeligPingPong.cpp).
+ *
+ * Samme regler som updateGameLogic(), men all tilstand ligger i én struct og ett steg
+ * avhenger bare av tilstanden og de to inputene. Da kan begge nodene kjøre spillet selv,
+ * ta vare på kopier av tilstanden og spole tilbake (se rollback.h).
+ *
+ * Koordinatene er alltid sett fra P1: P1 er høyre plate, P2 venstre. P2 speiler X når den tegner.
+ * Bare heltall, så resultatet blir likt på alle noder.
+ */
+
+// Input per tick, samme verdier som joystick-rammene ellers i prosjektet
+enum PongMove : uint8_t
+{
+  MOVE_NONE = 0,
+  MOVE_UP = 1,
+  MOVE_DOWN = 2
+};
+
+struct PongSim
+{
+  static const int screenWidth = 128;
+  static const int screenHeight = 64;
+  static const int plateHeight = 20;
+  static const int plateWidth = 4;
+  static const int plateSpeed = 2;
+  static const int ballRadius = 3;
+  static const int winningScore = 5;
+  static const int pauseAfterScoreTicks = 200; // 2 s, i stedet for delay(2000)
+
+  int16_t xBall;
+  int16_t yBall;
+  int8_t xVelocity;
+  int8_t yVelocity;
+  int16_t plateP1;
+  int16_t plateP2;
+  uint8_t scoreP1;
+  uint8_t scoreP2;
+  uint16_t pauseTicks;
+  bool gameOver;
+  uint32_t tick;
+
+  void reset()
+  {
+    xBall = screenWidth / 2;
+    yBall = screenHeight / 2;
+    xVelocity = 1; // Start mot P1
+    yVelocity = 1;
+    plateP1 = 22;
+    plateP2 = 22;
+    scoreP1 = 0;
+    scoreP2 = 0;
+    pauseTicks = 0;
+    gameOver = false;
+    tick = 0;
+  }
+
+  // FNV-1a over alle feltene i fast rekkefølge (ikke structen direkte, den har padding).
+  // Brukes for å sjekke at to noder har samme tilstand (se EndeligPingPong.cpp).
+  uint32_t hash() const
+  {
+    uint32_t h = 2166136261u;
+    const int32_t fields[] = {xBall, yBall, xVelocity, yVelocity, plateP1, plateP2,
+                              scoreP1, scoreP2, pauseTicks, gameOver, (int32_t)tick};
+    for (int32_t field : fields)
+    {
+      for (int i = 0; i < 4; i++)
+      {
+        h ^= (uint8_t)(field >> (8 * i));
+        h *= 16777619u;
+      }
+    }
+    return h;
+  }
+
+  static int16_t movePlate(int16_t position, uint8_t move)
+  {
+    if (move == MOVE_UP) position = position - plateSpeed < 0 ? 0 : position - plateSpeed;
+    if (move == MOVE_DOWN) position = position + plateSpeed > screenHeight - plateHeight ? screenHeight - plateHeight : position + plateSpeed;
+    return position;
+  }
+
+  void step(uint8_t moveP1, uint8_t moveP2)
+  {
+    tick++;
+    if (gameOver) return;
+
+    plateP1 = movePlate(plateP1, moveP1);
+    plateP2 = movePlate(plateP2, moveP2);
+
+    // Pause etter poeng: platene kan flyttes, ballen står
+    if (pauseTicks > 0)
+    {
+      pauseTicks--;
+      return;
+    }
+
+    xBall += xVelocity;
+    yBall += yVelocity;
+
+    // Kollisjon høyre plate (P1)
+    int plateX = screenWidth - plateWidth;
+    if (xBall + ballRadius >= plateX && yBall >= plateP1 && yBall <= plateP1 + plateHeight && xVelocity > 0)
+    {
+      xVelocity = -xVelocity;
+      xBall = plateX - ballRadius;
+    }
+
+    // Kollisjon venstre plate (P2)
+    if (xBall - ballRadius <= plateWidth && yBall >= plateP2 && yBall <= plateP2 + plateHeight && xVelocity < 0)
+    {
+      xVelocity = -xVelocity;
+      xBall = plateWidth + ballRadius;
+    }
+
+    // Vegger
+    if (yBall - ballRadius <= 0 && yVelocity < 0)
+    {
+      yVelocity = -yVelocity;
+      yBall = ballRadius;
+    }
+    else if (yBall + ballRadius >= screenHeight && yVelocity > 0)
+    {
+      yVelocity = -yVelocity;
+      yBall = screenHeight - ballRadius;
+    }
+
+    // Poeng
+    if (xBall - ballRadius > screenWidth || xBall + ballRadius < 0)
+    {
+      if (xBall - ballRadius > screenWidth) scoreP2++; // P2 (venstre) scorer
+      else scoreP1++;                                  // P1 (høyre) scorer
+
+      if (scoreP1 >= winningScore || scoreP2 >= winningScore)
+      {
+        gameOver = true;
+        return;
+      }
+      pauseTicks = pauseAfterScoreTicks;
+      xBall = screenWidth / 2;
+      yBall = screenHeight / 2;
+      xVelocity = -1; // Serve alltid mot P2
+      yVelocity = 1;
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef RELIABLEEVENTS_H
+#define RELIABLEEVENTS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "canmessages.h"
+
+/*
+ * Pålitelig levering av viktige hendelser (score, reset, rolleclaim) over CAN.
+ * Brukes både på Teensy og på Linux, derfor bare standard C++ og ingen Arduino/Linux-header.
+ * Alt ligger i headeren slik at Arduino kan bruke den uten å kompilere en ekstra .cpp.
+ *
+ * Protokoll:
+ *  - Hendelsen sendes på sin vanlige ID, med et sekvensnummer som SISTE byte.
+ *    Feks. score 57: [scoreP1, scoreP2, seq], reset 58: [1, seq].
+ *  - Mottakeren svarer med en ack på sin egen ack-ID: [hendelses-ID lav, hendelses-ID høy, seq]
+ *    (CanEventAckP1/P2 i felles/canmessages.h).
+ *    Hver node har egen ack-ID slik at to noder aldri sender samme ID samtidig.
+ *  - Senderen sender på nytt hvert retransmitMs til den får ack (maks maxAttempts ganger).
+ *  - Mottakeren husker siste seq per ID og gir ikke videre duplikater (men acker dem igjen).
+ *  - Ny hendelse på samme ID før forrige er acket erstatter den gamle (nyeste score gjelder).
+ */
+
+class ReliableEvents
+{
+  public:
+  typedef void (*SendFunction)(uint32_t id, const uint8_t* data, uint8_t len);
+
+  static const int maxEventIds = 6;     // antall ulike hendelses-ID-er
+  static const int maxPayload = 7;      // 8 bytes minus sekvensnummeret
+
+  ReliableEvents(SendFunction send, uint32_t ackId)
+    : send_{send}
+    , ackId_{ackId}
+    , retransmitMs_{10}
+    , maxAttempts_{50}
+    , eventCount_{0}
+    , retransmissions_{0}
+    , duplicates_{0}
+    , failures_{0}
+  {}
+
+  // Startverdi for sekvensnumrene. Bruk noe som varierer mellom oppstarter (feks. micros())
+  // slik at mottakeren ikke tror første hendelse etter en omstart er et duplikat.
+  void begin(uint8_t seed)
+  {
+    for (int i = 0; i < eventCount_; i++) events_[i].nextSeq = seed + i;
+  }
+
+  void setAckId(uint32_t ackId) { ackId_ = ackId; }
+  void setRetransmit(uint16_t retransmitMs, uint8_t maxAttempts) { retransmitMs_ = retransmitMs; maxAttempts_ = maxAttempts; }
+
+  // Registrerer en ID som hendelse. Begge sider må registrere de samme ID-ene.
+  bool addEventId(uint32_t id)
+  {
+    if (find(id) != nullptr) return true;
+    if (eventCount_ >= maxEventIds) return false;
+    Event& event = events_[eventCount_++];
+    memset(&event, 0, sizeof(event));
+    event.id = id;
+    event.nextSeq = eventCount_;
+    return true;
+  }
+
+  bool isEventId(uint32_t id) { return find(id) != nullptr; }
+
+  bool send(uint32_t id, const uint8_t* data, uint8_t len, uint32_t nowMs)
+  {
+    Event* event = find(id);
+    if (event == nullptr || len > maxPayload) return false;
+
+    memcpy(event->data, data, len);
+    event->len = len;
+    event->data[len] = event->nextSeq++;
+    event->pending = true;
+    event->attempts = 1;
+    event->lastSendMs = nowMs;
+    send_(id, event->data, len + 1);
+    return true;
+  }
+
+  // Kalles for hver mottatt ramme. Returnerer true hvis rammen er en NY hendelse som skal
+  // behandles (payloadLen er da lengden uten sekvensnummeret). Acker og duplikater gir false.
+  bool receive(uint32_t id, const uint8_t* data, uint8_t len, uint8_t& payloadLen)
+  {
+    if (id == ackId_) return false; // vår egen ack-ID, skal ikke skje
+
+    Event* event = find(id);
+    if (event == nullptr || len < 1) return false;
+
+    uint8_t seq = data[len - 1];
+    uint8_t ack[CanEventAckP1::length];
+    send_(ackId_, ack, CanEventAckP1::encode({id, seq}, ack)); // P1 og P2 har samme innhold
+
+    if (event->hasReceived && event->lastReceivedSeq == seq)
+    {
+      duplicates_++;
+      return false;
+    }
+    event->hasReceived = true;
+    event->lastReceivedSeq = seq;
+    payloadLen = len - 1;
+    return true;
+  }
+
+  // Kalles for rammer på motpartens ack-ID
+  void receiveAck(const uint8_t* data, uint8_t len)
+  {
+    CanEventAck ack;
+    if (!CanEventAckP1::decode(data, len, ack)) return;
+    Event* event = find(ack.eventId);
+    if (event == nullptr || !event->pending) return;
+    if (event->data[event->len] == ack.seq) event->pending = false;
+  }
+
+  // Sender på nytt det som ikke er acket. Kalles hver runde i loopen.
+  void update(uint32_t nowMs)
+  {
+    for (int i = 0; i < eventCount_; i++)
+    {
+      Event& event = events_[i];
+      if (!event.pending || (uint32_t)(nowMs - event.lastSendMs) < retransmitMs_) continue;
+
+      if (event.attempts >= maxAttempts_)
+      {
+        event.pending = false; // motparten er borte, vi gir opp
+        failures_++;
+        continue;
+      }
+      event.attempts++;
+      event.lastSendMs = nowMs;
+      retransmissions_++;
+      send_(event.id, event.data, event.len + 1);
+    }
+  }
+
+  bool isPending(uint32_t id) { Event* event = find(id); return event != nullptr && event->pending; }
+
+  uint32_t retransmissions() const { return retransmissions_; }
+  uint32_t duplicates() const { return duplicates_; }
+  uint32_t failures() const { return failures_; }
+
+  private:
+  struct Event
+  {
+    uint32_t id;
+    uint8_t data[maxPayload + 1];
+    uint8_t len;
+    uint8_t nextSeq;
+    bool pending;
+    uint8_t attempts;
+    uint32_t lastSendMs;
+    bool hasReceived;
+    uint8_t lastReceivedSeq;
+  };
+
+  Event* find(uint32_t id)
+  {
+    for (int i = 0; i < eventCount_; i++)
+    {
+      if (events_[i].id == id) return &events_[i];
+    }
+    return nullptr;
+  }
+
+  SendFunction send_;
+  uint32_t ackId_;
+  uint16_t retransmitMs_;
+  uint8_t maxAttempts_;
+
+  Event events_[maxEventIds];
+  int eventCount_;
+
+  uint32_t retransmissions_;
+  uint32_t duplicates_;
+  uint32_t failures_;
+};
+
+#endif
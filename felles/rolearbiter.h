@@ -0,0 +1,201 @@
+#ifndef ROLEARBITER_H
+#define ROLEARBITER_H
+
+#include <stdint.h>
+
+/*
+ * Rollefordeling (P1/P2) mellom to likeverdige noder, uten split-brain.
+ *
+ * Før: den som beveget joysticken først sendte en claim på ID 16 og ble P1. Beveget begge
+ * seg i samme tick trodde begge at de var P1.
+ *
+ * Nå har hver node en nonce (tilfeldig tall eller unik chip-ID) som ligger i en utvidet
+ * 29-bits ID: idBase | (nonce & nonceMask). To rammer kan da aldri ha samme ID (da ville
+ * de kollidert i datafeltet), og CAN-arbitreringen slipper alltid lavest nonce først.
+ *
+ * Ramme: [flagg (bit 0 claim, bit 1 har spill i gang), rolle (0 ingen, 1 P1, 2 P2)]
+ *
+ *  - Én node claimer (joysticken): den andre svarer med rolle P2, claimeren blir P1.
+ *  - Begge claimer samtidig: begge ser begge rammene, lavest nonce blir P1.
+ *  - Ingen svar: claimen sendes på nytt hvert timeoutMs. Etter maxAttempts blir vi P1 alene,
+ *    en node som kommer senere får svar med rollen vår og tar den andre.
+ *  - Så lenge vi ikke har hørt noen sender vi rollen vår hvert aloneAnnouncePeriods * timeoutMs.
+ *    Har begge blitt P1 alene (feks. bussen var nede) ser de det da, og lavest nonce beholder P1.
+ *
+ * Samme nonce på begge (1 av 2^18) gir to like rammer som blir til én på bussen. Da hører
+ * ingen den andre, og nonce trekkes på nytt ved neste forsøk. Kalleren må gi litt tilfeldighet
+ * med addEntropy() (feks. micros() hver runde), ellers trekker begge det samme.
+ *
+ * Bare logikk: kalleren sender rammene fra pollFrame() og gir innkommende til receive().
+ * Brukes av Lars/EndeligPingPong.cpp, og av del3/roletest.cpp for to noder på vcan.
+ */
+
+class RoleArbiter
+{
+  public:
+  enum Role : uint8_t
+  {
+    ROLE_NONE = 0,
+    ROLE_P1 = 1,
+    ROLE_P2 = 2
+  };
+
+  static const uint32_t nonceBits = 18;
+  static const uint32_t nonceMask = (1u << nonceBits) - 1;
+  static const uint8_t frameLength = 2;
+  static const uint8_t flagClaim = 0x01;
+  static const uint8_t flagInGame = 0x02;
+  static const uint32_t aloneAnnouncePeriods = 10;
+
+  // idBase er de 11 øverste bitene av den utvidede ID-en (feks. 16 << 18)
+  RoleArbiter(uint32_t idBase, uint32_t timeoutMs = 100, int maxAttempts = 3)
+    : idBase_{idBase & ~nonceMask}
+    , timeoutMs_{timeoutMs}
+    , maxAttempts_{maxAttempts}
+  {
+    begin(1);
+  }
+
+  void begin(uint32_t nonce)
+  {
+    nonce_ = nonce & nonceMask;
+    if (nonce_ == 0) nonce_ = 1;
+    role_ = ROLE_NONE;
+    claimed_ = false;
+    inGame_ = false;
+    sendPending_ = false;
+    attempts_ = 0;
+    lastSentMs_ = 0;
+    peerNonce_ = 0;
+    joinedRunningGame_ = false;
+    peerHeard_ = false;
+    entropy_ = nonce;
+  }
+
+  void addEntropy(uint32_t value) { entropy_ = entropy_ * 31 + value; }
+
+  // Spilleren vil starte (beveget joysticken). Gjør ingenting hvis rollen er bestemt.
+  void claim(uint32_t nowMs)
+  {
+    if (claimed_ || role_ != ROLE_NONE) return;
+    claimed_ = true;
+    sendPending_ = true;
+    attempts_ = 0;
+    lastSentMs_ = nowMs;
+  }
+
+  // Rollen er bestemt på annen måte (feks. fra motpartens heartbeat etter en restart)
+  void setRole(Role role)
+  {
+    role_ = role;
+    sendPending_ = false;
+  }
+
+  // Settes av spillet, så en node som kommer senere vet at den skal be om tilstanden
+  void setInGame(bool inGame) { inGame_ = inGame; }
+
+  bool isArbitrationId(uint32_t id) const { return (id & ~nonceMask) == idBase_; }
+
+  // Ramme som skal sendes nå (utvidet ID), hvis noen
+  bool pollFrame(uint32_t nowMs, uint32_t& id, uint8_t* data, uint8_t& len)
+  {
+    if (claimed_ && role_ == ROLE_NONE && !sendPending_ && nowMs - lastSentMs_ >= timeoutMs_)
+    {
+      attempts_++;
+      if (attempts_ >= maxAttempts_)
+      {
+        role_ = ROLE_P1; // ingen andre på bussen
+        return false;
+      }
+      if (!peerHeard_) nonce_ = nextNonce(nonce_ ^ entropy_); // kan ha vært lik nonce
+      sendPending_ = true;
+    }
+    if (role_ != ROLE_NONE && !peerHeard_ && nowMs - lastSentMs_ >= aloneAnnouncePeriods * timeoutMs_) sendPending_ = true;
+    if (!sendPending_) return false;
+
+    sendPending_ = false;
+    lastSentMs_ = nowMs;
+    id = idBase_ | nonce_;
+    data[0] = (claimed_ ? flagClaim : 0) | (inGame_ ? flagInGame : 0);
+    data[1] = role_;
+    len = frameLength;
+    return true;
+  }
+
+  void receive(uint32_t id, const uint8_t* data, uint8_t len)
+  {
+    if (!isArbitrationId(id) || len < frameLength) return;
+    uint32_t peerNonce = id & nonceMask;
+    if (peerNonce == nonce_) return; // vår egen (loopback)
+
+    peerHeard_ = true;
+    peerNonce_ = peerNonce;
+    bool peerClaimed = (data[0] & flagClaim) != 0;
+    bool peerInGame = (data[0] & flagInGame) != 0;
+    Role peerRole = (Role)data[1];
+
+    if (role_ != ROLE_NONE)
+    {
+      if (peerRole == ROLE_NONE) sendPending_ = true; // fortell rollen vår
+      else if (peerRole == role_)
+      {
+        // Begge tror de har samme rolle: lavest nonce blir P1, som hos motparten
+        role_ = nonce_ < peerNonce ? ROLE_P1 : ROLE_P2;
+        sendPending_ = true;
+      }
+      return;
+    }
+
+    if (peerRole != ROLE_NONE)
+    {
+      role_ = peerRole == ROLE_P1 ? ROLE_P2 : ROLE_P1;
+      joinedRunningGame_ = peerInGame;
+    }
+    else if (peerClaimed && claimed_)
+    {
+      role_ = nonce_ < peerNonce ? ROLE_P1 : ROLE_P2;
+    }
+    else if (peerClaimed)
+    {
+      role_ = ROLE_P2;
+      sendPending_ = true; // svar så claimeren blir P1 med en gang
+    }
+  }
+
+  Role role() const { return role_; }
+  bool isDecided() const { return role_ != ROLE_NONE; }
+  bool hasClaimed() const { return claimed_; } // vi har claimet, rollen kommer herfra
+  bool joinedRunningGame() const { return joinedRunningGame_; } // motparten hadde et spill i gang
+  uint32_t nonce() const { return nonce_; }
+  uint32_t peerNonce() const { return peerNonce_; }
+
+  private:
+  // xorshift, bare for å få en ny nonce hvis den forrige kan ha vært lik motpartens
+  static uint32_t nextNonce(uint32_t nonce)
+  {
+    uint32_t x = nonce * 2654435761u + 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    x &= nonceMask;
+    return x == 0 ? 1 : x;
+  }
+
+  uint32_t idBase_;
+  uint32_t timeoutMs_;
+  int maxAttempts_;
+
+  uint32_t nonce_;
+  Role role_;
+  bool claimed_;
+  bool inGame_;
+  bool sendPending_;
+  int attempts_;
+  uint32_t lastSentMs_;
+  uint32_t peerNonce_;
+  bool joinedRunningGame_;
+  bool peerHeard_;
+  uint32_t entropy_;
+};
+
+#endif
@@ -0,0 +1,309 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <stdint.h>
+#include "pongsim.h"
+#include "canmessages.h"
+
+/*
+ * Rollback-netcode for to noder som begge kjører PongSim.
+ *
+ * Hver node bruker sin egen input med en gang og sender den til motparten. For ticks
+ * der motpartens input ikke har kommet enda gjetter vi at den er lik den forrige vi fikk.
+ * Tilstanden før hver tick lagres i en ringbuffer. Kommer motpartens input senere og den
+ * ikke stemmer med gjetningen, spoles det tilbake til den ticken og simuleres frem igjen.
+ *
+ * Ringbufferet er historySize ticks (320 ms ved 100 Hz), ~30 bytes per tick, altså rundt 1 kB.
+ * Hvis motparten er mer enn så langt bak, venter vi (canAdvance() gir false) i stedet for
+ * å gjette videre.
+ *
+ * Input-ramme på CAN (CanInputP1/P2, sendes hver runde i loopen, også når vi venter):
+ *   [spill-nr, start-tick lav, høy, ack lav, høy, input(start), input(start+1), input(start+2)]
+ * ack er første tick vi mangler fra motparten. Rammen starter normalt på de tre siste
+ * ticksene, men hvis motparten mangler noe eldre starter den der, så hull blir fylt.
+ * Input 0xff betyr at ticken ikke er simulert enda. Spill-nr økes ved hver reset, så
+ * rammer fra forrige spill blir ignorert.
+ */
+
+class RollbackSession
+{
+  public:
+  static const int historySize = 32;
+  static const int inputsPerFrame = 3;   // input0-input2 i CanInputs
+  static const uint8_t inputFrameLength = CanInputP1::length;
+  static const uint8_t noInput = 0xff;
+
+  RollbackSession()
+    : localPlayer_{0}
+    , epoch_{0}
+    , tick_{0}
+    , confirmedTick_{0}
+    , peerAck_{0}
+    , rollbackFrom_{0}
+    , needsRollback_{false}
+    , lastConfirmedMove_{MOVE_NONE}
+    , peerOnline_{true}
+    , rollbacks_{0}
+    , resimulatedTicks_{0}
+    , mispredictions_{0}
+  {
+    sim_.reset();
+  }
+
+  // Starter et nytt spill. localPlayer: 0 = P1, 1 = P2. Med initial fortsetter vi fra en
+  // tilstand (feks. etter at en node har startet på nytt), ellers starter spillet fra begynnelsen.
+  void start(int localPlayer, uint8_t epoch, const PongSim* initial = nullptr)
+  {
+    localPlayer_ = localPlayer;
+    epoch_ = epoch;
+    sim_.reset();
+    if (initial != nullptr)
+    {
+      sim_ = *initial;
+      sim_.tick = 0;
+    }
+    peerOnline_ = true;
+    tick_ = 0;
+    confirmedTick_ = 0;
+    peerAck_ = 0;
+    needsRollback_ = false;
+    lastConfirmedMove_ = MOVE_NONE;
+    for (int i = 0; i < historySize; i++)
+    {
+      history_[i].localInput = MOVE_NONE;
+      remote_[i].valid = false;
+    }
+  }
+
+  const PongSim& state() const { return sim_; }
+  uint32_t tick() const { return tick_; }
+  uint8_t epoch() const { return epoch_; }
+
+  // Alle ticks frem til nå er simulert med ekte input fra begge (ingen gjetning)
+  bool isConfirmed() const { return confirmedTick_ >= tick_; }
+
+  // Vi kan ikke gjette lenger tilbake enn ringbufferet, og motparten må ha fått inputene
+  // våre før de forsvinner fra det
+  bool canAdvance() const
+  {
+    if (!peerOnline_) return true;
+    bool remoteOk = confirmedTick_ >= tick_ || tick_ - confirmedTick_ < (uint32_t)historySize - 1;
+    bool peerOk = peerAck_ >= tick_ || tick_ - peerAck_ < (uint32_t)historySize - 1;
+    return remoteOk && peerOk;
+  }
+
+  // Når motparten er borte (heartbeat-timeout) fortsetter vi alene: gjetningene vi har
+  // brukt blir godtatt, og motpartens plate står stille til den er tilbake.
+  void setPeerOnline(bool online)
+  {
+    if (online == peerOnline_) return;
+    peerOnline_ = online;
+    if (online) return;
+    resolve();
+    for (uint32_t t = confirmedTick_; t < tick_; t++) addRemoteInput(t, history_[t % historySize].remoteUsed);
+  }
+
+  bool isPeerOnline() const { return peerOnline_; }
+
+  // Simulerer én tick med vår input. Returnerer false hvis vi må vente på motparten.
+  bool advance(uint8_t localMove)
+  {
+    if (!canAdvance()) return false;
+    resolve();
+
+    Entry& entry = history_[tick_ % historySize];
+    entry.snapshot = sim_;
+    entry.localInput = localMove;
+    if (!peerOnline_) addRemoteInput(tick_, MOVE_NONE);
+    step(tick_);
+    tick_++;
+    return true;
+  }
+
+  // Input fra motparten for en tick (fra en input-ramme)
+  void addRemoteInput(uint32_t tick, uint8_t move)
+  {
+    if (tick < confirmedTick_ || tick >= confirmedTick_ + historySize) return; // kjent fra før, eller for langt frem
+
+    RemoteInput& remote = remote_[tick % historySize];
+    if (remote.valid && remote.tick == tick) return;
+
+    // Ticken er allerede simulert med en gjetning: sjekk om gjetningen holdt
+    if (tick < tick_ && history_[tick % historySize].remoteUsed != move)
+    {
+      mispredictions_++;
+      if (!needsRollback_ || tick < rollbackFrom_) rollbackFrom_ = tick;
+      needsRollback_ = true;
+    }
+
+    remote.tick = tick;
+    remote.move = move;
+    remote.valid = true;
+
+    while (isRemoteKnown(confirmedTick_))
+    {
+      lastConfirmedMove_ = remote_[confirmedTick_ % historySize].move;
+      confirmedTick_++;
+    }
+  }
+
+  // Leser en input-ramme fra motparten. Rammer fra et annet spill ignoreres.
+  void receiveInputFrame(const uint8_t* data, uint8_t len)
+  {
+    CanInputs frame;
+    if (!CanInputP1::decode(data, len, frame) || frame.epoch != epoch_) return; // P1 og P2 har samme innhold
+
+    uint32_t ack = unwrapTick(frame.ack);
+    if (ack > peerAck_ && ack <= tick_) peerAck_ = ack;
+
+    uint32_t start = unwrapTick(frame.start);
+    const int inputs[inputsPerFrame] = {frame.input0, frame.input1, frame.input2};
+    for (int i = 0; i < inputsPerFrame; i++)
+    {
+      if (inputs[i] != noInput) addRemoteInput(start + i, inputs[i]);
+    }
+  }
+
+  // Lager input-rammen. Sendes hver runde, også når vi står og venter.
+  uint8_t makeInputFrame(uint8_t* data) const
+  {
+    uint32_t start = tick_ >= (uint32_t)inputsPerFrame ? tick_ - inputsPerFrame : 0;
+    if (peerAck_ < start) start = peerAck_;
+
+    int inputs[inputsPerFrame];
+    for (int i = 0; i < inputsPerFrame; i++)
+    {
+      uint32_t tick = start + i;
+      inputs[i] = tick < tick_ ? history_[tick % historySize].localInput : noInput;
+    }
+    return CanInputP1::encode({epoch_, start, confirmedTick_, inputs[0], inputs[1], inputs[2]}, data);
+  }
+
+  // Spoler tilbake og simulerer frem igjen hvis en gjetning var feil. Kalles før tegning.
+  void resolve()
+  {
+    if (!needsRollback_) return;
+    needsRollback_ = false;
+    if (rollbackFrom_ >= tick_) return;
+
+    rollbacks_++;
+    sim_ = history_[rollbackFrom_ % historySize].snapshot;
+    for (uint32_t t = rollbackFrom_; t < tick_; t++)
+    {
+      history_[t % historySize].snapshot = sim_;
+      step(t);
+      resimulatedTicks_++;
+    }
+  }
+
+  // Bekreftet tilstand ved starten av en tick (ingen gjettede input før den), hvis den
+  // fortsatt ligger i ringbufferet. Brukes til hash-sjekk og resync.
+  bool snapshotAt(uint32_t tick, PongSim& out)
+  {
+    resolve();
+    if (tick > confirmedTick_ || tick > tick_ || tick + historySize <= tick_) return false;
+    out = tick == tick_ ? sim_ : history_[tick % historySize].snapshot;
+    return true;
+  }
+
+  // Siste tick vi har bekreftet tilstand for
+  uint32_t latestConfirmedTick() const { return confirmedTick_ < tick_ ? confirmedTick_ : tick_; }
+
+  // Spillet er over i den bekreftede tilstanden, så det kan ikke spoles tilbake. Krever ikke
+  // at hele tidslinjen er bekreftet (isConfirmed()), det er den sjelden mens begge gjetter fremover.
+  bool isGameOverConfirmed()
+  {
+    PongSim confirmed;
+    return snapshotAt(latestConfirmedTick(), confirmed) && confirmed.gameOver;
+  }
+
+  // Tilstand fra autoriteten (P1) etter en desync. Den erstatter vår tilstand ved samme
+  // tick, og alt etterpå simuleres på nytt med inputene vi har.
+  bool applyAuthoritativeState(const PongSim& state)
+  {
+    uint32_t tick = state.tick;
+    if (tick > tick_ || tick + historySize <= tick_) return false;
+    resolve(); // en ventende tilbakespoling skal ikke overskrive tilstanden etterpå
+    if (tick == tick_)
+    {
+      sim_ = state;
+      return true;
+    }
+    history_[tick % historySize].snapshot = state;
+    if (!needsRollback_ || tick < rollbackFrom_) rollbackFrom_ = tick;
+    needsRollback_ = true;
+    resolve();
+    return true;
+  }
+
+  // 16-bits tick fra en ramme til full tick, nær vår egen
+  uint32_t unwrapTick(uint16_t tick16) const
+  {
+    int16_t diff = (int16_t)(tick16 - (uint16_t)tick_);
+    int64_t full = (int64_t)tick_ + diff;
+    return full < 0 ? 0 : (uint32_t)full;
+  }
+
+  uint32_t rollbacks() const { return rollbacks_; }
+  uint32_t resimulatedTicks() const { return resimulatedTicks_; }
+  uint32_t mispredictions() const { return mispredictions_; }
+
+  private:
+  struct Entry
+  {
+    PongSim snapshot; // tilstanden FØR ticken
+    uint8_t localInput;
+    uint8_t remoteUsed; // motpartens input (ekte eller gjettet) ticken ble simulert med
+  };
+
+  struct RemoteInput
+  {
+    uint32_t tick;
+    uint8_t move;
+    bool valid;
+  };
+
+  bool isRemoteKnown(uint32_t tick) const
+  {
+    const RemoteInput& remote = remote_[tick % historySize];
+    return remote.valid && remote.tick == tick;
+  }
+
+  // Ekte input hvis vi har den, ellers siste kjente (joysticken holdes som regel en stund)
+  uint8_t predictRemote(uint32_t tick) const
+  {
+    if (isRemoteKnown(tick)) return remote_[tick % historySize].move;
+    return lastConfirmedMove_;
+  }
+
+  void step(uint32_t tick)
+  {
+    Entry& entry = history_[tick % historySize];
+    uint8_t local = entry.localInput;
+    uint8_t remote = predictRemote(tick);
+    entry.remoteUsed = remote;
+    if (localPlayer_ == 0) sim_.step(local, remote);
+    else sim_.step(remote, local);
+  }
+
+  PongSim sim_;
+  int localPlayer_;
+  uint8_t epoch_;
+
+  Entry history_[historySize];
+  RemoteInput remote_[historySize];
+
+  uint32_t tick_;          // neste tick som skal simuleres
+  uint32_t confirmedTick_; // første tick der vi mangler motpartens input
+  uint32_t peerAck_;       // første tick motparten mangler fra oss
+  uint32_t rollbackFrom_;
+  bool needsRollback_;
+  uint8_t lastConfirmedMove_;
+  bool peerOnline_;
+
+  uint32_t rollbacks_;
+  uint32_t resimulatedTicks_;
+  uint32_t mispredictions_;
+};
+
+#endif
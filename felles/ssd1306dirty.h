@@ -0,0 +1,193 @@
+#ifndef SSD1306DIRTY_H
+#define SSD1306DIRTY_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Sender bare det som har endret seg på SSD1306-skjermen. display() i Adafruit-biblioteket
+ * sender alle 1024 bytes hver gang, men i pong flytter bare ballen og platene seg, og det er
+ * noen titalls bytes per ramme.
+ *
+ * Vi har en kopi av det kontrolleren viser (shadow_). For hver side (8 rader) finner render()
+ * kolonnene som er ulike, og sender dem som et vindu:
+ *   [0x21, første kolonne, siste kolonne, 0x22, første side, siste side]  kommando (DC lav)
+ *   bytesene i vinduet, side for side                                      data (DC høy)
+ * Kontrolleren må stå i horisontal adressering (det gjør den etter display.begin()).
+ *
+ * Et vindu koster windowCommandBytes bytes kommando, så to endringer på samme side med færre
+ * like bytes mellom seg sendes som ett vindu. Vinduer med samme kolonner på sider etter
+ * hverandre (ballen over en sidegrense, en plate) slås sammen til ett vindu over flere sider.
+ * Blir det likevel flere bytes enn hele skjermen (skjermbytte, GAME OVER), sendes hele.
+ *
+ * Første render() og render() etter invalidate() sender hele skjermen. invalidate() må
+ * kalles hvis noen andre har skrevet til kontrolleren (display.display(), begin()).
+ *
+ * Bare logikk: skrivefunksjonen gjør SPI-en (felles/ssd1306spi.h på Teensyen). Hver render()
+ * er én OLED_SELECT, så OLED_COMMAND/OLED_DATA for vinduene, og én OLED_DESELECT, også når
+ * ingenting er endret.
+ */
+
+class Ssd1306DirtyRenderer
+{
+  public:
+  enum Transfer : uint8_t
+  {
+    OLED_SELECT,   // CS lav
+    OLED_COMMAND,  // DC lav, så bytesene
+    OLED_DATA,     // DC høy, så bytesene
+    OLED_DESELECT  // CS høy
+  };
+
+  typedef void (*WriteFunction)(void* context, uint8_t transfer, const uint8_t* bytes, uint16_t len);
+
+  static const uint8_t width = 128;
+  static const uint8_t pages = 8;    // 64 rader
+  static const uint16_t frameBytes = width * pages;
+  static const uint8_t windowCommandBytes = 6;
+  static const uint8_t maxWindows = 32; // flere enn dette blir hele skjermen
+
+  Ssd1306DirtyRenderer(WriteFunction write, void* context)
+    : write_{write}
+    , context_{context}
+    , valid_{false}
+    , windowCount_{0}
+    , frames_{0}
+    , fullFrames_{0}
+    , windows_{0}
+    , bytes_{0}
+  {
+    memset(shadow_, 0, sizeof(shadow_));
+  }
+
+  void invalidate() {valid_ = false;}
+
+  // buffer er display.getBuffer(): width * pages bytes, samme format som kontrolleren
+  void render(const uint8_t* buffer)
+  {
+    frames_++;
+    write_(context_, OLED_SELECT, nullptr, 0);
+
+    if (!valid_ || !findWindows(buffer))
+    {
+      sendWindow({0, width - 1, 0, pages - 1}, buffer, true);
+      fullFrames_++;
+      valid_ = true;
+    }
+    else
+    {
+      for (uint8_t i = 0; i < windowCount_; i++) sendWindow(windowList_[i], buffer, false);
+    }
+
+    write_(context_, OLED_DESELECT, nullptr, 0);
+    memcpy(shadow_, buffer, frameBytes);
+  }
+
+  uint32_t frames() const {return frames_;}
+  uint32_t fullFrames() const {return fullFrames_;}
+  uint32_t windows() const {return windows_;}
+  uint32_t bytes() const {return bytes_;}  // kommando og data
+
+  private:
+  struct Window
+  {
+    uint8_t firstColumn;
+    uint8_t lastColumn;
+    uint8_t firstPage;
+    uint8_t lastPage;
+  };
+
+  // Fyller windowList_. Returnerer false hvis hele skjermen blir billigere (eller for mange vinduer).
+  bool findWindows(const uint8_t* buffer)
+  {
+    windowCount_ = 0;
+    uint32_t cost = 0;
+
+    for (uint8_t page = 0; page < pages; page++)
+    {
+      const uint8_t* row = buffer + page * width;
+      const uint8_t* shadowRow = shadow_ + page * width;
+      uint8_t pageFirst = windowCount_;
+      int16_t column = 0;
+
+      while (column < width)
+      {
+        if (row[column] == shadowRow[column])
+        {
+          column++;
+          continue;
+        }
+
+        // Et løp med endringer, der korte strekk med like bytes tas med
+        uint8_t first = column;
+        uint8_t last = column;
+        for (column++; column < width; column++)
+        {
+          if (row[column] != shadowRow[column]) last = column;
+          else if (column - last > windowCommandBytes) break;
+        }
+
+        // Samme kolonner på forrige side: vinduet fortsetter nedover
+        bool extended = false;
+        for (uint8_t i = 0; i < pageFirst; i++)
+        {
+          Window& above = windowList_[i];
+          if (above.lastPage + 1 == page && above.firstColumn == first && above.lastColumn == last)
+          {
+            above.lastPage = page;
+            cost += last - first + 1;
+            extended = true;
+            break;
+          }
+        }
+        if (extended) continue;
+
+        if (windowCount_ == maxWindows) return false;
+        windowList_[windowCount_++] = {first, last, page, page};
+        cost += windowCommandBytes + last - first + 1;
+      }
+
+      if (cost >= windowCommandBytes + frameBytes) return false;
+    }
+    return true;
+  }
+
+  void sendWindow(const Window& window, const uint8_t* buffer, bool whole)
+  {
+    const uint8_t commands[windowCommandBytes] = {
+      0x21, window.firstColumn, window.lastColumn,  // COLUMNADDR
+      0x22, window.firstPage, window.lastPage       // PAGEADDR
+    };
+    write_(context_, OLED_COMMAND, commands, windowCommandBytes);
+    bytes_ += windowCommandBytes;
+    windows_++;
+
+    if (whole)
+    {
+      write_(context_, OLED_DATA, buffer, frameBytes);
+      bytes_ += frameBytes;
+      return;
+    }
+
+    // Horisontal adressering: kontrolleren går til neste side etter siste kolonne
+    uint8_t columns = window.lastColumn - window.firstColumn + 1;
+    for (uint8_t page = window.firstPage; page <= window.lastPage; page++)
+    {
+      write_(context_, OLED_DATA, buffer + page * width + window.firstColumn, columns);
+      bytes_ += columns;
+    }
+  }
+
+  WriteFunction write_;
+  void* context_;
+  bool valid_;
+  uint8_t shadow_[frameBytes];
+  Window windowList_[maxWindows];
+  uint8_t windowCount_;
+  uint32_t frames_;
+  uint32_t fullFrames_;
+  uint32_t windows_;
+  uint32_t bytes_;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SSD1306SPI_H
+#define SSD1306SPI_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "ssd1306dirty.h"
+
+/*
+ * Ssd1306DirtyRenderer koblet til SPI-en på Teensyen, for skissene (derfor Arduino.h her,
+ * resten av felles/ er vanlig C++). Samme pinner som Adafruit_SSD1306 er laget med:
+ *
+ *   Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &SPI, OLED_DC, OLED_RESET, OLED_CS);
+ *   Ssd1306Spi oled(SPI, OLED_DC, OLED_CS);
+ *   ...
+ *   oled.show(display);   // i stedet for display.display()
+ *
+ * Hvert bilde er én SPI-transaksjon med CS lav, DC lav for vinduskommandoene og høy for
+ * dataene, som i biblioteket. Bruker skissen display.display() likevel, må invalidate()
+ * kalles etterpå, ellers stemmer ikke kopien av skjermen lenger.
+ */
+
+class Ssd1306Spi
+{
+  public:
+  Ssd1306Spi(SPIClass& spi, uint8_t dcPin, uint8_t csPin, uint32_t clockHz = 8000000)
+    : spi_{spi}
+    , dcPin_{dcPin}
+    , csPin_{csPin}
+    , clockHz_{clockHz}
+    , renderer_{write, this}
+  {}
+
+  template <typename Display>
+  void show(Display& display) {renderer_.render(display.getBuffer());}
+
+  void invalidate() {renderer_.invalidate();}
+  const Ssd1306DirtyRenderer& renderer() const {return renderer_;}
+
+  private:
+  static void write(void* context, uint8_t transfer, const uint8_t* bytes, uint16_t len)
+  {
+    Ssd1306Spi* self = static_cast<Ssd1306Spi*>(context);
+    switch (transfer)
+    {
+      case Ssd1306DirtyRenderer::OLED_SELECT:
+        self->spi_.beginTransaction(SPISettings(self->clockHz_, MSBFIRST, SPI_MODE0));
+        digitalWrite(self->csPin_, LOW);
+        break;
+      case Ssd1306DirtyRenderer::OLED_COMMAND:
+      case Ssd1306DirtyRenderer::OLED_DATA:
+        digitalWrite(self->dcPin_, transfer == Ssd1306DirtyRenderer::OLED_DATA ? HIGH : LOW);
+        for (uint16_t i = 0; i < len; i++) self->spi_.transfer(bytes[i]);
+        break;
+      case Ssd1306DirtyRenderer::OLED_DESELECT:
+        digitalWrite(self->csPin_, HIGH);
+        self->spi_.endTransaction();
+        break;
+    }
+  }
+
+  SPIClass& spi_;
+  uint8_t dcPin_;
+  uint8_t csPin_;
+  uint32_t clockHz_;
+  Ssd1306DirtyRenderer renderer_;
+};
+
+#endif
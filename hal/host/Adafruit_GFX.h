@@ -0,0 +1,63 @@
+#ifndef HAL_HOST_ADAFRUIT_GFX_H
+#define HAL_HOST_ADAFRUIT_GFX_H
+
+/*
+ * Tegnefunksjonene fra Adafruit_GFX som skissene bruker, med de samme algoritmene
+ * (sirkler, linjer, rektangler), slik at pikslene blir de samme som på Teensyen.
+ * Tekst har ingen font her: hvert tegn blir en fylt 5x7-celle (ganger tekststørrelsen),
+ * så plassering, linjeskift og hvor mye av skjermen som endres stemmer.
+ */
+
+#include "Arduino.h"
+
+class Adafruit_GFX : public Print
+{
+  public:
+  Adafruit_GFX(int16_t w, int16_t h);
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  virtual void fillScreen(uint16_t color);
+  virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+
+  void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+  void setTextSize(uint8_t size) { textsize_x = textsize_y = size > 0 ? size : 1; }
+  void setTextColor(uint16_t color) { textcolor = textbgcolor = color; }
+  void setTextColor(uint16_t color, uint16_t background) { textcolor = color; textbgcolor = background; }
+  void setTextWrap(bool wrap) { this->wrap = wrap; }
+  void setRotation(uint8_t r) { rotation = r & 3; }
+
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+  int16_t getCursorX() const { return cursor_x; }
+  int16_t getCursorY() const { return cursor_y; }
+  uint8_t getRotation() const { return rotation; }
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  protected:
+  void fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color);
+
+  int16_t WIDTH;
+  int16_t HEIGHT;
+  int16_t _width;
+  int16_t _height;
+  int16_t cursor_x;
+  int16_t cursor_y;
+  uint16_t textcolor;
+  uint16_t textbgcolor;
+  uint8_t textsize_x;
+  uint8_t textsize_y;
+  uint8_t rotation;
+  bool wrap;
+};
+
+#endif
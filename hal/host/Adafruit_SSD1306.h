@@ -0,0 +1,88 @@
+#ifndef HAL_HOST_ADAFRUIT_SSD1306_H
+#define HAL_HOST_ADAFRUIT_SSD1306_H
+
+/*
+ * SSD1306 for verten: samme buffer og API som Adafruit-biblioteket. Bufferen har samme
+ * format som kontrolleren (én byte = 8 piksler loddrett, én side = 8 rader), og display()
+ * kopierer den til "skjermminnet" i kontrolleren og koster tiden SPI-overføringen tar.
+ *
+ * Skjermen er også enheten på SPI: mens CS er lav er bytes fra SPI.transfer() kommandoer
+ * (DC lav) eller data (DC høy), slik skisser som sender selv (felles/ssd1306spi.h) gjør.
+ */
+
+#include "Adafruit_GFX.h"
+#include "SPI.h"
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+
+#ifndef NO_ADAFRUIT_SSD1306_COLOR_COMPATIBILITY
+#define BLACK SSD1306_BLACK
+#define WHITE SSD1306_WHITE
+#define INVERSE SSD1306_INVERSE
+#endif
+
+#define SSD1306_EXTERNALVCC 0x01
+#define SSD1306_SWITCHCAPVCC 0x02
+
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+
+class Adafruit_SSD1306 : public Adafruit_GFX, public HalSpiDevice
+{
+  public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, SPIClass* spi, int8_t dcPin, int8_t rstPin, int8_t csPin, uint32_t bitrate = 8000000UL);
+  ~Adafruit_SSD1306();
+
+  bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0, bool reset = true, bool periphBegin = true);
+  void display();
+  void clearDisplay();
+  void invertDisplay(bool) {}
+  void dim(bool) {}
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+  bool getPixel(int16_t x, int16_t y);
+  uint8_t* getBuffer() { return buffer; }
+
+  // Kontrolleren: kommandoer og data slik de går over SPI
+  void ssd1306_command(uint8_t c);
+  void ssd1306_data(const uint8_t* data, uint16_t len);
+  const uint8_t* controllerRam() const { return ram_; }
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  void spiTransfer(uint8_t b) override;
+  void spiPinWritten(uint8_t pin, uint8_t value) override;
+
+  private:
+  void transferTime(uint32_t bytes);
+  void frameDone(uint64_t startUs);
+
+  uint8_t* buffer;
+  uint8_t* ram_;
+  uint32_t bitrate_;
+  SPIClass* spi_;
+  int8_t dcPin_, csPin_;
+  bool selected_;       // CS lav
+  uint64_t selectedUs_; // da CS gikk lav
+
+  // Adresseringen i kontrolleren (horisontal modus)
+  uint8_t pendingCommand_;
+  uint8_t commandArgs_[2];
+  uint8_t commandArgCount_;
+  uint8_t columnStart_, columnEnd_, pageStart_, pageEnd_;
+  uint8_t column_, page_;
+
+  char text_[256]; // det som er skrevet siden clearDisplay(), for --show og --stamp
+  size_t textLength_;
+  int16_t textEndX_, textEndY_; // markøren etter forrige tegn, ellers skilles tekstene med |
+  char shownText_[256];         // teksten ved forrige display(), for --stamp
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef HAL_HOST_ARDUINO_H
+#define HAL_HOST_ARDUINO_H
+
+/*
+ * Arduino-API-et skissene bruker, for Linux (se hal.h og bygg.sh).
+ * Tiden er virtuell: delay() flytter klokka, og hvert kall som venter på noe
+ * (millis, micros, digitalRead) koster litt tid, så ventesløyfer kommer seg videre.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <type_traits>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define F(text) (text)
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+int analogRead(uint8_t pin);
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+template <class A, class B> inline typename std::common_type<A, B>::type min(A a, B b) { return a < b ? a : b; }
+template <class A, class B> inline typename std::common_type<A, B>::type max(A a, B b) { return a > b ? a : b; }
+template <class T, class L, class H> inline T constrain(T value, L low, H high) { return value < low ? low : (value > high ? high : value); }
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) { return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin; }
+
+// Chip-ID-en til Teensy 3.6 (unik per kort). På verten settes den med --node-id.
+extern uint32_t halChipIdLow;
+extern uint32_t halChipIdMidLow;
+#define SIM_UIDL halChipIdLow
+#define SIM_UIDML halChipIdMidLow
+
+// Print som i Arduino: alt går gjennom write(), så Serial og skjermen deler print()-variantene
+class Print
+{
+  public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+
+  size_t print(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(int value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base = DEC)
+  {
+    if (base == DEC && value < 0) return print('-') + print((unsigned long)-value, base);
+    return print((unsigned long)value, base);
+  }
+  size_t print(unsigned long value, int base = DEC)
+  {
+    char digits[33];
+    int i = 32;
+    digits[i] = '\0';
+    if (base < 2) base = DEC;
+    do {
+      int digit = value % base;
+      digits[--i] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+      value /= base;
+    } while (value > 0);
+    return print(digits + i);
+  }
+  size_t print(long long value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned long long value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(double value, int decimals = 2)
+  {
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", decimals, value);
+    return print(text);
+  }
+
+  size_t println() { return print("\r\n"); }
+  template <class T> size_t println(T value) { return print(value) + println(); }
+  template <class T> size_t println(T value, int format) { return print(value, format) + println(); }
+};
+
+// Serial skriver til stdout (kan slås av med --quiet)
+class HostSerial : public Print
+{
+  public:
+  void begin(unsigned long) {}
+  operator bool() const { return true; }
+  int available() { return 0; }
+  int read() { return -1; }
+  void flush();
+  size_t write(uint8_t c) override;
+  using Print::write;
+};
+
+extern HostSerial Serial;
+
+// Skissen
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef HAL_HOST_FLEXCAN_T4_H
+#define HAL_HOST_FLEXCAN_T4_H
+
+/*
+ * FlexCAN_T4 for verten: samme API som biblioteket på Teensyen, men rammene går til et
+ * SocketCAN-grensesnitt (se hal.h). Bitraten bestemmes av grensesnittet, ikke av setBaudRate().
+ */
+
+#include <stdint.h>
+
+typedef struct CAN_message_t {
+  uint32_t id = 0;
+  uint16_t timestamp = 0;
+  uint8_t idhit = 0;
+  struct {
+    bool extended = 0;
+    bool remote = 0;
+    bool overrun = 0;
+    bool reserved = 0;
+  } flags;
+  uint8_t len = 8;
+  uint8_t buf[8] = { 0 };
+  int8_t mb = 0;
+  uint8_t bus = 0;
+  bool seq = 0;
+} CAN_message_t;
+
+typedef enum CAN_DEV_TABLE { CAN0, CAN1, CAN2, CAN3 } CAN_DEV_TABLE;
+typedef enum RXQUEUE_TABLE { RX_SIZE_2 = 2, RX_SIZE_4 = 4, RX_SIZE_8 = 8, RX_SIZE_16 = 16, RX_SIZE_32 = 32,
+                             RX_SIZE_64 = 64, RX_SIZE_128 = 128, RX_SIZE_256 = 256, RX_SIZE_512 = 512,
+                             RX_SIZE_1024 = 1024 } RXQUEUE_TABLE;
+typedef enum TXQUEUE_TABLE { TX_SIZE_2 = 2, TX_SIZE_4 = 4, TX_SIZE_8 = 8, TX_SIZE_16 = 16, TX_SIZE_32 = 32,
+                             TX_SIZE_64 = 64, TX_SIZE_128 = 128, TX_SIZE_256 = 256, TX_SIZE_512 = 512,
+                             TX_SIZE_1024 = 1024 } TXQUEUE_TABLE;
+
+// Én socket per FlexCAN_T4-objekt (flexcan.cpp)
+class HostCanPort
+{
+  public:
+  HostCanPort() : socket_{-1}, bitrate_{0} {}
+  void begin();
+  void setBaudRate(uint32_t bitrate) { bitrate_ = bitrate; }
+  uint32_t baudRate() const { return bitrate_; }
+  int read(CAN_message_t& msg);
+  int write(const CAN_message_t& msg);
+
+  private:
+  int socket_;
+  uint32_t bitrate_;
+};
+
+template <CAN_DEV_TABLE _bus, RXQUEUE_TABLE _rxSize = RX_SIZE_16, TXQUEUE_TABLE _txSize = TX_SIZE_16>
+class FlexCAN_T4
+{
+  public:
+  void begin() { port_.begin(); }
+  void setBaudRate(uint32_t bitrate) { port_.setBaudRate(bitrate); }
+  int read(CAN_message_t& msg) { return port_.read(msg); }
+  int write(const CAN_message_t& msg) { return port_.write(msg); }
+  void setMaxMB(uint8_t) {}
+  void enableFIFO(bool = 1) {}
+  void enableFIFOInterrupt(bool = 1) {}
+  void events() {}
+
+  private:
+  HostCanPort port_;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef HAL_HOST_SPI_H
+#define HAL_HOST_SPI_H
+
+#include <stdint.h>
+
+/*
+ * SPI finnes ikke på verten. Bytes fra transfer() går til enheten som har koblet seg til
+ * (skjermen, display.cpp), og enheten regner ut tiden overføringen ville tatt selv.
+ */
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+#define SPI_MODE0 0x00
+
+class SPISettings
+{
+  public:
+  SPISettings() {}
+  SPISettings(uint32_t, uint8_t, uint8_t) {}
+};
+
+// En enhet på bussen: ser bytesene og pinnene skissen skriver (CS, DC)
+class HalSpiDevice
+{
+  public:
+  virtual void spiTransfer(uint8_t b) = 0;
+  virtual void spiPinWritten(uint8_t pin, uint8_t value) = 0;
+};
+
+class SPIClass
+{
+  public:
+  void begin() {}
+  void end() {}
+  void beginTransaction(const SPISettings&) {}
+  void endTransaction() {}
+
+  uint8_t transfer(uint8_t b)
+  {
+    if (device_) device_->spiTransfer(b);
+    return 0;
+  }
+
+  void halAttach(HalSpiDevice* device) { device_ = device; }
+  HalSpiDevice* halDevice() const { return device_; }
+
+  private:
+  HalSpiDevice* device_ = nullptr;
+};
+
+extern SPIClass SPI;
+
+#endif
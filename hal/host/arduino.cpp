@@ -0,0 +1,217 @@
+#include "Arduino.h"
+#include "hal.h"
+
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Klokke, pinner, tilfeldige tall og Serial for verten (se hal.h).
+ */
+
+HalStats halStats;
+HostSerial Serial;
+uint32_t halChipIdLow = 0;
+uint32_t halChipIdMidLow = 0;
+
+// Hvert kall som leser tid eller pinner koster så mye virtuell tid, så ventesløyfer går videre
+static const uint64_t callCostUs = 1;
+static uint64_t virtualUs = 0;
+
+static uint64_t wallUs()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+static uint64_t wallStartUs = wallUs();
+
+static void checkLimit(uint64_t nowUs)
+{
+  if (halOptions.limitMs != 0 && nowUs >= halOptions.limitMs * 1000ULL) halFinish();
+}
+
+uint64_t halNowUs()
+{
+  return halOptions.realtime ? wallUs() - wallStartUs : virtualUs;
+}
+
+void halAdvanceUs(uint64_t us)
+{
+  if (halOptions.realtime) {
+    usleep(us);
+  } else {
+    virtualUs += us;
+  }
+  checkLimit(halNowUs());
+  halHarnessSync(halNowUs()); // venter på de andre nodene under tonoder
+}
+
+// ---------- Pinner ----------
+
+struct PinChange
+{
+  uint64_t atMs;
+  uint8_t pin;
+  uint8_t value;
+};
+
+static const int pinCount = 64;
+static uint8_t pinValues[pinCount];
+static bool pinsInitialized = false;
+static std::vector<PinChange> script;
+static size_t scriptPosition = 0;
+
+static void initPins()
+{
+  if (pinsInitialized) return;
+  for (int i = 0; i < pinCount; i++) pinValues[i] = HIGH;
+  pinsInitialized = true;
+}
+
+bool halLoadScript(const char* path)
+{
+  FILE* file = fopen(path, "r");
+  if (!file) return false;
+
+  char line[128];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#') continue;
+    unsigned long long atMs;
+    unsigned pin, value;
+    if (sscanf(line, "%llu %u %u", &atMs, &pin, &value) != 3) continue;
+    if (pin >= pinCount) continue;
+    script.push_back({atMs, (uint8_t)pin, (uint8_t)(value ? HIGH : LOW)});
+  }
+  fclose(file);
+
+  std::stable_sort(script.begin(), script.end(),
+                   [](const PinChange& a, const PinChange& b) { return a.atMs < b.atMs; });
+  return true;
+}
+
+// Tar med alle endringer i skriptet som har skjedd innen nå
+static void applyScript()
+{
+  initPins();
+  uint64_t nowMs = halNowUs() / 1000;
+  while (scriptPosition < script.size() && script[scriptPosition].atMs <= nowMs) {
+    pinValues[script[scriptPosition].pin] = script[scriptPosition].value;
+    scriptPosition++;
+  }
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  initPins();
+  if (pin < pinCount && mode == INPUT_PULLUP) pinValues[pin] = HIGH;
+}
+
+int digitalRead(uint8_t pin)
+{
+  halAdvanceUs(callCostUs);
+  applyScript();
+  return pin < pinCount ? pinValues[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  initPins();
+  if (pin < pinCount) pinValues[pin] = value ? HIGH : LOW;
+  halPinWritten(pin, value ? HIGH : LOW);
+}
+
+int halPinLevel(uint8_t pin)
+{
+  initPins();
+  return pin < pinCount ? pinValues[pin] : LOW;
+}
+
+int analogRead(uint8_t)
+{
+  halAdvanceUs(callCostUs);
+  return 512;
+}
+
+// ---------- Tid ----------
+
+uint32_t millis()
+{
+  halAdvanceUs(callCostUs);
+  return (uint32_t)(halNowUs() / 1000);
+}
+
+uint32_t micros()
+{
+  halAdvanceUs(callCostUs);
+  return (uint32_t)halNowUs();
+}
+
+void delay(uint32_t ms)
+{
+  halAdvanceUs((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  halAdvanceUs(us);
+}
+
+// ---------- Tilfeldige tall ----------
+
+// xorshift64*, så samme --node-id gir samme kjøring
+static uint64_t randomState = 0x9E3779B97F4A7C15ULL;
+
+static uint32_t nextRandom()
+{
+  randomState ^= randomState >> 12;
+  randomState ^= randomState << 25;
+  randomState ^= randomState >> 27;
+  return (uint32_t)((randomState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+void randomSeed(unsigned long seed)
+{
+  if (seed != 0) randomState = seed * 0x9E3779B97F4A7C15ULL | 1;
+}
+
+long random(long max)
+{
+  if (max <= 0) return 0;
+  return nextRandom() % max;
+}
+
+long random(long min, long max)
+{
+  if (min >= max) return min;
+  return min + random(max - min);
+}
+
+// ---------- Serial ----------
+
+static bool atLineStart = true;
+
+size_t HostSerial::write(uint8_t c)
+{
+  if (halOptions.quiet) return 1;
+  if (c == '\r') return 1; // println() sender \r\n som på Teensyen
+  if (halOptions.stamp && atLineStart) printf("[%12.3f] ", halNowUs() / 1000.0);
+  putchar(c);
+  atLineStart = c == '\n';
+  return 1;
+}
+
+void halStampLine(const char* text)
+{
+  if (halOptions.quiet) return;
+  if (!atLineStart) putchar('\n');
+  printf("[%12.3f] %s\n", halNowUs() / 1000.0, text);
+  atLineStart = true;
+}
+
+void HostSerial::flush()
+{
+  fflush(stdout);
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Bygger Teensy-skissene som Linux-programmer mot HAL-et i hal/host (se hal.h).
+# Kjøres fra hvor som helst; programmene havner i hal/host/bygg/.
+#
+#   hal/host/bygg.sh
+#   hal/host/bygg/kristie --if=vcan0 --script=joy.txt --ms=10000
+#   hal/host/bygg/tonoder --ms=60000
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+repo=$(cd "$here/../.." && pwd)
+out="$here/bygg"
+mkdir -p "$out"
+
+CXX=${CXX:-g++}
+FLAGS="-std=gnu++17 -O2 -Wall -I$here"
+HAL="$here/arduino.cpp $here/flexcan.cpp $here/display.cpp $here/harness.cpp $here/main.cpp"
+
+# Kristie: .ino-fila er C++ med et annet navn, så den må komme sist etter -x c++
+k="$repo/Kristie/objektorientert"
+$CXX $FLAGS -I"$k" -o "$out/kristie" $HAL \
+  "$k/ball.cpp" "$k/canbushandler.cpp" "$k/joystick.cpp" "$k/paddle.cpp" "$k/pingponggame.cpp" \
+  -x c++ "$k/pingponggame.ino"
+
+# Oppg3: Arduino-IDE-en legger til #include <Arduino.h> selv
+$CXX $FLAGS -include Arduino.h -o "$out/oppg3" $HAL "$repo/Oppg3/oppg3Teensy.cpp"
+
+# Lars: to av disse kjøres mot hverandre av tonoder
+$CXX $FLAGS -o "$out/endelig" $HAL "$repo/Lars/EndeligPingPong.cpp"
+$CXX $FLAGS -o "$out/tonoder" "$here/tonoder.cpp" "$repo/del3/canbussim.cpp" "$repo/del3/busloadestimator.cpp"
+
+echo "Bygget kristie, oppg3, endelig og tonoder i $out"
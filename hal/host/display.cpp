@@ -0,0 +1,430 @@
+#include "Adafruit_SSD1306.h"
+#include "hal.h"
+
+/*
+ * Adafruit_GFX og SSD1306 for verten. Tegnealgoritmene er de samme som i Adafruit-bibliotekene,
+ * og kontrolleren er modellert med horisontal adressering, slik at display() gir samme bytes i
+ * skjermminnet som på Teensyen.
+ */
+
+SPIClass SPI;
+
+// ---------- Adafruit_GFX ----------
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h)
+  : WIDTH{w}, HEIGHT{h}, _width{w}, _height{h}, cursor_x{0}, cursor_y{0},
+    textcolor{0xFFFF}, textbgcolor{0xFFFF}, textsize_x{1}, textsize_y{1}, rotation{0}, wrap{true}
+{
+}
+
+void Adafruit_GFX::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+  drawLine(x, y, x, y + h - 1, color);
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+  drawLine(x, y, x + w - 1, y, color);
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  for (int16_t i = x; i < x + w; i++) drawFastVLine(i, y, h, color);
+}
+
+void Adafruit_GFX::fillScreen(uint16_t color)
+{
+  fillRect(0, 0, _width, _height, color);
+}
+
+void Adafruit_GFX::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color)
+{
+  bool steep = abs(y1 - y0) > abs(x1 - x0);
+  if (steep) {
+    int16_t t = x0; x0 = y0; y0 = t;
+    t = x1; x1 = y1; y1 = t;
+  }
+  if (x0 > x1) {
+    int16_t t = x0; x0 = x1; x1 = t;
+    t = y0; y0 = y1; y1 = t;
+  }
+
+  int16_t dx = x1 - x0;
+  int16_t dy = abs(y1 - y0);
+  int16_t err = dx / 2;
+  int16_t ystep = y0 < y1 ? 1 : -1;
+
+  for (; x0 <= x1; x0++) {
+    if (steep) drawPixel(y0, x0, color);
+    else drawPixel(x0, y0, color);
+    err -= dy;
+    if (err < 0) {
+      y0 += ystep;
+      err += dx;
+    }
+  }
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
+{
+  drawFastHLine(x, y, w, color);
+  drawFastHLine(x, y + h - 1, w, color);
+  drawFastVLine(x, y, h, color);
+  drawFastVLine(x + w - 1, y, h, color);
+}
+
+void Adafruit_GFX::drawCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color)
+{
+  int16_t f = 1 - r;
+  int16_t ddF_x = 1;
+  int16_t ddF_y = -2 * r;
+  int16_t x = 0;
+  int16_t y = r;
+
+  drawPixel(x0, y0 + r, color);
+  drawPixel(x0, y0 - r, color);
+  drawPixel(x0 + r, y0, color);
+  drawPixel(x0 - r, y0, color);
+
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+
+    drawPixel(x0 + x, y0 + y, color);
+    drawPixel(x0 - x, y0 + y, color);
+    drawPixel(x0 + x, y0 - y, color);
+    drawPixel(x0 - x, y0 - y, color);
+    drawPixel(x0 + y, y0 + x, color);
+    drawPixel(x0 - y, y0 + x, color);
+    drawPixel(x0 + y, y0 - x, color);
+    drawPixel(x0 - y, y0 - x, color);
+  }
+}
+
+void Adafruit_GFX::fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color)
+{
+  drawFastVLine(x0, y0 - r, 2 * r + 1, color);
+  fillCircleHelper(x0, y0, r, 3, 0, color);
+}
+
+void Adafruit_GFX::fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners, int16_t delta, uint16_t color)
+{
+  int16_t f = 1 - r;
+  int16_t ddF_x = 1;
+  int16_t ddF_y = -2 * r;
+  int16_t x = 0;
+  int16_t y = r;
+  int16_t px = x;
+  int16_t py = y;
+
+  delta++; // unngår noen +1 i løkka
+
+  while (x < y) {
+    if (f >= 0) {
+      y--;
+      ddF_y += 2;
+      f += ddF_y;
+    }
+    x++;
+    ddF_x += 2;
+    f += ddF_x;
+    // Disse sjekkene unngår at samme linje tegnes to ganger (viktig for INVERSE)
+    if (x < (y + 1)) {
+      if (corners & 1) drawFastVLine(x0 + x, y0 - y, 2 * y + delta, color);
+      if (corners & 2) drawFastVLine(x0 - x, y0 - y, 2 * y + delta, color);
+    }
+    if (y != py) {
+      if (corners & 1) drawFastVLine(x0 + py, y0 - px, 2 * px + delta, color);
+      if (corners & 2) drawFastVLine(x0 - py, y0 - px, 2 * px + delta, color);
+      py = y;
+    }
+    px = x;
+  }
+}
+
+// Uten font: bakgrunnen fylles som i biblioteket, og tegnet blir en fylt 5x7-blokk
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+{
+  if (x >= _width || y >= _height || (x + 6 * size - 1) < 0 || (y + 8 * size - 1) < 0) return;
+
+  if (bg != color) fillRect(x, y, 6 * size, 8 * size, bg);
+  if (c != ' ') fillRect(x, y, 5 * size, 7 * size, color);
+}
+
+size_t Adafruit_GFX::write(uint8_t c)
+{
+  if (c == '\n') {
+    cursor_x = 0;
+    cursor_y += textsize_y * 8;
+  } else if (c != '\r') {
+    if (wrap && (cursor_x + textsize_x * 6) > _width) {
+      cursor_x = 0;
+      cursor_y += textsize_y * 8;
+    }
+    drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize_x);
+    cursor_x += textsize_x * 6;
+  }
+  return 1;
+}
+
+// ---------- Adafruit_SSD1306 ----------
+
+Adafruit_SSD1306::Adafruit_SSD1306(uint8_t w, uint8_t h, SPIClass* spi, int8_t dcPin, int8_t, int8_t csPin, uint32_t bitrate)
+  : Adafruit_GFX(w, h), buffer{nullptr}, ram_{nullptr}, bitrate_{bitrate},
+    spi_{spi}, dcPin_{dcPin}, csPin_{csPin}, selected_{false}, selectedUs_{0},
+    pendingCommand_{0}, commandArgCount_{0},
+    columnStart_{0}, columnEnd_{0}, pageStart_{0}, pageEnd_{0}, column_{0}, page_{0},
+    textLength_{0}, textEndX_{0}, textEndY_{0}
+{
+  text_[0] = '\0';
+  shownText_[0] = '\0';
+}
+
+Adafruit_SSD1306::~Adafruit_SSD1306()
+{
+  if (spi_ && spi_->halDevice() == this) spi_->halAttach(nullptr);
+  free(buffer);
+  free(ram_);
+}
+
+bool Adafruit_SSD1306::begin(uint8_t, uint8_t, bool, bool)
+{
+  size_t bytes = WIDTH * ((HEIGHT + 7) / 8);
+  if (!buffer && !(buffer = (uint8_t*)malloc(bytes))) return false;
+  if (!ram_ && !(ram_ = (uint8_t*)malloc(bytes))) return false;
+  clearDisplay();
+  memset(ram_, 0, bytes);
+  columnEnd_ = WIDTH - 1;
+  pageEnd_ = (HEIGHT + 7) / 8 - 1;
+  if (spi_) spi_->halAttach(this);
+  return true;
+}
+
+void Adafruit_SSD1306::clearDisplay()
+{
+  if (buffer) memset(buffer, 0, WIDTH * ((HEIGHT + 7) / 8));
+  textLength_ = 0;
+  text_[0] = '\0';
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  if (!buffer || x < 0 || x >= width() || y < 0 || y >= height()) return;
+  uint8_t& b = buffer[x + (y / 8) * WIDTH];
+  switch (color) {
+    case SSD1306_WHITE: b |= (1 << (y & 7)); break;
+    case SSD1306_BLACK: b &= ~(1 << (y & 7)); break;
+    case SSD1306_INVERSE: b ^= (1 << (y & 7)); break;
+  }
+}
+
+void Adafruit_SSD1306::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+{
+  if (y < 0 || y >= height()) return;
+  if (x < 0) {
+    w += x;
+    x = 0;
+  }
+  if (x + w > width()) w = width() - x;
+  for (int16_t i = 0; i < w; i++) drawPixel(x + i, y, color);
+}
+
+void Adafruit_SSD1306::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+{
+  if (x < 0 || x >= width()) return;
+  if (y < 0) {
+    h += y;
+    y = 0;
+  }
+  if (y + h > height()) h = height() - y;
+  for (int16_t i = 0; i < h; i++) drawPixel(x, y + i, color);
+}
+
+bool Adafruit_SSD1306::getPixel(int16_t x, int16_t y)
+{
+  if (!buffer || x < 0 || x >= width() || y < 0 || y >= height()) return false;
+  return buffer[x + (y / 8) * WIDTH] & (1 << (y & 7));
+}
+
+size_t Adafruit_SSD1306::write(uint8_t c)
+{
+  if (c == '\r' || c == '\n') return Adafruit_GFX::write(c);
+
+  bool moved = textLength_ > 0 && (cursor_x != textEndX_ || cursor_y != textEndY_);
+  if (textLength_ + 2 < sizeof(text_)) {
+    if (moved) text_[textLength_++] = '|';
+    text_[textLength_++] = c;
+    text_[textLength_] = '\0';
+  }
+  size_t n = Adafruit_GFX::write(c);
+  textEndX_ = cursor_x;
+  textEndY_ = cursor_y;
+  return n;
+}
+
+// Samme rekkefølge som biblioteket: hele skjermen som ett vindu, så 1024 bytes data
+void Adafruit_SSD1306::display()
+{
+  if (!buffer) return;
+  uint64_t startUs = halNowUs();
+
+  ssd1306_command(SSD1306_PAGEADDR);
+  ssd1306_command(0);
+  ssd1306_command(0xFF);
+  ssd1306_command(SSD1306_COLUMNADDR);
+  ssd1306_command(0);
+  ssd1306_command(WIDTH - 1);
+  ssd1306_data(buffer, WIDTH * ((HEIGHT + 7) / 8));
+  frameDone(startUs);
+}
+
+// Etter display() eller når CS går høy: statistikk, --show/--dump, --stamp
+void Adafruit_SSD1306::frameDone(uint64_t startUs)
+{
+  halStats.displayUpdates++;
+  halStats.displayTimeUs += halNowUs() - startUs;
+  if (memcmp(ram_, buffer, WIDTH * ((HEIGHT + 7) / 8)) != 0) halStats.displayMismatches++;
+  halDisplayFrame(ram_, WIDTH, HEIGHT, text_);
+
+  if (halOptions.stamp && strcmp(text_, shownText_) != 0) {
+    strcpy(shownText_, text_);
+    char line[sizeof(text_) + 16];
+    snprintf(line, sizeof(line), "skjerm: %s", text_);
+    halStampLine(line);
+  }
+}
+
+void Adafruit_SSD1306::transferTime(uint32_t bytes)
+{
+  uint32_t hz = halOptions.spiHz ? halOptions.spiHz : bitrate_;
+  halStats.displayBytes += bytes;
+  halAdvanceUs((uint64_t)bytes * 8 * 1000000ULL / hz);
+}
+
+// Antall argumentbytes etter kommandoene som har argumenter
+static uint8_t commandArguments(uint8_t c)
+{
+  switch (c) {
+    case SSD1306_COLUMNADDR:
+    case SSD1306_PAGEADDR:
+      return 2;
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t c)
+{
+  transferTime(1);
+
+  if (pendingCommand_ == 0) {
+    if (commandArguments(c) > 0) {
+      pendingCommand_ = c;
+      commandArgCount_ = 0;
+    }
+    return;
+  }
+
+  commandArgs_[commandArgCount_++] = c;
+  if (commandArgCount_ < commandArguments(pendingCommand_)) return;
+
+  uint8_t lastPage = (HEIGHT + 7) / 8 - 1;
+  if (pendingCommand_ == SSD1306_COLUMNADDR) {
+    columnStart_ = min(commandArgs_[0] & 0x7F, WIDTH - 1);
+    columnEnd_ = min(commandArgs_[1] & 0x7F, WIDTH - 1);
+    column_ = columnStart_;
+  } else if (pendingCommand_ == SSD1306_PAGEADDR) {
+    pageStart_ = min(commandArgs_[0] & 0x07, lastPage);
+    pageEnd_ = min(commandArgs_[1] & 0x07, lastPage);
+    page_ = pageStart_;
+  }
+  pendingCommand_ = 0;
+}
+
+void Adafruit_SSD1306::ssd1306_data(const uint8_t* data, uint16_t len)
+{
+  transferTime(len);
+
+  for (uint16_t i = 0; i < len; i++) {
+    ram_[column_ + page_ * WIDTH] = data[i];
+    if (column_ < columnEnd_) {
+      column_++;
+      continue;
+    }
+    column_ = columnStart_;
+    page_ = page_ < pageEnd_ ? page_ + 1 : pageStart_;
+  }
+}
+
+// ---------- SPI ----------
+
+void Adafruit_SSD1306::spiTransfer(uint8_t b)
+{
+  if (!selected_ || !ram_) return;
+  if (halPinLevel(dcPin_) == LOW) ssd1306_command(b);
+  else ssd1306_data(&b, 1);
+}
+
+void Adafruit_SSD1306::spiPinWritten(uint8_t pin, uint8_t value)
+{
+  if (pin != csPin_ || !ram_) return;
+  if (value == LOW && !selected_) {
+    selected_ = true;
+    selectedUs_ = halNowUs();
+  } else if (value == HIGH && selected_) {
+    selected_ = false;
+    frameDone(selectedUs_);
+  }
+}
+
+void halPinWritten(uint8_t pin, uint8_t value)
+{
+  if (SPI.halDevice()) SPI.halDevice()->spiPinWritten(pin, value);
+}
+
+// ---------- --show og --dump ----------
+
+static FILE* dumpFile = nullptr;
+static uint64_t lastShowUs = 0;
+static const uint64_t showIntervalUs = 33000; // ~30 bilder i sekundet er nok i en terminal
+
+void halDisplayFrame(const uint8_t* buffer, int width, int height, const char* text)
+{
+  int bytes = width * ((height + 7) / 8);
+
+  if (halOptions.dumpFile) {
+    if (!dumpFile) dumpFile = fopen(halOptions.dumpFile, "wb");
+    if (dumpFile) fwrite(buffer, 1, bytes, dumpFile);
+  }
+
+  if (!halOptions.show) return;
+  uint64_t nowUs = halNowUs();
+  if (lastShowUs != 0 && nowUs - lastShowUs < showIntervalUs) return;
+  lastShowUs = nowUs;
+
+  // To rader per tegn med halvblokker
+  fputs("\x1b[H", stderr);
+  for (int y = 0; y < height; y += 2) {
+    for (int x = 0; x < width; x++) {
+      bool top = buffer[x + (y / 8) * width] & (1 << (y & 7));
+      bool bottom = y + 1 < height && (buffer[x + ((y + 1) / 8) * width] & (1 << ((y + 1) & 7)));
+      fputs(top ? (bottom ? "█" : "▀") : (bottom ? "▄" : " "), stderr);
+    }
+    fputc('\n', stderr);
+  }
+  fprintf(stderr, "\x1b[K%.*s\n\x1b[K%8.3f s\n", width, text, nowUs / 1e6);
+}
+
+void halCloseDisplay()
+{
+  if (dumpFile) fclose(dumpFile);
+  dumpFile = nullptr;
+}
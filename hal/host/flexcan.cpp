@@ -0,0 +1,113 @@
+#include "FlexCAN_T4.h"
+#include "hal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+/*
+ * FlexCAN_T4 over SocketCAN. Som på Teensyen venter ingenting: read() gir 0 når køen er
+ * tom, og write() gir 0 når sendekøen er full (ENOBUFS), så skissens egen håndtering av
+ * full kø blir testet. Under tonoder uten --if går rammene gjennom harnesset (harness.h).
+ */
+
+void HostCanPort::begin()
+{
+  if (socket_ >= 0 || !halOptions.canInterface) return;
+
+  socket_ = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (socket_ < 0) {
+    perror("socket");
+    exit(1);
+  }
+
+  ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, halOptions.canInterface, IFNAMSIZ - 1);
+  if (ioctl(socket_, SIOCGIFINDEX, &ifr) < 0) {
+    perror(halOptions.canInterface);
+    exit(1);
+  }
+
+  sockaddr_can addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifr.ifr_ifindex;
+  if (bind(socket_, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    perror("bind");
+    exit(1);
+  }
+
+  fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+}
+
+int HostCanPort::read(CAN_message_t& msg)
+{
+  if (socket_ < 0 && halHarnessBus()) {
+    uint32_t id;
+    bool extended;
+    if (!halHarnessReceive(id, extended, msg.buf, msg.len)) return 0;
+    msg.id = id;
+    msg.flags.extended = extended;
+    msg.flags.remote = false;
+    msg.timestamp = (uint16_t)halNowUs();
+    halStats.canReceived++;
+    return 1;
+  }
+  if (socket_ < 0) return 0;
+
+  can_frame frame;
+  ssize_t n = recv(socket_, &frame, sizeof(frame), MSG_DONTWAIT);
+  if (n != (ssize_t)sizeof(frame)) return 0;
+  if (frame.can_id & CAN_ERR_FLAG) return 0;
+
+  msg.flags.extended = (frame.can_id & CAN_EFF_FLAG) != 0;
+  msg.flags.remote = (frame.can_id & CAN_RTR_FLAG) != 0;
+  msg.id = frame.can_id & (msg.flags.extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+  msg.len = frame.can_dlc > 8 ? 8 : frame.can_dlc;
+  memcpy(msg.buf, frame.data, msg.len);
+  msg.timestamp = (uint16_t)halNowUs();
+  halStats.canReceived++;
+  return 1;
+}
+
+int HostCanPort::write(const CAN_message_t& msg)
+{
+  if (socket_ < 0 && halHarnessBus()) {
+    if (!halHarnessSend(msg.id, msg.flags.extended, msg.buf, msg.len)) {
+      halStats.canSendFailed++;
+      return 0;
+    }
+    halStats.canSent++;
+    halHarnessCountSent(msg.id, msg.flags.extended);
+    return 1;
+  }
+  if (socket_ < 0) {
+    halStats.canSent++;
+    return 1;
+  }
+
+  can_frame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.can_id = msg.flags.extended ? ((msg.id & CAN_EFF_MASK) | CAN_EFF_FLAG) : (msg.id & CAN_SFF_MASK);
+  if (msg.flags.remote) frame.can_id |= CAN_RTR_FLAG;
+  frame.can_dlc = msg.len > 8 ? 8 : msg.len;
+  memcpy(frame.data, msg.buf, frame.can_dlc);
+
+  if (send(socket_, &frame, sizeof(frame), MSG_DONTWAIT) != (ssize_t)sizeof(frame)) {
+    if (errno != ENOBUFS && errno != EAGAIN) perror("send");
+    halStats.canSendFailed++;
+    return 0;
+  }
+  halStats.canSent++;
+  halHarnessCountSent(msg.id, msg.flags.extended);
+  return 1;
+}
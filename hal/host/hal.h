@@ -0,0 +1,102 @@
+#ifndef HAL_HOST_HAL_H
+#define HAL_HOST_HAL_H
+
+/*
+ * Tynt HAL for å kjøre Teensy-skissene uendret som Linux-prosesser, slik at klientkoden kan
+ * profileres og soak-testes i vertsfart. Headerne her har samme navn som bibliotekene på
+ * Teensyen (Arduino.h, FlexCAN_T4.h, Adafruit_SSD1306.h, Adafruit_GFX.h, SPI.h), så skissene
+ * bygges med -Ihal/host og ingen endringer (se bygg.sh).
+ *
+ *  - Klokke: virtuell. delay() flytter tiden, og millis()/micros()/digitalRead() koster
+ *    callCostUs hver, så ventesløyfer går videre. "--realtime" bruker veggklokka i stedet.
+ *  - Pinner: alle er HIGH (INPUT_PULLUP sluppet). "--script=fil" endrer dem over tid:
+ *    én linje per endring, "<ms> <pin> <0|1>", # er kommentar.
+ *  - CAN: FlexCAN_T4 sender og leser på et SocketCAN-grensesnitt ("--if=vcan0").
+ *    Uten --if går rammene ingen steder (telles bare).
+ *  - Skjerm: SSD1306-bufferen ligger i minnet. display() koster tiden 1 KB tar over SPI
+ *    ("--spi-hz=", ellers det skissen ber om, standard 8 MHz). Skisser som skriver til
+ *    kontrolleren selv (SPI.transfer() med DC og CS, felles/ssd1306spi.h) får bytesene
+ *    tolket som kommando eller data, og CS høy avslutter en ramme. Etter hver ramme sjekkes
+ *    skjermminnet mot bufferet, og avvik telles i statistikken. "--show" tegner skjermen i
+ *    terminalen og "--dump=fil" skriver hver ramme (1024 bytes) til fil. Tekst tegnes som
+ *    fylte tegnceller (ingen font her).
+ *  - "--ms=N" stopper etter N ms virtuell tid (0 = aldri) og skriver statistikk.
+ *  - "--node-id=N" er chip-ID-en (SIM_UIDL), standard prosess-ID-en.
+ *  - "--jitter-us=N" legger 0..N us tilfeldig til etter hver loop(), som avbrudd og varierende
+ *    arbeid gjør på kortet. Uten den går to noder i nøyaktig samme takt for alltid.
+ *  - "--quiet" slår av Serial. "--stamp" setter virtuell tid foran hver linje fra Serial,
+ *    og skriver en linje "skjerm: <tekst>" når teksten på skjermen endrer seg (tekst som
+ *    ikke står etter forrige tekst skilles med |).
+ *  - "--shared=fil --node=N" brukes av tonoder (harness.h): klokka følger de andre nodene,
+ *    og CAN går gjennom harnesset når --if mangler.
+ */
+
+#include <stdint.h>
+
+struct HalStats
+{
+  uint64_t loops;
+  uint64_t canSent;
+  uint64_t canSendFailed;
+  uint64_t canReceived;
+  uint64_t displayUpdates;
+  uint64_t displayBytes;
+  uint64_t displayTimeUs;
+  uint64_t displayMismatches; // rammer der skjermminnet ikke er lik bufferet
+};
+
+extern HalStats halStats;
+
+struct HalOptions
+{
+  const char* canInterface; // --if, eller nullptr
+  const char* scriptFile;   // --script
+  const char* dumpFile;     // --dump
+  uint32_t spiHz;           // --spi-hz, 0 = det skissen ber om
+  uint64_t limitMs;         // --ms, 0 = aldri
+  uint32_t nodeId;          // --node-id
+  uint32_t jitterUs;        // --jitter-us
+  bool realtime;            // --realtime
+  bool show;                // --show
+  bool quiet;               // --quiet
+  bool stamp;               // --stamp
+  const char* sharedFile;   // --shared (tonoder)
+  int harnessNode;          // --node (tonoder)
+};
+
+extern HalOptions halOptions;
+
+// Skriver statistikken og avslutter prosessen (når --ms er nådd)
+void halFinish();
+// Leser --script-fila (arduino.cpp)
+bool halLoadScript(const char* path);
+
+// Virtuell tid i mikrosekunder, uten kostnad
+uint64_t halNowUs();
+// Flytter den virtuelle klokka (eller sover i --realtime)
+void halAdvanceUs(uint64_t us);
+
+// tonoder (harness.cpp)
+bool halHarnessAttach(const char* path, int node);
+bool halHarnessActive();
+bool halHarnessBus();
+void halHarnessSync(uint64_t nowUs);
+void halHarnessDone();
+void halHarnessCountSent(uint32_t id, bool extended);
+bool halHarnessSend(uint32_t id, bool extended, const uint8_t* data, uint8_t len);
+bool halHarnessReceive(uint32_t& id, bool& extended, uint8_t* data, uint8_t& len);
+
+// Skriver en linje med tidsstempel som --stamp (arduino.cpp)
+void halStampLine(const char* text);
+
+// Nivået på en pinne uten å koste tid, for modellene i HAL-et (arduino.cpp)
+int halPinLevel(uint8_t pin);
+// digitalWrite() sier fra til enheten på SPI (CS og DC til skjermen, display.cpp)
+void halPinWritten(uint8_t pin, uint8_t value);
+
+// Skjermen sier fra når den har sendt en ramme (for --show og --dump)
+void halDisplayFrame(const uint8_t* buffer, int width, int height, const char* text);
+// Lukker --dump-fila (display.cpp)
+void halCloseDisplay();
+
+#endif
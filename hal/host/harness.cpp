@@ -0,0 +1,82 @@
+#include "hal.h"
+#include "harness.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * Nodesiden av tonoder (se harness.h): felles klokke og CAN gjennom harnesset.
+ */
+
+static HarnessShared* shared = nullptr;
+static HarnessNode* self = nullptr;
+
+bool halHarnessAttach(const char* path, int node)
+{
+  int fd = open(path, O_RDWR);
+  if (fd < 0) return false;
+  void* memory = mmap(nullptr, sizeof(HarnessShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) return false;
+
+  shared = (HarnessShared*)memory;
+  if (shared->magic != HarnessShared::magicValue || node < 0 || node >= (int)shared->nodeCount) {
+    shared = nullptr;
+    return false;
+  }
+  self = &shared->nodes[node];
+  return true;
+}
+
+bool halHarnessActive()
+{
+  return self != nullptr;
+}
+
+bool halHarnessBus()
+{
+  return shared && shared->simulatedBus;
+}
+
+void halHarnessSync(uint64_t nowUs)
+{
+  if (!self) return;
+  self->timeUs.store(nowUs, std::memory_order_release);
+  while (nowUs > shared->busTimeUs.load(std::memory_order_acquire)) sched_yield();
+}
+
+void halHarnessDone()
+{
+  if (self) self->timeUs.store(HarnessNode::finished, std::memory_order_release);
+}
+
+void halHarnessCountSent(uint32_t id, bool extended)
+{
+  if (self) self->framesSent[extended ? 2048 : (id & 0x7FF)]++;
+}
+
+bool halHarnessSend(uint32_t id, bool extended, const uint8_t* data, uint8_t len)
+{
+  HarnessFrame frame;
+  frame.atUs = halNowUs();
+  frame.id = id;
+  frame.extended = extended;
+  frame.len = len > 8 ? 8 : len;
+  memcpy(frame.data, data, frame.len);
+  return self->tx.push(frame);
+}
+
+bool halHarnessReceive(uint32_t& id, bool& extended, uint8_t* data, uint8_t& len)
+{
+  const HarnessFrame* frame = self->rx.front();
+  if (!frame || frame->atUs + 1 > halNowUs()) return false;
+  id = frame->id;
+  extended = frame->extended;
+  len = frame->len;
+  memcpy(data, frame->data, len);
+  self->rx.pop();
+  return true;
+}
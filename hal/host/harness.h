@@ -0,0 +1,82 @@
+#ifndef HAL_HOST_HARNESS_H
+#define HAL_HOST_HARNESS_H
+
+/*
+ * Delt minne mellom tonoder (harnesset) og nodene det starter (skisser bygget mot hal/host).
+ *
+ * Klokka: hver node skriver sin virtuelle tid i timeUs og venter når den er foran busTimeUs.
+ * Harnesset setter busTimeUs til den minste tiden blant nodene, så den som ligger bakerst
+ * alltid får kjøre og ingen kommer mer enn én delay() foran de andre.
+ *
+ * CAN (uten --if): nodene legger rammene i tx med tiden de ble sendt. Harnesset kjører dem
+ * gjennom CanBusSim (del3/canbussim.h) og legger dem i rx til mottakerne med tiden de var
+ * ferdige på bussen. Før busTimeUs flyttes til T har harnesset sendt alle rammer fra før T
+ * gjennom bussen og kjørt den til like før T. En node leser bare rammer som var ferdige minst
+ * 1 us før dens egen tid, og de er da alltid kommet frem: samme skript gir samme kjøring.
+ *
+ * Ringene har én skriver og én leser hver, så de trenger ingen lås.
+ */
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+struct HarnessFrame
+{
+  uint64_t atUs;     // sendt (tx) eller ferdig på bussen (rx)
+  uint32_t id;
+  uint8_t len;
+  uint8_t extended;
+  uint8_t data[8];
+};
+
+template <uint32_t size>
+struct HarnessRing
+{
+  std::atomic<uint32_t> head; // neste som skrives
+  std::atomic<uint32_t> tail; // neste som leses
+  HarnessFrame frames[size];
+
+  bool push(const HarnessFrame& frame)
+  {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= size) return false;
+    frames[h % size] = frame;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  const HarnessFrame* front() const
+  {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return nullptr;
+    return &frames[t % size];
+  }
+
+  void pop() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
+
+struct HarnessNode
+{
+  static const uint64_t finished = UINT64_MAX; // timeUs når noden har avsluttet
+
+  std::atomic<uint64_t> timeUs;
+  HarnessRing<64> tx;  // som FlexCAN-sendekøen, men større siden harnesset tømmer den i rykk
+  HarnessRing<256> rx; // RX_SIZE_256 som i skissene
+  uint32_t rxDropped;  // mottakskøen var full (skrives av harnesset)
+  uint32_t framesSent[2049]; // per standard-ID, [2048] er alle utvidede (skrives av noden)
+};
+
+struct HarnessShared
+{
+  static const uint32_t magicValue = 0x746f6e6f; // "tono"
+  static const int maxNodes = 2;
+
+  uint32_t magic;
+  uint32_t nodeCount;
+  uint32_t simulatedBus;     // 0: nodene bruker --if (vcan), 1: CanBusSim i harnesset
+  std::atomic<uint64_t> busTimeUs;
+  HarnessNode nodes[maxNodes];
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "Arduino.h"
+#include "hal.h"
+
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * main() for skissene på verten: leser valgene (se hal.h), kjører setup() og så loop()
+ * til --ms er nådd.
+ */
+
+HalOptions halOptions = {nullptr, nullptr, nullptr, 0, 0, 0, 0, false, false, false, false, nullptr, 0};
+
+static timespec wallStart;
+
+static bool startsWith(const char* arg, const char* prefix, const char** value)
+{
+  size_t n = strlen(prefix);
+  if (strncmp(arg, prefix, n) != 0) return false;
+  *value = arg + n;
+  return true;
+}
+
+static void usage(const char* program)
+{
+  fprintf(stderr,
+          "Bruk: %s [--if=vcan0] [--script=fil] [--ms=N] [--node-id=N] [--jitter-us=N] [--spi-hz=N]\n"
+          "          [--show] [--dump=fil] [--realtime] [--quiet] [--stamp] [--shared=fil --node=N]\n",
+          program);
+}
+
+void halFinish()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double wallS = (now.tv_sec - wallStart.tv_sec) + (now.tv_nsec - wallStart.tv_nsec) / 1e9;
+  double virtualS = halNowUs() / 1e6;
+
+  fflush(stdout);
+  fprintf(stderr, "\n--- %.3f s skissetid på %.3f s (%.0fx) ---\n", virtualS, wallS,
+          wallS > 0 ? virtualS / wallS : 0.0);
+  fprintf(stderr, "loop():       %llu (%.1f per s)\n", (unsigned long long)halStats.loops,
+          virtualS > 0 ? halStats.loops / virtualS : 0.0);
+  fprintf(stderr, "CAN sendt:    %llu (%llu full kø)\n", (unsigned long long)halStats.canSent,
+          (unsigned long long)halStats.canSendFailed);
+  fprintf(stderr, "CAN mottatt:  %llu\n", (unsigned long long)halStats.canReceived);
+  fprintf(stderr, "Skjerm:       %llu oppdateringer, %llu bytes, %.1f %% av tiden, %llu avvik\n",
+          (unsigned long long)halStats.displayUpdates, (unsigned long long)halStats.displayBytes,
+          virtualS > 0 ? 100.0 * halStats.displayTimeUs / 1e6 / virtualS : 0.0,
+          (unsigned long long)halStats.displayMismatches);
+
+  halCloseDisplay();
+  halHarnessDone();
+  exit(0);
+}
+
+int main(int argc, char** argv)
+{
+  halOptions.nodeId = (uint32_t)getpid();
+
+  for (int i = 1; i < argc; i++) {
+    const char* value;
+    if (startsWith(argv[i], "--if=", &value)) halOptions.canInterface = value;
+    else if (startsWith(argv[i], "--script=", &value)) halOptions.scriptFile = value;
+    else if (startsWith(argv[i], "--dump=", &value)) halOptions.dumpFile = value;
+    else if (startsWith(argv[i], "--spi-hz=", &value)) halOptions.spiHz = strtoul(value, nullptr, 10);
+    else if (startsWith(argv[i], "--ms=", &value)) halOptions.limitMs = strtoull(value, nullptr, 10);
+    else if (startsWith(argv[i], "--node-id=", &value)) halOptions.nodeId = strtoul(value, nullptr, 0);
+    else if (startsWith(argv[i], "--jitter-us=", &value)) halOptions.jitterUs = strtoul(value, nullptr, 10);
+    else if (strcmp(argv[i], "--realtime") == 0) halOptions.realtime = true;
+    else if (strcmp(argv[i], "--show") == 0) halOptions.show = true;
+    else if (strcmp(argv[i], "--quiet") == 0) halOptions.quiet = true;
+    else if (strcmp(argv[i], "--stamp") == 0) halOptions.stamp = true;
+    else if (startsWith(argv[i], "--shared=", &value)) halOptions.sharedFile = value;
+    else if (startsWith(argv[i], "--node=", &value)) halOptions.harnessNode = atoi(value);
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (halOptions.scriptFile && !halLoadScript(halOptions.scriptFile)) {
+    perror(halOptions.scriptFile);
+    return 1;
+  }
+  if (halOptions.sharedFile) {
+    if (!halHarnessAttach(halOptions.sharedFile, halOptions.harnessNode)) {
+      fprintf(stderr, "Fant ikke node %d i %s\n", halOptions.harnessNode, halOptions.sharedFile);
+      return 1;
+    }
+    halOptions.realtime = false; // klokka følger harnesset
+  }
+  if (halOptions.show) fputs("\x1b[2J", stderr);
+
+  halChipIdLow = halOptions.nodeId;
+  halChipIdMidLow = 0;
+  randomSeed(halOptions.nodeId);
+  clock_gettime(CLOCK_MONOTONIC, &wallStart);
+
+  // Egen generator for --jitter-us, så skissens random() ikke blir påvirket
+  uint64_t jitterState = halOptions.nodeId * 0x9E3779B97F4A7C15ULL | 1;
+
+  setup();
+  while (true) {
+    loop();
+    halStats.loops++;
+    uint64_t jitterUs = 0;
+    if (halOptions.jitterUs) {
+      jitterState ^= jitterState >> 12;
+      jitterState ^= jitterState << 25;
+      jitterState ^= jitterState >> 27;
+      jitterUs = ((jitterState * 0x2545F4914F6CDD1DULL) >> 32) % (halOptions.jitterUs + 1);
+    }
+    halAdvanceUs(jitterUs); // sjekker også --ms når loop() ikke spør om tiden
+  }
+}
@@ -0,0 +1,517 @@
+/*
+ * Kjører to noder av Lars/EndeligPingPong.cpp mot hverandre på Linux, med skriptede joysticker
+ * og felles virtuell klokke (se harness.h), og måler peer-protokollen:
+ *  - rammer per sekund fra hver node, per ID
+ *  - tiden fra første joystickbevegelse til hver node har en rolle, og at rollene er ulike
+ *  - at begge skjermene viser de samme poengene, og hvor lenge etter hverandre
+ *  - game over på begge nodene, og reset-håndtrykket fra klikk til begge spiller igjen
+ *
+ * Nodene er skissen bygget mot hal/host (bygg.sh), hver i sin prosess. Uten --if går CAN
+ * gjennom CanBusSim (del3/canbussim.h) med bitrate, arbitrering og køer, og samme skript gir
+ * nøyaktig samme kjøring, så endringer i tallene kommer fra koden. Med --if=vcan0 går rammene
+ * over vcan i stedet (ingen bitrate, levert når den andre noden leser). --jitter-us gir hver
+ * loop() litt tilfeldig ekstra tid (se hal.h), ellers går nodene i nøyaktig samme takt.
+ *
+ * Standardskriptet: A beveger seg ved 1 s (blir P1), ingen spiller (ballen går i mål), og B
+ * klikker for nytt spill ved 40 s. Egne skript har samme format som --script i hal.h.
+ *
+ * Bruk:
+ *   hal/host/bygg.sh
+ *   hal/host/bygg/tonoder [--ms=60000] [--script-a=fil] [--script-b=fil] [--bitrate=500000]
+ *                         [--loss=0.0] [--errors=0.0] [--seed=1] [--jitter-us=1000] [--if=vcan0]
+ *                         [--logs=mappe]
+ * Avslutter med 1 hvis rollene ikke ble ulike, poengene er ulike til slutt eller bare den ene
+ * noden kom til game over.
+ */
+
+#include "harness.h"
+#include "../../del3/canbussim.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+  const int nodeCount = 2;
+  const char* nodeNames[nodeCount] = {"A", "B"};
+  const int pinClick = 19;
+  const int pinUp = 22;
+  const int pinDown = 23;
+  const uint64_t defaultResetMs = 40000;
+
+  std::string sketch;
+  std::string scripts[nodeCount];
+  std::string logDir;
+  std::string canInterface;
+  uint64_t limitMs = 60000;
+  uint32_t bitrate = 500000;
+  double lossProbability = 0.0;
+  double errorProbability = 0.0;
+  uint32_t seed = 1;
+  uint32_t jitterUs = 1000;
+
+  struct PendingFrame
+  {
+    HarnessFrame frame;
+    int node;
+  };
+
+  struct ScriptPress
+  {
+    double ms;
+    int pin;
+  };
+
+  struct Score
+  {
+    double ms;
+    int p2;
+    int p1;
+  };
+
+  // Det vi leser ut av loggen til en node (Serial og skjermtekst med tidsstempel fra --stamp)
+  struct NodeLog
+  {
+    double roleMs = -1;
+    int role = 0;
+    std::vector<Score> scores;
+    std::vector<double> gameOverMs;
+    std::vector<double> resetStartMs;   // "Starter nytt spill..."
+    std::vector<double> resetReceivedMs; // "Mottok reset-signal!"
+    int desyncs = 0;
+    int resyncs = 0;
+    int peerLost = 0;
+  };
+}
+
+// ---------- Nodene ----------
+
+static pid_t startNode(int node, const std::string& sharedFile)
+{
+  std::string log = logDir + "/node" + nodeNames[node] + ".log";
+  pid_t pid = fork();
+  if (pid != 0) return pid;
+
+  int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    dup2(fd, 1);
+    dup2(fd, 2);
+    close(fd);
+  }
+
+  std::vector<std::string> args = {sketch, "--stamp", "--shared=" + sharedFile, "--node=" + std::to_string(node),
+                                   "--node-id=" + std::to_string(node + 1), "--ms=" + std::to_string(limitMs),
+                                   "--script=" + scripts[node], "--jitter-us=" + std::to_string(jitterUs)};
+  if (!canInterface.empty()) args.push_back("--if=" + canInterface);
+  std::vector<char*> argv;
+  for (std::string& arg : args) argv.push_back(&arg[0]);
+  argv.push_back(nullptr);
+  execv(sketch.c_str(), argv.data());
+  perror(sketch.c_str());
+  _exit(127);
+}
+
+/*
+ * Holder klokka og (uten --if) bussen til nodene er ferdige. busTimeUs følger den minste
+ * tiden, og rammer sendt før den går gjennom CanBusSim før den flyttes (se harness.h).
+ */
+static void runHarness(HarnessShared& shared, CanBusSim& bus, pid_t* pids, int* exitStatus)
+{
+  std::vector<PendingFrame> pending;
+  uint32_t idle = 0;
+  bool running[nodeCount] = {true, true};
+
+  while (true) {
+    uint64_t minUs = HarnessNode::finished;
+    for (int i = 0; i < nodeCount; i++) {
+      minUs = std::min(minUs, shared.nodes[i].timeUs.load(std::memory_order_acquire));
+    }
+    if (minUs == HarnessNode::finished) break;
+
+    if (shared.simulatedBus) {
+      for (int i = 0; i < nodeCount; i++) {
+        while (const HarnessFrame* frame = shared.nodes[i].tx.front()) {
+          pending.push_back({*frame, i});
+          shared.nodes[i].tx.pop();
+        }
+      }
+      std::stable_sort(pending.begin(), pending.end(), [](const PendingFrame& a, const PendingFrame& b) {
+        return a.frame.atUs != b.frame.atUs ? a.frame.atUs < b.frame.atUs : a.node < b.node;
+      });
+
+      size_t sent = 0;
+      for (; sent < pending.size() && pending[sent].frame.atUs < minUs; sent++) {
+        const HarnessFrame& frame = pending[sent].frame;
+        bus.runUntil((double)frame.atUs);
+        bus.send(pending[sent].node, frame.id, frame.data, frame.len, frame.extended);
+      }
+      pending.erase(pending.begin(), pending.begin() + sent);
+      bus.runUntil(minUs - 0.5);
+
+      SimFrame simFrame;
+      for (int i = 0; i < nodeCount; i++) {
+        while (bus.receive(i, simFrame)) {
+          HarnessFrame frame;
+          frame.atUs = (uint64_t)simFrame.doneUs;
+          frame.id = simFrame.id;
+          frame.extended = simFrame.extended;
+          frame.len = simFrame.len;
+          memcpy(frame.data, simFrame.data, simFrame.len);
+          if (!shared.nodes[i].rx.push(frame)) shared.nodes[i].rxDropped++;
+        }
+      }
+    }
+
+    if (minUs > shared.busTimeUs.load(std::memory_order_relaxed)) {
+      shared.busTimeUs.store(minUs, std::memory_order_release);
+      idle = 0;
+      continue;
+    }
+
+    // Ingen fremgang: sjekk om en node har krasjet, og slipp CPU-en til nodene
+    if (++idle % 256 == 0) {
+      for (int i = 0; i < nodeCount; i++) {
+        int status;
+        if (!running[i] || waitpid(pids[i], &status, WNOHANG) != pids[i]) continue;
+        running[i] = false;
+        exitStatus[i] = status;
+        shared.nodes[i].timeUs.store(HarnessNode::finished, std::memory_order_release);
+      }
+    }
+    sched_yield();
+  }
+
+  for (int i = 0; i < nodeCount; i++) {
+    if (running[i]) waitpid(pids[i], &exitStatus[i], 0);
+  }
+}
+
+// ---------- Skript og logger ----------
+
+static bool writeFile(const std::string& path, const std::string& text)
+{
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  fputs(text.c_str(), file);
+  fclose(file);
+  return true;
+}
+
+// Når joystickpinnene går LOW i et skript
+static std::vector<ScriptPress> readPresses(const std::string& path)
+{
+  std::vector<ScriptPress> presses;
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return presses;
+  char line[128];
+  while (fgets(line, sizeof(line), file)) {
+    double ms;
+    int pin, value;
+    if (line[0] != '#' && sscanf(line, "%lf %d %d", &ms, &pin, &value) == 3 && value == 0) presses.push_back({ms, pin});
+  }
+  fclose(file);
+  std::sort(presses.begin(), presses.end(), [](const ScriptPress& a, const ScriptPress& b) { return a.ms < b.ms; });
+  return presses;
+}
+
+static NodeLog readLog(int node)
+{
+  NodeLog log;
+  std::string path = logDir + "/node" + nodeNames[node] + ".log";
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return log;
+
+  char line[512];
+  while (fgets(line, sizeof(line), file)) {
+    double ms;
+    char text[480];
+    if (sscanf(line, "[%lf] %479[^\n]", &ms, text) != 2) continue;
+    std::string s = text;
+
+    int p1, p2;
+    if (s.rfind("Jeg ble Player ", 0) == 0 && log.roleMs < 0) {
+      log.roleMs = ms;
+      log.role = atoi(s.c_str() + 15);
+    } else if (s.rfind("skjerm: DU VANT!", 0) == 0 || s.rfind("skjerm: DU TAPTE", 0) == 0) {
+      log.gameOverMs.push_back(ms);
+    } else if (sscanf(s.c_str(), "skjerm: %d|-|%d", &p2, &p1) == 2) {
+      if (log.scores.empty() || log.scores.back().p1 != p1 || log.scores.back().p2 != p2) log.scores.push_back({ms, p2, p1});
+    } else if (s.rfind("Starter nytt spill", 0) == 0) {
+      log.resetStartMs.push_back(ms);
+    } else if (s.rfind("Mottok reset-signal", 0) == 0) {
+      log.resetReceivedMs.push_back(ms);
+    } else if (s.rfind("DESYNC", 0) == 0) {
+      log.desyncs++;
+    } else if (s.rfind("Resync fra P1", 0) == 0) {
+      log.resyncs++;
+    } else if (s.rfind("Motparten svarer ikke", 0) == 0) {
+      log.peerLost++;
+    }
+  }
+  fclose(file);
+  return log;
+}
+
+// Første tid i times som er >= fromMs, eller -1
+static double firstAfter(const std::vector<double>& times, double fromMs)
+{
+  for (double t : times) {
+    if (t >= fromMs) return t;
+  }
+  return -1;
+}
+
+// ---------- Rapport ----------
+
+static void printFrameRates(const HarnessShared& shared, double seconds)
+{
+  for (int i = 0; i < nodeCount; i++) {
+    const HarnessNode& node = shared.nodes[i];
+    uint64_t total = 0;
+    std::vector<std::pair<uint32_t, int>> perId;
+    for (int id = 0; id <= 2048; id++) {
+      if (node.framesSent[id] == 0) continue;
+      total += node.framesSent[id];
+      perId.push_back({node.framesSent[id], id});
+    }
+    std::sort(perId.rbegin(), perId.rend());
+
+    printf("Node %s: %.1f rammer/s (", nodeNames[i], total / seconds);
+    for (size_t k = 0; k < perId.size() && k < 6; k++) {
+      if (k > 0) printf(", ");
+      if (perId[k].second == 2048) printf("utvidet %.1f", perId[k].first / seconds);
+      else printf("%d: %.1f", perId[k].second, perId[k].first / seconds);
+    }
+    printf(")%s\n", node.rxDropped ? (", " + std::to_string(node.rxDropped) + " tapt i full mottakskø").c_str() : "");
+  }
+}
+
+// Sammenligner poengene på skjermene. En poengsum bare den ene viste (spolt tilbake) telles som uenig.
+static bool printScores(const NodeLog& a, const NodeLog& b)
+{
+  size_t i = 0, j = 0;
+  int matched = 0, onlyA = 0, onlyB = 0;
+  double sumLagMs = 0, maxLagMs = 0;
+  while (i < a.scores.size() && j < b.scores.size()) {
+    const Score& sa = a.scores[i];
+    const Score& sb = b.scores[j];
+    if (sa.p1 == sb.p1 && sa.p2 == sb.p2) {
+      double lag = sa.ms > sb.ms ? sa.ms - sb.ms : sb.ms - sa.ms;
+      sumLagMs += lag;
+      maxLagMs = std::max(maxLagMs, lag);
+      matched++;
+      i++;
+      j++;
+    } else if (sa.ms <= sb.ms) {
+      onlyA++;
+      i++;
+    } else {
+      onlyB++;
+      j++;
+    }
+  }
+  onlyA += a.scores.size() - i;
+  onlyB += b.scores.size() - j;
+
+  bool finalEqual = !a.scores.empty() && !b.scores.empty() && a.scores.back().p1 == b.scores.back().p1 &&
+                    a.scores.back().p2 == b.scores.back().p2;
+  printf("Poeng: %d like på begge (forskjell snitt %.1f ms, maks %.1f ms), bare A %d, bare B %d\n", matched,
+         matched ? sumLagMs / matched : 0.0, maxLagMs, onlyA, onlyB);
+  if (!a.scores.empty() && !b.scores.empty()) {
+    printf("       sist %02d-%02d på A og %02d-%02d på B%s\n", a.scores.back().p2, a.scores.back().p1,
+           b.scores.back().p2, b.scores.back().p1, finalEqual ? "" : "  <-- ULIKE");
+  }
+  return finalEqual;
+}
+
+static bool printGameOver(const NodeLog& a, const NodeLog& b)
+{
+  size_t games = std::max(a.gameOverMs.size(), b.gameOverMs.size());
+  for (size_t k = 0; k < games; k++) {
+    double ta = k < a.gameOverMs.size() ? a.gameOverMs[k] : -1;
+    double tb = k < b.gameOverMs.size() ? b.gameOverMs[k] : -1;
+    printf("Game over %zu: A %s, B %s", k + 1, ta < 0 ? "aldri" : (std::to_string((int)ta) + " ms").c_str(),
+           tb < 0 ? "aldri" : (std::to_string((int)tb) + " ms").c_str());
+    if (ta >= 0 && tb >= 0) printf(" (forskjell %.1f ms)", ta > tb ? ta - tb : tb - ta);
+    else printf("  <-- BARE DEN ENE");
+    printf("\n");
+  }
+  return a.gameOverMs.size() == b.gameOverMs.size();
+}
+
+// Reset-håndtrykket: klikk (fra skriptet) til egen reset, motparten får signalet og starter
+static void printResets(const std::vector<ScriptPress>* presses, const NodeLog* logs)
+{
+  for (int i = 0; i < nodeCount; i++) {
+    const NodeLog& own = logs[i];
+    const NodeLog& peer = logs[1 - i];
+    for (const ScriptPress& press : presses[i]) {
+      if (press.pin != pinClick) continue;
+      double ownStart = firstAfter(own.resetStartMs, press.ms);
+      if (ownStart < 0) {
+        printf("Klikk på %s ved %.0f ms: ingen reset (ikke game over?)\n", nodeNames[i], press.ms);
+        continue;
+      }
+      double peerReceived = firstAfter(peer.resetReceivedMs, press.ms);
+      double peerStart = firstAfter(peer.resetStartMs, press.ms);
+      printf("Klikk på %s ved %.0f ms: %s startet +%.1f ms", nodeNames[i], press.ms, nodeNames[i], ownStart - press.ms);
+      if (peerReceived >= 0) printf(", %s fikk reset +%.1f ms", nodeNames[1 - i], peerReceived - press.ms);
+      if (peerStart >= 0) printf(", %s startet +%.1f ms", nodeNames[1 - i], peerStart - press.ms);
+      else printf(", %s startet aldri", nodeNames[1 - i]);
+      printf("\n");
+    }
+  }
+}
+
+static void printBus(const CanBusSim& bus)
+{
+  printf("Buss: %u bit/s, %.1f %% last\n", bus.bitrate(), bus.utilization() * 100.0);
+  for (int i = 0; i < bus.nodeCount(); i++) {
+    const SimNodeStats& stats = bus.stats(i);
+    printf("  %s: sendt %u, full sendekø %u, tapt %u, feilrammer %u, kollisjoner %u%s\n", bus.name(i).c_str(),
+           stats.sent, stats.txDropped, stats.lost, stats.errors, stats.collisions, stats.busOff ? ", BUS-OFF" : "");
+  }
+  for (const auto& entry : bus.latencyPerId()) {
+    if (entry.first > 0x7ff) continue; // rollefordelingen (utvidet ID) sendes bare i starten
+    const SimIdLatency& latency = entry.second;
+    printf("  ID %3u: %7u rammer, ventetid snitt %6.1f us, maks %7.1f us\n", entry.first, latency.frames,
+           latency.sumUs / latency.frames, latency.maxUs);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::string self = argv[0];
+  std::string buildDir = self.find('/') == std::string::npos ? "." : self.substr(0, self.rfind('/'));
+  sketch = buildDir + "/endelig";
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind("--sketch=", 0) == 0) sketch = arg.substr(9);
+    else if (arg.rfind("--script-a=", 0) == 0) scripts[0] = arg.substr(11);
+    else if (arg.rfind("--script-b=", 0) == 0) scripts[1] = arg.substr(11);
+    else if (arg.rfind("--ms=", 0) == 0) limitMs = strtoull(arg.c_str() + 5, nullptr, 10);
+    else if (arg.rfind("--bitrate=", 0) == 0) bitrate = std::max(10000, atoi(arg.c_str() + 10));
+    else if (arg.rfind("--loss=", 0) == 0) lossProbability = atof(arg.c_str() + 7);
+    else if (arg.rfind("--errors=", 0) == 0) errorProbability = atof(arg.c_str() + 9);
+    else if (arg.rfind("--seed=", 0) == 0) seed = strtoul(arg.c_str() + 7, nullptr, 0);
+    else if (arg.rfind("--if=", 0) == 0) canInterface = arg.substr(5);
+    else if (arg.rfind("--jitter-us=", 0) == 0) jitterUs = strtoul(arg.c_str() + 12, nullptr, 10);
+    else if (arg.rfind("--logs=", 0) == 0) logDir = arg.substr(7);
+    else {
+      fprintf(stderr, "Ukjent argument: %s\n", arg.c_str());
+      return 2;
+    }
+  }
+  if (limitMs == 0) limitMs = 60000; // nodene må stoppe for at rapporten skal komme
+
+  bool keepLogs = !logDir.empty();
+  if (keepLogs) {
+    mkdir(logDir.c_str(), 0755);
+  } else {
+    char dir[] = "/tmp/tonoder.XXXXXX";
+    if (!mkdtemp(dir)) {
+      perror("mkdtemp");
+      return 2;
+    }
+    logDir = dir;
+  }
+
+  // Standardskriptet (se toppen)
+  if (scripts[0].empty()) {
+    scripts[0] = logDir + "/skriptA.txt";
+    writeFile(scripts[0], "# A beveger seg først og blir P1\n1000 22 0\n1300 22 1\n");
+  }
+  if (scripts[1].empty()) {
+    scripts[1] = logDir + "/skriptB.txt";
+    writeFile(scripts[1], "# B klikker for nytt spill\n" + std::to_string(defaultResetMs) + " 19 0\n" +
+                              std::to_string(defaultResetMs + 100) + " 19 1\n");
+  }
+
+  // Delt minne (harness.h)
+  std::string sharedFile = logDir + "/delt";
+  int fd = open(sharedFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0 || ftruncate(fd, sizeof(HarnessShared)) != 0) {
+    perror(sharedFile.c_str());
+    return 2;
+  }
+  HarnessShared* shared = (HarnessShared*)mmap(nullptr, sizeof(HarnessShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shared == MAP_FAILED) {
+    perror("mmap");
+    return 2;
+  }
+  shared->nodeCount = nodeCount;
+  shared->simulatedBus = canInterface.empty();
+  shared->magic = HarnessShared::magicValue;
+
+  CanBusSim bus(bitrate, seed);
+  bus.setLossProbability(lossProbability);
+  bus.setErrorProbability(errorProbability);
+  for (int i = 0; i < nodeCount; i++) bus.attach(std::string("node ") + nodeNames[i], 16, 256);
+
+  pid_t pids[nodeCount];
+  int exitStatus[nodeCount] = {0, 0};
+  for (int i = 0; i < nodeCount; i++) pids[i] = startNode(i, sharedFile);
+  runHarness(*shared, bus, pids, exitStatus);
+
+  // ---------- Rapport ----------
+  std::vector<ScriptPress> presses[nodeCount];
+  NodeLog logs[nodeCount];
+  for (int i = 0; i < nodeCount; i++) {
+    presses[i] = readPresses(scripts[i]);
+    logs[i] = readLog(i);
+    if (!WIFEXITED(exitStatus[i]) || WEXITSTATUS(exitStatus[i]) != 0) {
+      printf("Node %s avsluttet med feil (se %s/node%s.log)\n", nodeNames[i], logDir.c_str(), nodeNames[i]);
+    }
+  }
+
+  double seconds = limitMs / 1000.0;
+  printf("=== %s mot seg selv, %.1f s, %s ===\n", sketch.c_str(), seconds,
+         canInterface.empty() ? "simulert buss" : canInterface.c_str());
+  printFrameRates(*shared, seconds);
+
+  // Rollefordeling, målt fra første bevegelse på noen av nodene
+  double firstMoveMs = -1;
+  for (int i = 0; i < nodeCount; i++) {
+    for (const ScriptPress& press : presses[i]) {
+      if ((press.pin == pinUp || press.pin == pinDown) && (firstMoveMs < 0 || press.ms < firstMoveMs)) firstMoveMs = press.ms;
+    }
+  }
+  bool rolesOk = logs[0].role != 0 && logs[1].role != 0 && logs[0].role != logs[1].role;
+  for (int i = 0; i < nodeCount; i++) {
+    if (logs[i].role == 0) printf("Rolle %s: ingen\n", nodeNames[i]);
+    else printf("Rolle %s: P%d etter %.1f ms\n", nodeNames[i], logs[i].role, logs[i].roleMs - std::max(0.0, firstMoveMs));
+  }
+  if (!rolesOk) printf("Rollene er ikke ulike  <-- FEIL\n");
+
+  bool scoresOk = printScores(logs[0], logs[1]);
+  bool gameOverOk = printGameOver(logs[0], logs[1]);
+  printResets(presses, logs);
+  printf("Desync %d/%d, resync %d/%d, mistet motparten %d/%d (A/B)\n", logs[0].desyncs, logs[1].desyncs,
+         logs[0].resyncs, logs[1].resyncs, logs[0].peerLost, logs[1].peerLost);
+  if (shared->simulatedBus) printBus(bus);
+
+  if (!keepLogs) {
+    for (int i = 0; i < nodeCount; i++) {
+      unlink((logDir + "/node" + nodeNames[i] + ".log").c_str());
+    }
+    unlink((logDir + "/skriptA.txt").c_str());
+    unlink((logDir + "/skriptB.txt").c_str());
+    unlink(sharedFile.c_str());
+    rmdir(logDir.c_str());
+  } else {
+    printf("Logger i %s\n", logDir.c_str());
+  }
+  return rolesOk && scoresOk && gameOverOk ? 0 : 1;
+}